@@ -0,0 +1,250 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "synthetic.h"
+
+#include "allocationtracker.h"
+#include "inireader.h"
+#include "mesh.h"
+#include "objloader.h"
+#include "textureregistry.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs the CPU-side hot paths of the loaders on synthetic inputs and reports their
+// throughput and the number of heap allocations per operation
+//
+// Usage: textured-obj-renderer-benchmark [--triangles N] [--image-size N]
+//        [--filter text] [--json path]
+
+namespace {
+    // The results of the operations are written here so that they can't be optimized away
+    volatile uint64_t sink = 0;
+
+    // Every benchmark runs for at least this long to even out the noise
+    constexpr const double MinDuration = 0.5;
+    constexpr const int MinIterations = 3;
+
+    struct Result {
+        std::string name;
+        uint64_t nIterations = 0;
+        double secondsPerOp = 0.0;
+        // The size of the input and the number of triangles processed per operation
+        double bytesPerOp = 0.0;
+        double trianglesPerOp = 0.0;
+        double allocationsPerOp = 0.0;
+    };
+
+    Result run(const std::string& name, double bytesPerOp, double trianglesPerOp,
+               const std::function<void()>& op)
+    {
+        // The first run warms up the caches and is not measured
+        op();
+
+        using namespace std::chrono;
+        const uint64_t allocationsBefore = totalAllocations().nAllocations;
+        const steady_clock::time_point start = steady_clock::now();
+        uint64_t n = 0;
+        double duration = 0.0;
+        while (n < MinIterations || duration < MinDuration) {
+            op();
+            n++;
+            duration = std::chrono::duration<double>(steady_clock::now() - start).count();
+        }
+
+        Result res;
+        res.name = name;
+        res.nIterations = n;
+        res.secondsPerOp = duration / n;
+        res.bytesPerOp = bytesPerOp;
+        res.trianglesPerOp = trianglesPerOp;
+        const uint64_t nAllocations = totalAllocations().nAllocations - allocationsBefore;
+        res.allocationsPerOp = static_cast<double>(nAllocations) / n;
+        return res;
+    }
+
+    void print(const Result& r) {
+        std::printf(
+            "%-28s %10.3f ms %10.1f MB/s %12.0f tris/s %12.1f allocs/op\n",
+            r.name.c_str(),
+            r.secondsPerOp * 1000.0,
+            r.bytesPerOp / r.secondsPerOp / (1024.0 * 1024.0),
+            r.trianglesPerOp / r.secondsPerOp,
+            r.allocationsPerOp
+        );
+    }
+
+    void saveJson(const std::string& path, const std::vector<Result>& results) {
+        std::ofstream f(path);
+        f << "[\n";
+        for (size_t i = 0; i < results.size(); ++i) {
+            const Result& r = results[i];
+            char line[512];
+            std::snprintf(
+                line,
+                sizeof(line),
+                "  { \"name\": \"%s\", \"iterations\": %llu, \"secondsPerOp\": %.9g, "
+                "\"megabytesPerSecond\": %.9g, \"trianglesPerSecond\": %.9g, "
+                "\"allocationsPerOp\": %.9g }",
+                r.name.c_str(),
+                static_cast<unsigned long long>(r.nIterations),
+                r.secondsPerOp,
+                r.bytesPerOp / r.secondsPerOp / (1024.0 * 1024.0),
+                r.trianglesPerOp / r.secondsPerOp,
+                r.allocationsPerOp
+            );
+            f << line << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        f << "]\n";
+    }
+
+    std::string argument(int argc, char** argv, const std::string& option,
+                         const std::string& defaultValue)
+    {
+        for (int i = 1; i + 1 < argc; ++i) {
+            if (argv[i] == option) {
+                return argv[i + 1];
+            }
+        }
+        return defaultValue;
+    }
+} // namespace
+
+int main(int argc, char** argv) {
+    const uint32_t nTriangles =
+        static_cast<uint32_t>(std::stoul(argument(argc, argv, "--triangles", "200000")));
+    const int imageSize = std::stoi(argument(argc, argv, "--image-size", "2048"));
+    const std::string filter = argument(argc, argv, "--filter", "");
+    const std::string jsonPath = argument(argc, argv, "--json", "");
+
+    namespace fs = std::filesystem;
+    const fs::path folder = fs::temp_directory_path() / "textured-obj-benchmark";
+    fs::create_directories(folder);
+
+    std::vector<Result> results;
+    auto add = [&](const std::string& name, double bytes, double triangles,
+                   const std::function<void()>& op)
+    {
+        if (name.find(filter) == std::string::npos) {
+            return;
+        }
+        results.push_back(run(name, bytes, triangles, op));
+        print(results.back());
+    };
+
+    // Loading obj files in all combinations of the face layouts
+    for (int variant = 0; variant < 4; ++variant) {
+        SyntheticObj settings;
+        settings.nTriangles = nTriangles;
+        settings.useQuads = (variant & 1) != 0;
+        settings.hasUVs = (variant & 2) == 0;
+        settings.hasNormals = (variant & 2) == 0;
+        const std::string suffix = std::string(settings.useQuads ? "quads" : "tris") +
+            (settings.hasUVs ? "/uv+n" : "/pos");
+
+        const fs::path path = folder / ("grid_" + std::to_string(variant) + ".obj");
+        const uint32_t nTris = writeObj(path, settings);
+        const double fileSize = static_cast<double>(fs::file_size(path));
+
+        add("loadObjFile " + suffix, fileSize, nTris, [&]() {
+            sink = obj::loadObjFile(path.string()).faces.size();
+        });
+
+        const obj::Model model = obj::loadObjFile(path.string());
+        add("geometryFromModel " + suffix, 0.0, nTris, [&]() {
+            sink = Mesh::geometryFromModel(model).vertices.size();
+        });
+
+        if (variant == 0) {
+            const Mesh::Geometry geometry = Mesh::geometryFromModel(model);
+            const double size =
+                static_cast<double>(geometry.vertices.size() * sizeof(Vertex));
+            add("findCornerVertices", size, nTris, [&]() {
+                sink = findCornerVertices(geometry.vertices).isComplete;
+            });
+        }
+    }
+
+    const double cylinderTriangles =
+        static_cast<double>(Mesh::cylinderGeometry(1.f, 1.f).vertices.size() / 3);
+    add("cylinderGeometry", 0.0, cylinderTriangles, []() {
+        sink = Mesh::cylinderGeometry(1.f, 2.f).vertices.size();
+    });
+
+    const fs::path iniPath = folder / "config.ini";
+    writeIni(iniPath, 64, 16);
+    add("readIni", static_cast<double>(fs::file_size(iniPath)), 0.0, [&]() {
+        sink = readIni(iniPath.string()).size();
+    });
+
+    // Decoding keeps no result alive between the iterations, so every call decodes
+    for (const char* ext : { "png", "jpg" }) {
+        const fs::path path = folder / (std::string("image.") + ext);
+        writeImage(path, imageSize, 1);
+        const std::vector<unsigned char> contents = readFile(path);
+        const ImageKey key = imageKey(contents);
+        const double size = static_cast<double>(contents.size());
+        add(std::string("decode ") + ext, size, 0.0, [&]() {
+            sink = TextureRegistry::instance().decode(key, contents)->data.size();
+        });
+    }
+
+    {
+        const std::vector<unsigned char> contents = readFile(folder / "image.png");
+        add("imageKey", static_cast<double>(contents.size()), 0.0, [&]() {
+            sink = imageKey(contents).hash;
+        });
+
+        // Consecutive frames that differ in a scattered set of pixels
+        std::shared_ptr<const DecodedImage> a =
+            TextureRegistry::instance().decode(imageKey(contents), contents);
+        auto b = std::make_shared<DecodedImage>(*a);
+        b->key.hash++;
+        for (size_t i = 0; i < b->data.size() / 16; i += 97) {
+            b->data[i] ^= 0xff;
+        }
+        const double size = static_cast<double>(a->data.size());
+        add("tileDelta", size, 0.0, [&]() {
+            sink = tileDelta(*a, *b)->dirtyTiles.size();
+        });
+    }
+
+    if (!jsonPath.empty()) {
+        saveJson(jsonPath, results);
+    }
+    fs::remove_all(folder);
+    return EXIT_SUCCESS;
+}
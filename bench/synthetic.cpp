@@ -0,0 +1,151 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "synthetic.h"
+
+#include <sgct/image.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+uint32_t writeObj(const std::filesystem::path& path, const SyntheticObj& settings) {
+    std::ofstream f(path);
+    if (!f.good()) {
+        throw std::runtime_error("Could not create " + path.string());
+    }
+
+    // A grid of n x m cells with two triangles each
+    const uint32_t nCells = (settings.nTriangles + 1) / 2;
+    const uint32_t n = std::max(1u, static_cast<uint32_t>(std::sqrt(nCells)));
+    const uint32_t m = (nCells + n - 1) / n;
+
+    f << "# Synthetic grid with " << 2 * n * m << " triangles\n";
+    for (uint32_t y = 0; y <= m; ++y) {
+        for (uint32_t x = 0; x <= n; ++x) {
+            f << "v " << static_cast<float>(x) / n << ' ' << static_cast<float>(y) / m
+                << " 0\n";
+        }
+    }
+    if (settings.hasUVs) {
+        for (uint32_t y = 0; y <= m; ++y) {
+            for (uint32_t x = 0; x <= n; ++x) {
+                f << "vt " << static_cast<float>(x) / n << ' '
+                    << static_cast<float>(y) / m << '\n';
+            }
+        }
+    }
+    if (settings.hasNormals) {
+        f << "vn 0 0 1\n";
+    }
+
+    // The indices are 1-based and the same for the positions and texture coordinates
+    auto index = [&](uint32_t x, uint32_t y) {
+        const uint32_t i = y * (n + 1) + x + 1;
+        std::string res = std::to_string(i);
+        if (settings.hasUVs && settings.hasNormals) {
+            res += '/' + std::to_string(i) + "/1";
+        }
+        else if (settings.hasUVs) {
+            res += '/' + std::to_string(i);
+        }
+        else if (settings.hasNormals) {
+            res += "//1";
+        }
+        return res;
+    };
+    for (uint32_t y = 0; y < m; ++y) {
+        for (uint32_t x = 0; x < n; ++x) {
+            const std::string i00 = index(x, y);
+            const std::string i10 = index(x + 1, y);
+            const std::string i11 = index(x + 1, y + 1);
+            const std::string i01 = index(x, y + 1);
+            if (settings.useQuads) {
+                f << "f " << i00 << ' ' << i10 << ' ' << i11 << ' ' << i01 << '\n';
+            }
+            else {
+                f << "f " << i00 << ' ' << i10 << ' ' << i11 << '\n';
+                f << "f " << i00 << ' ' << i11 << ' ' << i01 << '\n';
+            }
+        }
+    }
+    return 2 * n * m;
+}
+
+void writeIni(const std::filesystem::path& path, int nGroups, int nKeys) {
+    std::ofstream f(path);
+    if (!f.good()) {
+        throw std::runtime_error("Could not create " + path.string());
+    }
+    for (int i = 0; i < nGroups; ++i) {
+        f << "# Group " << i << "\n[Group" << i << "]\n";
+        for (int j = 0; j < nKeys; ++j) {
+            f << "Key" << j << " = value " << i * nKeys + j << '\n';
+        }
+        f << '\n';
+    }
+}
+
+void writeImage(const std::filesystem::path& path, int size, uint32_t seed) {
+    sgct::Image img;
+    img.setSize(glm::ivec2(size));
+    img.setChannels(3);
+    img.setBytesPerChannel(1);
+    img.allocateOrResizeData();
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> noise(-8, 8);
+    unsigned char* data = img.data();
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            unsigned char* p = data + (static_cast<size_t>(y) * size + x) * 3;
+            const int r = 255 * x / size;
+            const int g = 255 * y / size;
+            const int b = 128 + static_cast<int>(127 * std::sin((x + y) * 0.05f));
+            p[0] = static_cast<unsigned char>(std::clamp(r + noise(rng), 0, 255));
+            p[1] = static_cast<unsigned char>(std::clamp(g + noise(rng), 0, 255));
+            p[2] = static_cast<unsigned char>(std::clamp(b + noise(rng), 0, 255));
+        }
+    }
+    img.save(path.string());
+}
+
+std::vector<unsigned char> readFile(const std::filesystem::path& path) {
+    std::ifstream f(path, std::ios::binary | std::ios::ate);
+    if (!f.good()) {
+        throw std::runtime_error("Could not open " + path.string());
+    }
+    std::vector<unsigned char> res(static_cast<size_t>(f.tellg()));
+    f.seekg(0);
+    f.read(reinterpret_cast<char*>(res.data()), res.size());
+    return res;
+}
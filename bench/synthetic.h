@@ -0,0 +1,63 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __SYNTHETIC_H__
+#define __SYNTHETIC_H__
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// Generators for the inputs of the micro-benchmarks, so that they do not depend on any
+// files that are not part of the repository
+
+struct SyntheticObj {
+    // The number of triangles, which is rounded up to fill the last row of the grid
+    uint32_t nTriangles = 100000;
+    // Writes two triangles as a single quad face
+    bool useQuads = false;
+    bool hasUVs = true;
+    bool hasNormals = true;
+};
+
+// Writes a regular grid in the xy plane and returns the number of triangles in it
+uint32_t writeObj(const std::filesystem::path& path, const SyntheticObj& settings);
+
+// Writes an ini file with the number of groups that each contain nKeys keys
+void writeIni(const std::filesystem::path& path, int nGroups, int nKeys);
+
+// Writes an RGB image with smooth gradients and some noise, so that its compression
+// ratio is close to that of photographic content. The format is picked from the
+// extension of the path
+void writeImage(const std::filesystem::path& path, int size, uint32_t seed);
+
+std::vector<unsigned char> readFile(const std::filesystem::path& path);
+
+#endif // __SYNTHETIC_H__
@@ -0,0 +1,98 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "allocationtracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<uint64_t> nAllocations = 0;
+    std::atomic<uint64_t> nBytes = 0;
+
+    // Is initialized statically, so it can be used before any constructor has run
+    thread_local AllocationCounts threadCounts;
+} // namespace
+
+bool isTrackingAllocations() {
+#ifdef TRACK_ALLOCATIONS
+    return true;
+#else // TRACK_ALLOCATIONS
+    return false;
+#endif // TRACK_ALLOCATIONS
+}
+
+AllocationCounts threadAllocations() {
+    return threadCounts;
+}
+
+AllocationCounts totalAllocations() {
+    AllocationCounts res;
+    res.nAllocations = nAllocations.load(std::memory_order_relaxed);
+    res.nBytes = nBytes.load(std::memory_order_relaxed);
+    return res;
+}
+
+#ifdef TRACK_ALLOCATIONS
+
+// The nothrow versions of the standard library forward to these, so they are counted too
+void* operator new(size_t size) {
+    nAllocations.fetch_add(1, std::memory_order_relaxed);
+    nBytes.fetch_add(size, std::memory_order_relaxed);
+    threadCounts.nAllocations++;
+    threadCounts.nBytes += size;
+    if (void* p = std::malloc(size == 0 ? 1 : size); p) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+#endif // TRACK_ALLOCATIONS
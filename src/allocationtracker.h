@@ -0,0 +1,55 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __ALLOCATIONTRACKER_H__
+#define __ALLOCATIONTRACKER_H__
+
+#include <cstdint>
+
+// Counts the heap allocations of the program by replacing the global operator new. The
+// replacement is only compiled in if TRACK_ALLOCATIONS is defined, which is the case for
+// debug builds; otherwise all counts stay at zero. Allocations that bypass operator new,
+// such as the ones of C libraries or over-aligned types, are not counted
+
+struct AllocationCounts {
+    uint64_t nAllocations = 0;
+    uint64_t nBytes = 0;
+};
+
+// Returns whether the allocations are counted in this build
+bool isTrackingAllocations();
+
+// The allocations that were made on the calling thread since it was started
+AllocationCounts threadAllocations();
+
+// The allocations that were made on all threads since the program was started
+AllocationCounts totalAllocations();
+
+#endif // __ALLOCATIONTRACKER_H__
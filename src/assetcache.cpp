@@ -0,0 +1,1010 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "assetcache.h"
+
+#include "metrics.h"
+#include "objloader.h"
+#include "trace.h"
+#include <sgct/log.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    namespace fs = std::filesystem;
+
+    constexpr const char Magic[4] = { 'A', 'S', 'T', '1' };
+
+    constexpr const uint32_t FileRequest = 0;
+    // The master parses the obj file and sends the resulting geometry
+    constexpr const uint32_t GeometryRequest = 1;
+
+    constexpr const uint32_t StatusSent = 0;
+    // The node's copy has the same size and modification time as the file
+    constexpr const uint32_t StatusUnchanged = 1;
+    constexpr const uint32_t StatusMissing = 2;
+
+    // Requests with longer paths and chunks that are larger than this are treated as a
+    // broken connection
+    constexpr const uint32_t MaxPathLength = 4096;
+    constexpr const uint32_t MaxChunkSize = 64 * 1024 * 1024;
+    // A file whose checksums don't match is requested this many times before giving up
+    constexpr const int MaxAttempts = 3;
+    // The master might start after the nodes, so connecting is retried for this long
+    constexpr const std::chrono::seconds ConnectTimeout = std::chrono::seconds(30);
+    constexpr const std::chrono::milliseconds RetryInterval =
+        std::chrono::milliseconds(250);
+    // How long the network threads sleep if there was nothing to send or receive
+    constexpr const std::chrono::milliseconds IdleWait = std::chrono::milliseconds(1);
+    constexpr const std::chrono::milliseconds IdleTimeout =
+        std::chrono::milliseconds(100);
+
+    struct RequestHeader {
+        char magic[4];
+        uint32_t type;
+        uint32_t id;
+        uint32_t pathLength;
+        // The version of the file that the node has a copy of, which is 0 if it has none
+        uint64_t fileSize;
+        int64_t lastWriteTime;
+    };
+
+    struct ResponseHeader {
+        char magic[4];
+        uint32_t id;
+        uint32_t status;
+        uint32_t nChunks;
+        // The size of the data in all chunks together
+        uint64_t size;
+        // The version of the file that the data was created from
+        uint64_t fileSize;
+        int64_t lastWriteTime;
+    };
+
+    struct ChunkHeader {
+        uint32_t index;
+        uint32_t size;
+        uint64_t checksum;
+    };
+
+    // Stored next to the local copy of a file to remember which version it is
+    struct CacheInfo {
+        char magic[4];
+        uint32_t reserved;
+        uint64_t size;
+        uint64_t fileSize;
+        int64_t lastWriteTime;
+    };
+
+    Counter& sentBytes() {
+        static Counter& Bytes = Metrics::instance().counter(
+            "asset_sent_bytes_total",
+            "The bytes of files that the master has sent to the other nodes"
+        );
+        return Bytes;
+    }
+
+    Counter& fetchedBytes() {
+        static Counter& Bytes = Metrics::instance().counter(
+            "asset_fetched_bytes_total",
+            "The bytes of files that this node has received from the master"
+        );
+        return Bytes;
+    }
+
+    // FNV-1a consuming 8 bytes at a time, in the same way as the keys of the images
+    uint64_t checksum(const unsigned char* data, size_t size) {
+        constexpr const uint64_t Prime = 0x100000001b3;
+        uint64_t hash = 0xcbf29ce484222325;
+
+        const size_t nWords = size / sizeof(uint64_t);
+        for (size_t i = 0; i < nWords; ++i) {
+            uint64_t word;
+            std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+            hash = (hash ^ word) * Prime;
+        }
+        for (size_t i = nWords * sizeof(uint64_t); i < size; ++i) {
+            hash = (hash ^ data[i]) * Prime;
+        }
+        return hash;
+    }
+
+    void append(std::vector<unsigned char>& buffer, const void* data, size_t size) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+        buffer.insert(buffer.end(), p, p + size);
+    }
+
+    template <typename T>
+    void append(std::vector<unsigned char>& buffer, const T& value) {
+        append(buffer, &value, sizeof(T));
+    }
+
+    void appendString(std::vector<unsigned char>& buffer, const std::string& value) {
+        append(buffer, static_cast<uint32_t>(value.size()));
+        append(buffer, value.data(), value.size());
+    }
+
+    // Returns false if the buffer does not contain the whole value at the offset yet
+    template <typename T>
+    bool read(const std::vector<unsigned char>& buffer, size_t offset, T& value) {
+        if (buffer.size() - offset < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, buffer.data() + offset, sizeof(T));
+        return true;
+    }
+
+    bool fileInfo(const fs::path& path, uint64_t& fileSize, int64_t& lastWriteTime) {
+        std::error_code sizeError;
+        fileSize = fs::file_size(path, sizeError);
+        std::error_code timeError;
+        const fs::file_time_type t = fs::last_write_time(path, timeError);
+        lastWriteTime = static_cast<int64_t>(t.time_since_epoch().count());
+        return !sizeError && !timeError;
+    }
+
+    std::vector<unsigned char> readFile(const fs::path& path) {
+        std::ifstream f(path, std::ios::binary | std::ios::ate);
+        if (!f.good()) {
+            throw std::runtime_error("Could not open file");
+        }
+
+        std::vector<unsigned char> res(static_cast<size_t>(f.tellg()));
+        f.seekg(0);
+        f.read(reinterpret_cast<char*>(res.data()), res.size());
+        if (!f.good()) {
+            throw std::runtime_error("Could not read file");
+        }
+        return res;
+    }
+
+    // Relative paths are resolved by the master, whose working folder is the folder of
+    // the same configuration file
+    std::string requestPath(const fs::path& path) {
+        return path.lexically_normal().generic_string();
+    }
+
+    std::string requestKey(uint32_t type, const std::string& path) {
+        return std::to_string(type) + ':' + path;
+    }
+
+    fs::path infoPath(const fs::path& local) {
+        fs::path res = local;
+        res += ".info";
+        return res;
+    }
+
+    fs::path partPath(const fs::path& local) {
+        fs::path res = local;
+        res += ".part";
+        return res;
+    }
+
+    // Returns false if there is no local copy or it does not match its info file
+    bool readCacheInfo(const fs::path& local, CacheInfo& info) {
+        std::ifstream f(infoPath(local), std::ios::binary);
+        f.read(reinterpret_cast<char*>(&info), sizeof(CacheInfo));
+        if (!f.good() || std::memcmp(info.magic, Magic, sizeof(Magic)) != 0) {
+            return false;
+        }
+        std::error_code ec;
+        const uint64_t size = fs::file_size(local, ec);
+        return !ec && size == info.size;
+    }
+
+    void writeCacheInfo(const fs::path& local, const CacheInfo& info) {
+        std::ofstream f(infoPath(local), std::ios::binary);
+        f.write(reinterpret_cast<const char*>(&info), sizeof(CacheInfo));
+    }
+
+    std::vector<unsigned char> serializeGeometry(const Mesh::Geometry& geometry) {
+        std::vector<unsigned char> res;
+        append(res, static_cast<uint32_t>(geometry.vertices.size()));
+        append(res, geometry.vertices.data(), geometry.vertices.size() * sizeof(Vertex));
+        append(res, static_cast<uint32_t>(geometry.parts.size()));
+        for (const Mesh::Part& part : geometry.parts) {
+            append(res, part.first);
+            append(res, part.nVertices);
+            appendString(res, part.material);
+            appendString(res, part.texture);
+        }
+        return res;
+    }
+
+    Mesh::Geometry deserializeGeometry(const std::vector<unsigned char>& data) {
+        size_t offset = 0;
+        auto take = [&data, &offset](void* value, size_t size) {
+            if (data.size() - offset < size) {
+                throw std::runtime_error("Geometry is truncated");
+            }
+            std::memcpy(value, data.data() + offset, size);
+            offset += size;
+        };
+        auto takeString = [&take](std::string& value) {
+            uint32_t size = 0;
+            take(&size, sizeof(uint32_t));
+            value.resize(size);
+            take(value.data(), size);
+        };
+
+        Mesh::Geometry res;
+        uint32_t nVertices = 0;
+        take(&nVertices, sizeof(uint32_t));
+        if (nVertices > data.size() / sizeof(Vertex)) {
+            throw std::runtime_error("Geometry is truncated");
+        }
+        res.vertices.resize(nVertices);
+        take(res.vertices.data(), nVertices * sizeof(Vertex));
+
+        uint32_t nParts = 0;
+        take(&nParts, sizeof(uint32_t));
+        for (uint32_t i = 0; i < nParts; ++i) {
+            Mesh::Part part;
+            take(&part.first, sizeof(uint32_t));
+            take(&part.nVertices, sizeof(uint32_t));
+            takeString(part.material);
+            takeString(part.texture);
+            if (uint64_t(part.first) + part.nVertices > nVertices) {
+                throw std::runtime_error("Part is outside of the vertices");
+            }
+            res.parts.push_back(std::move(part));
+        }
+        return res;
+    }
+
+    // Removes a trailing separator so that all components of the folder are names
+    fs::path normalizedFolder(const fs::path& folder) {
+        std::error_code ec;
+        fs::path res = fs::weakly_canonical(folder, ec);
+        if (ec) {
+            res = fs::absolute(folder).lexically_normal();
+        }
+        return res.filename().empty() ? res.parent_path() : res;
+    }
+
+    std::mutex ClientMutex;
+    std::shared_ptr<AssetClient> Client;
+
+    std::shared_ptr<AssetClient> currentClient() {
+        std::lock_guard lock(ClientMutex);
+        return Client;
+    }
+} // namespace
+
+AssetServer::AssetServer(Settings settings, std::vector<fs::path> folders)
+    : _settings(settings)
+    , _listener(settings.port, false)
+{
+    for (const fs::path& folder : folders) {
+        // An empty path would allow every file
+        if (!folder.empty()) {
+            _folders.push_back(normalizedFolder(folder));
+        }
+    }
+    _thread = std::thread(&AssetServer::run, this);
+}
+
+AssetServer::~AssetServer() {
+    _isRunning = false;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+}
+
+void AssetServer::run() {
+    Trace::instance().setThreadName("Asset server");
+    while (_isRunning) {
+        bool hasProgress = false;
+        while (std::optional<TcpConnection> c = _listener.accept()) {
+            _clients.push_back({ std::move(*c), {}, {}, 0, nullptr, 0, true });
+            hasProgress = true;
+        }
+
+        for (Client& client : _clients) {
+            hasProgress |= serve(client);
+        }
+        _clients.erase(
+            std::remove_if(
+                _clients.begin(),
+                _clients.end(),
+                [](const Client& c) { return !c.isValid || !c.connection.isOpen(); }
+            ),
+            _clients.end()
+        );
+
+        if (!hasProgress) {
+            std::this_thread::sleep_for(IdleWait);
+        }
+    }
+}
+
+bool AssetServer::serve(Client& client) {
+    bool hasProgress = false;
+    unsigned char buffer[4096];
+    while (size_t n = client.connection.receive(buffer, sizeof(buffer))) {
+        client.received.insert(client.received.end(), buffer, buffer + n);
+        hasProgress = true;
+    }
+
+    // Only one chunk is prepared at a time so that all nodes are served in turns
+    if (client.nSentBytes == client.response.size()) {
+        client.response.clear();
+        client.nSentBytes = 0;
+
+        RequestHeader header;
+        if (client.blob) {
+            sendChunk(client);
+        }
+        else if (read(client.received, 0, header)) {
+            if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+                header.pathLength > MaxPathLength)
+            {
+                sgct::Log::Warning("Closing asset connection after an invalid request");
+                client.isValid = false;
+                return true;
+            }
+
+            const size_t size = sizeof(RequestHeader) + header.pathLength;
+            if (client.received.size() >= size) {
+                const std::string path(
+                    reinterpret_cast<const char*>(client.received.data()) +
+                        sizeof(RequestHeader),
+                    header.pathLength
+                );
+                client.received.erase(
+                    client.received.begin(),
+                    client.received.begin() + size
+                );
+                respond(
+                    client,
+                    header.type,
+                    header.id,
+                    path,
+                    header.fileSize,
+                    header.lastWriteTime
+                );
+            }
+        }
+    }
+
+    if (client.nSentBytes < client.response.size()) {
+        const size_t n = client.connection.send(
+            client.response.data() + client.nSentBytes,
+            client.response.size() - client.nSentBytes
+        );
+        client.nSentBytes += n;
+        hasProgress |= n > 0;
+    }
+    return hasProgress;
+}
+
+void AssetServer::respond(Client& client, uint32_t type, uint32_t id,
+                          const std::string& path, uint64_t fileSize,
+                          int64_t lastWriteTime)
+{
+    ResponseHeader header = {};
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.id = id;
+    header.status = StatusMissing;
+
+    if (!isAllowed(path)) {
+        sgct::Log::Warning("Refusing to send %s, which is not an asset", path.c_str());
+    }
+    else if (fileInfo(path, header.fileSize, header.lastWriteTime)) {
+        if (header.fileSize == fileSize && header.lastWriteTime == lastWriteTime) {
+            header.status = StatusUnchanged;
+        }
+        else {
+            try {
+                client.blob = blob(type, path, header.fileSize, header.lastWriteTime);
+                client.nextChunk = 0;
+                header.status = StatusSent;
+                header.size = client.blob->data.size();
+                header.nChunks = static_cast<uint32_t>(
+                    (header.size + chunkSize() - 1) / chunkSize()
+                );
+            }
+            catch (const std::runtime_error& e) {
+                sgct::Log::Error("Error reading asset %s: %s", path.c_str(), e.what());
+            }
+        }
+    }
+    if (header.nChunks == 0) {
+        client.blob = nullptr;
+    }
+    append(client.response, header);
+}
+
+void AssetServer::sendChunk(Client& client) {
+    const uint64_t offset = uint64_t(client.nextChunk) * chunkSize();
+    const uint64_t size = std::min<uint64_t>(
+        client.blob->data.size() - offset,
+        chunkSize()
+    );
+    const unsigned char* data = client.blob->data.data() + offset;
+
+    ChunkHeader chunk;
+    chunk.index = client.nextChunk;
+    chunk.size = static_cast<uint32_t>(size);
+    chunk.checksum = checksum(data, size);
+    append(client.response, chunk);
+    append(client.response, data, size);
+    sentBytes().add(size);
+
+    client.nextChunk++;
+    if (offset + size == client.blob->data.size()) {
+        client.blob = nullptr;
+    }
+}
+
+uint32_t AssetServer::chunkSize() const {
+    return std::clamp<uint32_t>(_settings.chunkSize, 1, MaxChunkSize);
+}
+
+std::shared_ptr<const AssetServer::Blob> AssetServer::blob(uint32_t type,
+                                                           const fs::path& path,
+                                                           uint64_t fileSize,
+                                                           int64_t lastWriteTime)
+{
+    const std::string key = requestKey(type, requestPath(path));
+    auto it = _blobs.find(key);
+    if (it != _blobs.end()) {
+        _blobOrder.remove(key);
+        const Blob& b = *it->second;
+        if (b.fileSize == fileSize && b.lastWriteTime == lastWriteTime) {
+            _blobOrder.push_back(key);
+            return it->second;
+        }
+        _nCachedBytes -= b.data.size();
+        _blobs.erase(it);
+    }
+
+    auto res = std::make_shared<Blob>();
+    if (type == GeometryRequest) {
+        TraceScope scope("Parse asset");
+        const Mesh::Geometry geometry = Mesh::geometryFromModel(
+            obj::loadObjFile(path.string())
+        );
+        // The nodes can only ask for the textures of the materials once they know about
+        // them, which is the case now
+        for (const Mesh::Part& part : geometry.parts) {
+            if (!part.texture.empty() && !isAllowed(part.texture)) {
+                const fs::path folder = fs::absolute(part.texture).parent_path();
+                _folders.push_back(normalizedFolder(folder));
+            }
+        }
+        res->data = serializeGeometry(geometry);
+    }
+    else {
+        TraceScope scope("Read asset");
+        res->data = readFile(path);
+    }
+    res->fileSize = fileSize;
+    res->lastWriteTime = lastWriteTime;
+
+    _blobs[key] = res;
+    _blobOrder.push_back(key);
+    _nCachedBytes += res->data.size();
+    while (_nCachedBytes > _settings.maxCachedBytes && !_blobOrder.empty()) {
+        // Blobs that are still being sent are kept alive by their clients
+        auto oldest = _blobs.find(_blobOrder.front());
+        _nCachedBytes -= oldest->second->data.size();
+        _blobs.erase(oldest);
+        _blobOrder.pop_front();
+    }
+    return res;
+}
+
+bool AssetServer::isAllowed(const fs::path& path) const {
+    std::error_code ec;
+    const fs::path p = fs::weakly_canonical(path, ec);
+    if (ec) {
+        return false;
+    }
+    for (const fs::path& folder : _folders) {
+        // The file is inside of the folder if its path starts with the folder's path
+        auto [f, _] = std::mismatch(folder.begin(), folder.end(), p.begin(), p.end());
+        if (f == folder.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct AssetClient::Request {
+    uint32_t type = FileRequest;
+    std::string path;
+    fs::path local;
+    uint32_t id = 0;
+    int nAttempts = 0;
+    bool isDone = false;
+    bool isUpToDate = false;
+};
+
+struct AssetClient::Response {
+    std::shared_ptr<Request> request;
+    ResponseHeader header;
+    uint32_t nextChunk = 0;
+    uint64_t nReceivedBytes = 0;
+    bool isCorrupt = false;
+    std::ofstream file;
+};
+
+void AssetClient::initialize(Settings settings) {
+    std::error_code ec;
+    fs::create_directories(settings.cacheFolder, ec);
+    if (ec) {
+        sgct::Log::Error(
+            "Reading assets directly, could not create the cache folder %s",
+            settings.cacheFolder.string().c_str()
+        );
+        return;
+    }
+
+    auto client = std::make_shared<AssetClient>(std::move(settings));
+    std::lock_guard lock(ClientMutex);
+    Client = std::move(client);
+}
+
+void AssetClient::deinitialize() {
+    std::shared_ptr<AssetClient> client;
+    {
+        std::lock_guard lock(ClientMutex);
+        client = std::move(Client);
+    }
+    if (client) {
+        // Threads that are waiting for a file keep the client alive, so they have to be
+        // woken up before it can be destroyed
+        client->stop();
+    }
+}
+
+fs::path AssetClient::fetch(const fs::path& path) {
+    std::shared_ptr<AssetClient> client = currentClient();
+    if (!client) {
+        return path;
+    }
+
+    TraceScope scope("Fetch asset");
+    const std::string p = requestPath(path);
+    const fs::path local = client->localPath(FileRequest, p);
+    return client->request(FileRequest, p, local) ? local : path;
+}
+
+fs::path AssetClient::cachedPath(const fs::path& path) {
+    std::shared_ptr<AssetClient> client = currentClient();
+    return client ? client->localPath(FileRequest, requestPath(path)) : path;
+}
+
+std::optional<Mesh::Geometry> AssetClient::fetchGeometry(const std::string& objFile) {
+    std::shared_ptr<AssetClient> client = currentClient();
+    if (!client) {
+        return std::nullopt;
+    }
+
+    TraceScope scope("Fetch asset");
+    const std::string p = requestPath(objFile);
+    const fs::path local = client->localPath(GeometryRequest, p);
+    if (!client->request(GeometryRequest, p, local)) {
+        return std::nullopt;
+    }
+    try {
+        return deserializeGeometry(readFile(local));
+    }
+    catch (const std::runtime_error& e) {
+        sgct::Log::Error("Error reading geometry of %s: %s", objFile.c_str(), e.what());
+        // The next fetch has to get a new copy
+        std::error_code ec;
+        fs::remove(infoPath(local), ec);
+        invalidate(objFile);
+        return std::nullopt;
+    }
+}
+
+void AssetClient::invalidate(const fs::path& path) {
+    std::shared_ptr<AssetClient> client = currentClient();
+    if (!client) {
+        return;
+    }
+
+    const std::string p = requestPath(path);
+    std::lock_guard lock(client->_mutex);
+    client->_upToDate.erase(requestKey(FileRequest, p));
+    client->_upToDate.erase(requestKey(GeometryRequest, p));
+}
+
+AssetClient::AssetClient(Settings settings)
+    : _settings(std::move(settings))
+{
+    // The files of earlier runs are the least recently used ones, ordered by when they
+    // were fetched. Files that were still being received are of no use
+    std::vector<std::pair<int64_t, fs::path>> files;
+    std::error_code ec;
+    const fs::directory_iterator folder(_settings.cacheFolder, ec);
+    for (const fs::directory_entry& e : folder) {
+        const fs::path& p = e.path();
+        if (p.extension() == ".part") {
+            fs::remove(p, ec);
+        }
+        else if (p.extension() != ".info" && e.is_regular_file(ec)) {
+            const fs::file_time_type t = fs::last_write_time(p, ec);
+            files.emplace_back(static_cast<int64_t>(t.time_since_epoch().count()), p);
+        }
+    }
+    std::sort(files.begin(), files.end());
+    for (const std::pair<int64_t, fs::path>& file : files) {
+        use("", file.second);
+    }
+
+    _thread = std::thread(&AssetClient::run, this);
+}
+
+AssetClient::~AssetClient() {
+    stop();
+}
+
+void AssetClient::stop() {
+    _isRunning = false;
+    _condition.notify_all();
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    fail();
+}
+
+bool AssetClient::request(uint32_t type, const std::string& path, const fs::path& local) {
+    const std::string key = requestKey(type, path);
+
+    std::unique_lock lock(_mutex);
+    if (_upToDate.find(key) != _upToDate.end()) {
+        lock.unlock();
+        use(key, local);
+        return true;
+    }
+    if (_hasFailed) {
+        return false;
+    }
+
+    std::shared_ptr<Request> request;
+    auto it = _requests.find(key);
+    if (it != _requests.end()) {
+        request = it->second;
+    }
+    else {
+        request = std::make_shared<Request>();
+        request->type = type;
+        request->path = path;
+        request->local = local;
+        _requests[key] = request;
+        _queue.push_back(request);
+        _condition.notify_all();
+    }
+
+    _condition.wait(lock, [&request]() { return request->isDone; });
+    return request->isUpToDate;
+}
+
+fs::path AssetClient::localPath(uint32_t type, const std::string& path) const {
+    // The extension is kept as some images are recognized by it
+    const std::string key = requestKey(type, path);
+    const uint64_t hash = checksum(
+        reinterpret_cast<const unsigned char*>(key.data()),
+        key.size()
+    );
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+    const std::string extension = type == GeometryRequest ?
+        ".geometry" :
+        fs::path(path).extension().string();
+    return _settings.cacheFolder / (name + extension);
+}
+
+void AssetClient::run() {
+    Trace::instance().setThreadName("Asset client");
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (_isRunning && !_connection.has_value()) {
+        try {
+            _connection = TcpConnection::connect(_settings.masterAddress, _settings.port);
+            sgct::Log::Info(
+                "Fetching assets from %s:%u",
+                _settings.masterAddress.c_str(), _settings.port
+            );
+        }
+        catch (const std::runtime_error& e) {
+            if (std::chrono::steady_clock::now() - start > ConnectTimeout) {
+                sgct::Log::Error("Reading assets directly: %s", e.what());
+                fail();
+                return;
+            }
+            std::this_thread::sleep_for(RetryInterval);
+        }
+    }
+
+    while (_isRunning) {
+        std::deque<std::shared_ptr<Request>> requests;
+        {
+            std::unique_lock lock(_mutex);
+            if (_queue.empty() && _inFlight.empty() && _sendBuffer.empty()) {
+                _condition.wait_for(
+                    lock,
+                    IdleTimeout,
+                    [this]() { return !_queue.empty() || !_isRunning; }
+                );
+            }
+            requests.swap(_queue);
+        }
+
+        for (const std::shared_ptr<Request>& request : requests) {
+            RequestHeader header = {};
+            std::memcpy(header.magic, Magic, sizeof(Magic));
+            header.type = request->type;
+            header.id = _nextId++;
+            header.pathLength = static_cast<uint32_t>(request->path.size());
+            CacheInfo info;
+            if (readCacheInfo(request->local, info)) {
+                header.fileSize = info.fileSize;
+                header.lastWriteTime = info.lastWriteTime;
+            }
+            append(_sendBuffer, header);
+            append(_sendBuffer, request->path.data(), request->path.size());
+            request->id = header.id;
+            _inFlight.push_back(request);
+        }
+
+        bool hasProgress = false;
+        if (_nSentBytes < _sendBuffer.size()) {
+            const size_t n = _connection->send(
+                _sendBuffer.data() + _nSentBytes,
+                _sendBuffer.size() - _nSentBytes
+            );
+            _nSentBytes += n;
+            hasProgress = n > 0;
+            if (_nSentBytes == _sendBuffer.size()) {
+                _sendBuffer.clear();
+                _nSentBytes = 0;
+            }
+        }
+
+        if (!receive(hasProgress)) {
+            sgct::Log::Error("Reading assets directly, the master sent invalid data");
+            break;
+        }
+        if (!_connection->isOpen()) {
+            if (_isRunning) {
+                sgct::Log::Error(
+                    "Reading assets directly, lost the connection to the master"
+                );
+            }
+            break;
+        }
+
+        if (!hasProgress) {
+            std::this_thread::sleep_for(IdleWait);
+        }
+    }
+
+    _connection = std::nullopt;
+    _inFlight.clear();
+    _response = nullptr;
+    fail();
+}
+
+bool AssetClient::receive(bool& hasReceived) {
+    unsigned char buffer[64 * 1024];
+    while (size_t n = _connection->receive(buffer, sizeof(buffer))) {
+        hasReceived = true;
+        _received.insert(_received.end(), buffer, buffer + n);
+
+        size_t offset = 0;
+        for (;;) {
+            if (!_response) {
+                ResponseHeader header;
+                if (!read(_received, offset, header)) {
+                    break;
+                }
+                if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 ||
+                    _inFlight.empty() || header.id != _inFlight.front()->id)
+                {
+                    return false;
+                }
+                offset += sizeof(ResponseHeader);
+
+                std::shared_ptr<Request> request = std::move(_inFlight.front());
+                _inFlight.pop_front();
+                if (header.status == StatusUnchanged) {
+                    finish(request, true);
+                    continue;
+                }
+                if (header.status != StatusSent) {
+                    sgct::Log::Warning(
+                        "The master could not provide %s", request->path.c_str()
+                    );
+                    finish(request, false);
+                    continue;
+                }
+
+                // The old version is no longer valid once the new one starts to arrive
+                std::error_code ec;
+                fs::remove(infoPath(request->local), ec);
+                _response = std::make_unique<Response>();
+                _response->request = std::move(request);
+                _response->header = header;
+                _response->file.open(
+                    partPath(_response->request->local),
+                    std::ios::binary | std::ios::trunc
+                );
+                if (header.nChunks == 0) {
+                    complete();
+                }
+                continue;
+            }
+
+            ChunkHeader chunk;
+            if (!read(_received, offset, chunk)) {
+                break;
+            }
+            if (chunk.size > MaxChunkSize) {
+                return false;
+            }
+            if (_received.size() - offset - sizeof(ChunkHeader) < chunk.size) {
+                break;
+            }
+
+            const unsigned char* data = _received.data() + offset + sizeof(ChunkHeader);
+            if (chunk.index != _response->nextChunk ||
+                chunk.checksum != checksum(data, chunk.size))
+            {
+                _response->isCorrupt = true;
+            }
+            else {
+                _response->file.write(reinterpret_cast<const char*>(data), chunk.size);
+            }
+            _response->nextChunk++;
+            _response->nReceivedBytes += chunk.size;
+            offset += sizeof(ChunkHeader) + chunk.size;
+            fetchedBytes().add(chunk.size);
+
+            if (_response->nextChunk == _response->header.nChunks) {
+                complete();
+            }
+        }
+        _received.erase(_received.begin(), _received.begin() + offset);
+    }
+    return true;
+}
+
+void AssetClient::complete() {
+    std::unique_ptr<Response> response = std::move(_response);
+    std::shared_ptr<Request> request = std::move(response->request);
+    response->file.close();
+    const fs::path part = partPath(request->local);
+
+    const bool isComplete = !response->isCorrupt && !response->file.fail() &&
+        response->nReceivedBytes == response->header.size;
+    if (isComplete) {
+        std::error_code ec;
+        fs::rename(part, request->local, ec);
+        if (ec) {
+            sgct::Log::Error(
+                "Error storing %s: %s", request->path.c_str(), ec.message().c_str()
+            );
+            finish(request, false);
+            return;
+        }
+
+        CacheInfo info = {};
+        std::memcpy(info.magic, Magic, sizeof(Magic));
+        info.size = response->header.size;
+        info.fileSize = response->header.fileSize;
+        info.lastWriteTime = response->header.lastWriteTime;
+        writeCacheInfo(request->local, info);
+        finish(request, true);
+        return;
+    }
+
+    std::error_code ec;
+    fs::remove(part, ec);
+    request->nAttempts++;
+    if (response->isCorrupt && request->nAttempts < MaxAttempts) {
+        sgct::Log::Warning(
+            "Checksum mismatch in %s, fetching it again", request->path.c_str()
+        );
+        std::lock_guard lock(_mutex);
+        _queue.push_back(std::move(request));
+        return;
+    }
+    sgct::Log::Error("Could not fetch %s from the master", request->path.c_str());
+    finish(request, false);
+}
+
+void AssetClient::use(const std::string& key, const fs::path& local) {
+    std::error_code ec;
+    const uint64_t size = fs::file_size(local, ec);
+    const std::string name = local.filename().string();
+
+    std::lock_guard lock(_mutex);
+    auto it = _cachedFiles.find(name);
+    if (it != _cachedFiles.end()) {
+        _nCachedBytes -= it->second.size;
+        _cacheOrder.erase(it->second.order);
+    }
+    else {
+        it = _cachedFiles.emplace(name, CachedFile()).first;
+    }
+    if (!key.empty()) {
+        it->second.key = key;
+    }
+    it->second.size = ec ? 0 : size;
+    it->second.order = _cacheOrder.insert(_cacheOrder.end(), name);
+    _nCachedBytes += it->second.size;
+
+    // The file that was just used is kept even if it is larger than the cache on its own
+    while (_nCachedBytes > _settings.maxCacheBytes && _cacheOrder.front() != name) {
+        auto oldest = _cachedFiles.find(_cacheOrder.front());
+        const fs::path p = _settings.cacheFolder / oldest->first;
+        fs::remove(p, ec);
+        fs::remove(infoPath(p), ec);
+        _upToDate.erase(oldest->second.key);
+        _nCachedBytes -= oldest->second.size;
+        _cacheOrder.pop_front();
+        _cachedFiles.erase(oldest);
+    }
+}
+
+void AssetClient::finish(const std::shared_ptr<Request>& request, bool isUpToDate) {
+    const std::string key = requestKey(request->type, request->path);
+    if (isUpToDate) {
+        use(key, request->local);
+    }
+
+    std::lock_guard lock(_mutex);
+    request->isDone = true;
+    request->isUpToDate = isUpToDate;
+    _requests.erase(key);
+    if (isUpToDate) {
+        _upToDate.insert(key);
+    }
+    _condition.notify_all();
+}
+
+void AssetClient::fail() {
+    std::lock_guard lock(_mutex);
+    _hasFailed = true;
+    for (const std::pair<const std::string, std::shared_ptr<Request>>& p : _requests) {
+        p.second->isDone = true;
+        p.second->isUpToDate = false;
+    }
+    _requests.clear();
+    _queue.clear();
+    _condition.notify_all();
+}
@@ -0,0 +1,233 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __ASSETCACHE_H__
+#define __ASSETCACHE_H__
+
+#include "mesh.h"
+#include "socket.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lets the master read the obj files and images from the shared storage so that the
+// other nodes don't all read the same files at the same time. The nodes request the
+// files from the master over a TCP connection and store them in a local cache folder,
+// which is kept between runs and only fetched again once the file has changed. The
+// files are sent in chunks, each with its own checksum, and a file whose checksums
+// don't match is requested again
+
+// Answers the requests of the nodes on the master. The server runs on its own thread and
+// keeps the most recently requested files in memory, as all nodes ask for the same files
+// at about the same time
+class AssetServer {
+public:
+    struct Settings {
+        uint16_t port = 27700;
+        // The files are split into chunks of this size, each with its own checksum
+        uint32_t chunkSize = 1024 * 1024;
+        // The files that are kept in memory after they have been sent
+        uint64_t maxCachedBytes = 512 * 1024 * 1024;
+    };
+
+    // Only the files inside of the folders can be requested. All errors during setup are
+    // reported as exceptions
+    AssetServer(Settings settings, std::vector<std::filesystem::path> folders);
+    ~AssetServer();
+
+    AssetServer(const AssetServer&) = delete;
+    AssetServer& operator=(const AssetServer&) = delete;
+
+private:
+    // A file or a parsed obj file as it is sent to the nodes, together with the version
+    // of the file it was created from
+    struct Blob {
+        std::vector<unsigned char> data;
+        uint64_t fileSize = 0;
+        int64_t lastWriteTime = 0;
+    };
+
+    struct Client {
+        TcpConnection connection;
+        std::vector<unsigned char> received;
+        std::vector<unsigned char> response;
+        size_t nSentBytes = 0;
+        // The blob whose chunks are being sent, the next request is only handled once
+        // all chunks are on their way
+        std::shared_ptr<const Blob> blob;
+        uint32_t nextChunk = 0;
+        // Is false once the client has sent something that is not a request
+        bool isValid = true;
+    };
+
+    void run();
+    // Sends the next part of the response and returns whether anything happened
+    bool serve(Client& client);
+    // Answers the request of a node that has the version of the file with the size and
+    // modification time, which are 0 if it has no copy yet
+    void respond(Client& client, uint32_t type, uint32_t id, const std::string& path,
+        uint64_t fileSize, int64_t lastWriteTime);
+    void sendChunk(Client& client);
+    uint32_t chunkSize() const;
+    std::shared_ptr<const Blob> blob(uint32_t type, const std::filesystem::path& path,
+        uint64_t fileSize, int64_t lastWriteTime);
+    bool isAllowed(const std::filesystem::path& path) const;
+
+    const Settings _settings;
+    std::vector<std::filesystem::path> _folders;
+
+    TcpListener _listener;
+    std::vector<Client> _clients;
+
+    // The blobs by type and path, the least recently used ones are at the front of the
+    // list and are removed first
+    std::map<std::string, std::shared_ptr<const Blob>> _blobs;
+    std::list<std::string> _blobOrder;
+    uint64_t _nCachedBytes = 0;
+
+    std::atomic<bool> _isRunning = true;
+    std::thread _thread;
+};
+
+// Fetches the files from the master on the other nodes. Until initialize is called, and
+// on the master, all functions return the original files and all files are read from
+// the shared storage directly
+class AssetClient {
+public:
+    struct Settings {
+        std::string masterAddress;
+        uint16_t port = 27700;
+        // Can be on a RAM disk, such as /dev/shm, to keep the files in memory. Every node
+        // needs its own folder
+        std::filesystem::path cacheFolder = "asset-cache";
+        // The least recently used files are removed once the cache is larger than this
+        uint64_t maxCacheBytes = uint64_t(4096) * 1024 * 1024;
+    };
+
+    // Starts connecting to the master in the background
+    static void initialize(Settings settings);
+    static void deinitialize();
+
+    // Returns the local copy of the file, which is fetched from the master first unless
+    // it is known to be up to date. Returns the path itself if the master could not
+    // provide the file. Blocks until the file has arrived and is safe to call from any
+    // thread
+    static std::filesystem::path fetch(const std::filesystem::path& path);
+
+    // Returns where the local copy of the file is stored, without fetching it
+    static std::filesystem::path cachedPath(const std::filesystem::path& path);
+
+    // Returns the geometry of the obj file as it was parsed by the master, or nothing if
+    // the master could not provide it. The textures of the materials are fetched
+    // separately when they are loaded
+    static std::optional<Mesh::Geometry> fetchGeometry(const std::string& objFile);
+
+    // Has to be called once the file has changed so that the next fetch asks the master
+    // for the new version
+    static void invalidate(const std::filesystem::path& path);
+
+    explicit AssetClient(Settings settings);
+    ~AssetClient();
+
+    AssetClient(const AssetClient&) = delete;
+    AssetClient& operator=(const AssetClient&) = delete;
+
+private:
+    struct Request;
+    struct Response;
+
+    // Returns whether the local copy is up to date after waiting for the master
+    bool request(uint32_t type, const std::string& path,
+        const std::filesystem::path& local);
+    std::filesystem::path localPath(uint32_t type, const std::string& path) const;
+    // Marks the local copy as the most recently used one and removes the least recently
+    // used ones if the cache has become too large
+    void use(const std::string& key, const std::filesystem::path& local);
+
+    void run();
+    void stop();
+    // Reads the responses that have arrived, returns false if the connection has to be
+    // closed because the master sent something that is not a response
+    bool receive(bool& hasReceived);
+    // Stores the file once all chunks of the response have arrived, or requests it
+    // again if any of them was corrupted
+    void complete();
+    void finish(const std::shared_ptr<Request>& request, bool isUpToDate);
+    // Fails all requests that have not been answered yet and all future ones
+    void fail();
+
+    const Settings _settings;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    // The requests by type and path, so that a file that is needed by multiple threads is
+    // only requested once
+    std::map<std::string, std::shared_ptr<Request>> _requests;
+    std::deque<std::shared_ptr<Request>> _queue;
+    // The local copies that have been checked against the master since starting
+    std::set<std::string> _upToDate;
+    bool _hasFailed = false;
+
+    // The local copies from the least to the most recently used one, by file name
+    struct CachedFile {
+        std::string key;
+        uint64_t size = 0;
+        std::list<std::string>::iterator order;
+    };
+    std::map<std::string, CachedFile> _cachedFiles;
+    std::list<std::string> _cacheOrder;
+    uint64_t _nCachedBytes = 0;
+
+    // Only used on the network thread
+    std::optional<TcpConnection> _connection;
+    uint32_t _nextId = 0;
+    std::deque<std::shared_ptr<Request>> _inFlight;
+    std::vector<unsigned char> _sendBuffer;
+    size_t _nSentBytes = 0;
+    std::vector<unsigned char> _received;
+    // The response whose chunks are being received
+    std::unique_ptr<Response> _response;
+
+    std::atomic<bool> _isRunning = true;
+    std::thread _thread;
+};
+
+#endif // __ASSETCACHE_H__
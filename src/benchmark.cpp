@@ -0,0 +1,275 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "benchmark.h"
+
+#include "metrics.h"
+#include <sgct/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else // WIN32
+#include <sys/resource.h>
+#endif // WIN32
+
+namespace {
+    constexpr const char ReplayMagic[] = "OBJREPLAY2";
+
+    struct Field {
+        const char* name;
+        double BenchmarkReport::* real = nullptr;
+        uint64_t BenchmarkReport::* integer = nullptr;
+        // Fields that depend on the workload rather than on the performance are not
+        // compared between runs
+        bool isCompared = false;
+    };
+
+    const Field Fields[] = {
+        { "nFrames", nullptr, &BenchmarkReport::nFrames },
+        { "duration", &BenchmarkReport::duration },
+        { "frameTimeMean", &BenchmarkReport::frameTimeMean, nullptr, true },
+        { "frameTimeP50", &BenchmarkReport::frameTimeP50, nullptr, true },
+        { "frameTimeP95", &BenchmarkReport::frameTimeP95, nullptr, true },
+        { "frameTimeP99", &BenchmarkReport::frameTimeP99, nullptr, true },
+        { "frameTimeMax", &BenchmarkReport::frameTimeMax },
+        { "nDecodedImages", nullptr, &BenchmarkReport::nDecodedImages },
+        { "decodeTime", &BenchmarkReport::decodeTime, nullptr, true },
+        { "uploadedBytes", nullptr, &BenchmarkReport::uploadedBytes, true },
+        { "peakResidentBytes", nullptr, &BenchmarkReport::peakResidentBytes, true }
+    };
+
+    double value(const BenchmarkReport& report, const Field& field) {
+        return field.real ?
+            report.*field.real :
+            static_cast<double>(report.*field.integer);
+    }
+
+    // The nearest-rank percentile of the sorted values
+    double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        const size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    uint64_t peakResidentBytes() {
+#ifdef WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+        return counters.PeakWorkingSetSize;
+#else // WIN32
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return static_cast<uint64_t>(usage.ru_maxrss);
+#else // __APPLE__
+        // Linux reports kilobytes
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif // __APPLE__
+#endif // WIN32
+    }
+
+    uint64_t nDecodedImages() {
+        const Histogram* h = Metrics::instance().findHistogram("decode_seconds");
+        return h ? h->count() : 0;
+    }
+
+    double decodeTime() {
+        const Histogram* h = Metrics::instance().findHistogram("decode_seconds");
+        return h ? h->sum() : 0.0;
+    }
+
+    uint64_t uploadedBytes() {
+        const Counter* c = Metrics::instance().findCounter("texture_upload_bytes_total");
+        return c ? c->value() : 0;
+    }
+} // namespace
+
+StateRecorder::StateRecorder(const std::filesystem::path& path)
+    : _file(path, std::ios::binary)
+{
+    if (!_file.good()) {
+        throw std::runtime_error("Could not create replay file " + path.string());
+    }
+    _file.write(ReplayMagic, sizeof(ReplayMagic));
+}
+
+void StateRecorder::record(const std::vector<std::byte>& state) {
+    const uint32_t size = static_cast<uint32_t>(state.size());
+    _file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    _file.write(reinterpret_cast<const char*>(state.data()), size);
+}
+
+StateReplay::StateReplay(const std::filesystem::path& path)
+    : _file(path, std::ios::binary)
+{
+    char magic[sizeof(ReplayMagic)] = {};
+    _file.read(magic, sizeof(magic));
+    if (!_file.good() || std::memcmp(magic, ReplayMagic, sizeof(magic)) != 0) {
+        throw std::runtime_error("Could not read replay file " + path.string());
+    }
+}
+
+bool StateReplay::next(std::vector<std::byte>& state) {
+    uint32_t size = 0;
+    _file.read(reinterpret_cast<char*>(&size), sizeof(size));
+    if (!_file.good()) {
+        return false;
+    }
+    state.resize(size);
+    _file.read(reinterpret_cast<char*>(state.data()), size);
+    return _file.good();
+}
+
+BenchmarkStats::BenchmarkStats(uint32_t nWarmupFrames)
+    : _nWarmupFrames(nWarmupFrames)
+{}
+
+void BenchmarkStats::addFrame(double frameTime) {
+    _nFrames++;
+    if (_nFrames <= _nWarmupFrames) {
+        return;
+    }
+    if (_frameTimes.empty()) {
+        _nDecodedImages = nDecodedImages();
+        _decodeTime = decodeTime();
+        _uploadedBytes = uploadedBytes();
+    }
+    _frameTimes.push_back(frameTime);
+}
+
+BenchmarkReport BenchmarkStats::report() const {
+    BenchmarkReport res;
+    res.nFrames = _frameTimes.size();
+    res.duration = std::accumulate(_frameTimes.begin(), _frameTimes.end(), 0.0);
+    if (!_frameTimes.empty()) {
+        std::vector<double> sorted = _frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        res.frameTimeMean = res.duration / sorted.size();
+        res.frameTimeP50 = percentile(sorted, 0.50);
+        res.frameTimeP95 = percentile(sorted, 0.95);
+        res.frameTimeP99 = percentile(sorted, 0.99);
+        res.frameTimeMax = sorted.back();
+        res.nDecodedImages = nDecodedImages() - _nDecodedImages;
+        res.decodeTime = decodeTime() - _decodeTime;
+        res.uploadedBytes = uploadedBytes() - _uploadedBytes;
+    }
+    res.peakResidentBytes = peakResidentBytes();
+    return res;
+}
+
+void saveReport(const std::filesystem::path& path, const BenchmarkReport& report) {
+    std::ofstream file(path);
+    if (!file.good()) {
+        throw std::runtime_error("Could not create report " + path.string());
+    }
+
+    file << "{\n";
+    for (size_t i = 0; i < std::size(Fields); ++i) {
+        const Field& f = Fields[i];
+        char line[128];
+        if (f.real) {
+            std::snprintf(line, sizeof(line), "  \"%s\": %.9g", f.name, report.*f.real);
+        }
+        else {
+            std::snprintf(
+                line,
+                sizeof(line),
+                "  \"%s\": %llu",
+                f.name,
+                static_cast<unsigned long long>(report.*f.integer)
+            );
+        }
+        file << line << (i + 1 < std::size(Fields) ? ",\n" : "\n");
+    }
+    file << "}\n";
+}
+
+BenchmarkReport loadReport(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    if (!file.good()) {
+        throw std::runtime_error("Could not open report " + path.string());
+    }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    const std::string contents = buffer.str();
+
+    BenchmarkReport res;
+    for (const Field& f : Fields) {
+        const std::string key = "\"" + std::string(f.name) + "\"";
+        const size_t keyPos = contents.find(key);
+        const size_t colon = contents.find(':', keyPos);
+        if (keyPos == std::string::npos || colon == std::string::npos) {
+            throw std::runtime_error("Missing value " + key + " in " + path.string());
+        }
+        const char* begin = contents.c_str() + colon + 1;
+        if (f.real) {
+            res.*f.real = std::strtod(begin, nullptr);
+        }
+        else {
+            res.*f.integer = std::strtoull(begin, nullptr, 10);
+        }
+    }
+    return res;
+}
+
+std::vector<std::string> compareReports(const BenchmarkReport& baseline,
+                                        const BenchmarkReport& candidate,
+                                        double threshold)
+{
+    std::vector<std::string> regressions;
+    for (const Field& f : Fields) {
+        const double base = value(baseline, f);
+        const double cand = value(candidate, f);
+        const double change = base != 0.0 ? (cand - base) / base : 0.0;
+        const bool isRegression = f.isCompared && change > threshold;
+        sgct::Log::Info(
+            "%-18s %14.6g -> %14.6g (%+6.1f%%)%s",
+            f.name,
+            base,
+            cand,
+            change * 100.0,
+            isRegression ? "  REGRESSION" : ""
+        );
+        if (isRegression) {
+            regressions.push_back(f.name);
+        }
+    }
+    return regressions;
+}
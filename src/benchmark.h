@@ -0,0 +1,112 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes the synchronized state of every frame, as produced by the encode callback, to a
+// file so that a session can be replayed later
+class StateRecorder {
+public:
+    explicit StateRecorder(const std::filesystem::path& path);
+
+    void record(const std::vector<std::byte>& state);
+
+private:
+    std::ofstream _file;
+};
+
+// Reads the frames of a file that was written by a StateRecorder
+class StateReplay {
+public:
+    explicit StateReplay(const std::filesystem::path& path);
+
+    // Returns false once all frames have been read
+    bool next(std::vector<std::byte>& state);
+
+private:
+    std::ifstream _file;
+};
+
+// The results of a benchmark run. The times are in seconds and the sizes in bytes
+struct BenchmarkReport {
+    uint64_t nFrames = 0;
+    double duration = 0.0;
+    double frameTimeMean = 0.0;
+    double frameTimeP50 = 0.0;
+    double frameTimeP95 = 0.0;
+    double frameTimeP99 = 0.0;
+    double frameTimeMax = 0.0;
+    uint64_t nDecodedImages = 0;
+    double decodeTime = 0.0;
+    uint64_t uploadedBytes = 0;
+    uint64_t peakResidentBytes = 0;
+};
+
+// Collects the frame times of a benchmark run together with the decode and upload
+// statistics of the metrics registry
+class BenchmarkStats {
+public:
+    // The first frames are excluded from the statistics as they include the loading
+    explicit BenchmarkStats(uint32_t nWarmupFrames);
+
+    void addFrame(double frameTime);
+
+    BenchmarkReport report() const;
+
+private:
+    const uint32_t _nWarmupFrames;
+    uint32_t _nFrames = 0;
+    std::vector<double> _frameTimes;
+
+    // The values of the metrics when the warmup ended
+    uint64_t _nDecodedImages = 0;
+    double _decodeTime = 0.0;
+    uint64_t _uploadedBytes = 0;
+};
+
+// The report is a flat JSON object
+void saveReport(const std::filesystem::path& path, const BenchmarkReport& report);
+BenchmarkReport loadReport(const std::filesystem::path& path);
+
+// Prints the differences between the reports and returns the names of the values that
+// are worse in the candidate by more than the threshold, which is relative to the
+// baseline
+std::vector<std::string> compareReports(const BenchmarkReport& baseline,
+    const BenchmarkReport& candidate, double threshold);
+
+#endif // __BENCHMARK_H__
@@ -0,0 +1,241 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "deltasync.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+    constexpr const uint8_t KeyframeFlag = 1;
+    constexpr const size_t MaxGroupSize = 64;
+
+    // Seven bits per byte, where the highest bit marks that more bytes follow
+    void writeVarint(std::vector<std::byte>& data, uint64_t value) {
+        while (value >= 0x80) {
+            data.push_back(static_cast<std::byte>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        data.push_back(static_cast<std::byte>(value));
+    }
+
+    // Maps small negative and positive differences to small unsigned numbers
+    uint64_t zigzag(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    template <typename T>
+    void writeBytes(std::vector<std::byte>& data, const T& value) {
+        const std::byte* p = reinterpret_cast<const std::byte*>(&value);
+        data.insert(data.end(), p, p + sizeof(T));
+    }
+
+    template <typename T>
+    uint64_t bits(const T& value) {
+        uint64_t res = 0;
+        std::memcpy(&res, &value, sizeof(T));
+        return res;
+    }
+} // namespace
+
+void DeltaEncoder::begin(std::vector<std::byte>& data) {
+    _data = &data;
+    _frameStart = data.size();
+    _field = 0;
+    data.push_back(static_cast<std::byte>(SyncVersion));
+    data.push_back(static_cast<std::byte>(_isKeyframe ? KeyframeFlag : 0));
+}
+
+void DeltaEncoder::beginGroup() {
+    _groupMask = 0;
+    _groupField = 0;
+    _group.clear();
+}
+
+bool DeltaEncoder::update(uint64_t value) {
+    if (_groupField == MaxGroupSize) {
+        throw std::runtime_error("Too many fields in a synchronization group");
+    }
+    if (_field == _previous.size()) {
+        if (!_isKeyframe) {
+            // The clients would apply the difference to a value that they don't know
+            throw std::runtime_error("New synchronized field outside of a keyframe");
+        }
+        _previous.push_back(value);
+    }
+
+    const bool hasChanged = _isKeyframe || _previous[_field] != value;
+    if (hasChanged) {
+        _groupMask |= uint64_t(1) << _groupField;
+    }
+    _previous[_field] = value;
+    _groupField++;
+    _field++;
+    return hasChanged;
+}
+
+void DeltaEncoder::field(bool value) {
+    if (update(value ? 1 : 0)) {
+        _group.push_back(static_cast<std::byte>(value ? 1 : 0));
+    }
+}
+
+void DeltaEncoder::field(uint32_t value) {
+    // The previous value has to be read before it is replaced
+    const uint64_t previous = _field < _previous.size() ? _previous[_field] : 0;
+    if (update(value)) {
+        const int64_t difference =
+            static_cast<int64_t>(value) - static_cast<int64_t>(previous);
+        writeVarint(_group, _isKeyframe ? value : zigzag(difference));
+    }
+}
+
+void DeltaEncoder::field(float value) {
+    if (update(bits(value))) {
+        writeBytes(_group, value);
+    }
+}
+
+void DeltaEncoder::field(double value) {
+    if (update(bits(value))) {
+        writeBytes(_group, value);
+    }
+}
+
+void DeltaEncoder::endGroup() {
+    writeVarint(*_data, _groupMask);
+    _data->insert(_data->end(), _group.begin(), _group.end());
+}
+
+size_t DeltaEncoder::end() {
+    // Fields that were removed would be new again if they come back
+    _previous.resize(_field);
+    _isKeyframe = false;
+    return _data->size() - _frameStart;
+}
+
+void DeltaEncoder::requestKeyframe() {
+    _isKeyframe = true;
+}
+
+DeltaDecoder::DeltaDecoder(const std::vector<std::byte>& data, unsigned int pos)
+    : _data(data)
+    , _pos(pos)
+{
+    uint8_t version = 0;
+    readBytes(&version, sizeof(version));
+    if (version != SyncVersion) {
+        throw std::runtime_error(
+            "Unsupported synchronization version " + std::to_string(version)
+        );
+    }
+    uint8_t flags = 0;
+    readBytes(&flags, sizeof(flags));
+    _isKeyframe = (flags & KeyframeFlag) != 0;
+}
+
+void DeltaDecoder::beginGroup() {
+    _groupMask = readVarint();
+    _groupField = 0;
+}
+
+bool DeltaDecoder::hasChanged() {
+    if (_groupField == MaxGroupSize) {
+        throw std::runtime_error("Too many fields in a synchronization group");
+    }
+    const bool res = (_groupMask & (uint64_t(1) << _groupField)) != 0;
+    _groupField++;
+    return res;
+}
+
+void DeltaDecoder::field(bool& value) {
+    if (hasChanged()) {
+        uint8_t v = 0;
+        readBytes(&v, sizeof(v));
+        value = v != 0;
+    }
+}
+
+void DeltaDecoder::field(uint32_t& value) {
+    if (hasChanged()) {
+        const uint64_t v = readVarint();
+        value = _isKeyframe ?
+            static_cast<uint32_t>(v) :
+            static_cast<uint32_t>(static_cast<int64_t>(value) + unzigzag(v));
+    }
+}
+
+void DeltaDecoder::field(float& value) {
+    if (hasChanged()) {
+        readBytes(&value, sizeof(value));
+    }
+}
+
+void DeltaDecoder::field(double& value) {
+    if (hasChanged()) {
+        readBytes(&value, sizeof(value));
+    }
+}
+
+void DeltaDecoder::endGroup() {
+    if (_groupField < MaxGroupSize && (_groupMask >> _groupField) != 0) {
+        throw std::runtime_error("Unknown fields in synchronization group");
+    }
+}
+
+bool DeltaDecoder::isKeyframe() const {
+    return _isKeyframe;
+}
+
+uint64_t DeltaDecoder::readVarint() {
+    uint64_t res = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = 0;
+        readBytes(&byte, sizeof(byte));
+        res |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return res;
+        }
+    }
+    throw std::runtime_error("Invalid variable-length integer");
+}
+
+void DeltaDecoder::readBytes(void* destination, size_t size) {
+    if (_pos + size > _data.size()) {
+        throw std::runtime_error("Synchronization data ended prematurely");
+    }
+    std::memcpy(destination, _data.data() + _pos, size);
+    _pos += size;
+}
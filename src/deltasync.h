@@ -0,0 +1,121 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __DELTASYNC_H__
+#define __DELTASYNC_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The compact format in which the master sends the synchronized state to the client
+// nodes. The fields are organized in groups of up to 64 fields, and every group starts
+// with a bitmask of the fields that have changed since the previous frame, followed by
+// only the values of these fields. Integers are sent as the variable-length difference
+// to their previous value. The first frame is a keyframe that contains every field.
+//
+// The clients reconstruct the full state by applying the changes to the values of the
+// previous frame, which relies on every client receiving every frame in order and on
+// the synchronized values never being changed on the clients themselves.
+//
+// Both sides have to visit the same fields in the same order, which is easiest to
+// guarantee with a single function template that is called with either of the classes
+
+// The version is the first byte of every frame and has to be increased whenever the
+// format or the synchronized fields change
+constexpr const uint8_t SyncVersion = 2;
+
+class DeltaEncoder {
+public:
+    // Starts a new frame, which is appended to the provided buffer
+    void begin(std::vector<std::byte>& data);
+
+    void beginGroup();
+    void field(bool value);
+    void field(uint32_t value);
+    void field(float value);
+    void field(double value);
+    void endGroup();
+
+    // Finishes the frame and returns the number of bytes that were appended to the buffer
+    size_t end();
+
+    // Makes the next frame a keyframe that contains every field
+    void requestKeyframe();
+
+private:
+    // Returns whether the field has to be sent and remembers its new value
+    bool update(uint64_t bits);
+
+    std::vector<std::byte>* _data = nullptr;
+    size_t _frameStart = 0;
+
+    // The values of all fields in the previous frame
+    std::vector<uint64_t> _previous;
+    size_t _field = 0;
+    bool _isKeyframe = true;
+
+    // The changed fields of the current group are collected here as the mask has to be
+    // written before them
+    uint64_t _groupMask = 0;
+    size_t _groupField = 0;
+    std::vector<std::byte> _group;
+};
+
+class DeltaDecoder {
+public:
+    // Throws a std::runtime_error if the data was written with a different version
+    DeltaDecoder(const std::vector<std::byte>& data, unsigned int pos);
+
+    // All fields throw a std::runtime_error if the data ends prematurely. The values of
+    // fields that have not changed are left as they are
+    void beginGroup();
+    void field(bool& value);
+    void field(uint32_t& value);
+    void field(float& value);
+    void field(double& value);
+    void endGroup();
+
+    bool isKeyframe() const;
+
+private:
+    // Returns whether the current field has changed and advances to the next field
+    bool hasChanged();
+    uint64_t readVarint();
+    void readBytes(void* destination, size_t size);
+
+    const std::vector<std::byte>& _data;
+    size_t _pos;
+    bool _isKeyframe = false;
+    uint64_t _groupMask = 0;
+    size_t _groupField = 0;
+};
+
+#endif // __DELTASYNC_H__
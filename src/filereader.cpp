@@ -0,0 +1,439 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "filereader.h"
+
+#include "trace.h"
+#include "workerpool.h"
+#include <sgct/log.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+namespace {
+    std::unique_ptr<FileReader::Settings> PendingSettings;
+
+#ifdef __linux__
+    // The largest chunk that is requested in a single read as the length is 32 bit
+    constexpr const uint64_t MaxReadSize = 1024 * 1024 * 1024;
+#endif // __linux__
+} // namespace
+
+struct FileReader::Request {
+    std::filesystem::path path;
+    Callback callback;
+    std::vector<unsigned char> contents;
+    uint64_t size = 0;
+    uint64_t offset = 0;
+    int fd = -1;
+};
+
+
+#ifdef __linux__
+// A minimal io_uring, driven by the raw system calls so that we don't depend on liburing
+struct FileReader::Ring {
+    explicit Ring(uint32_t nEntries) {
+        io_uring_params params = {};
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, nEntries, &params));
+        if (fd < 0) {
+            throw std::runtime_error(std::strerror(errno));
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool isSingleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (isSingleMap) {
+            sqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+
+        sqRing = mmap(
+            nullptr,
+            sqRingSize,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            IORING_OFF_SQ_RING
+        );
+        cqRing = isSingleMap ?
+            sqRing :
+            mmap(
+                nullptr,
+                cqRingSize,
+                PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE,
+                fd,
+                IORING_OFF_CQ_RING
+            );
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* s = mmap(
+            nullptr,
+            sqesSize,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd,
+            IORING_OFF_SQES
+        );
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || s == MAP_FAILED) {
+            close(fd);
+            throw std::runtime_error("Could not map io_uring buffers");
+        }
+        sqes = reinterpret_cast<io_uring_sqe*>(s);
+
+        char* sq = reinterpret_cast<char*>(sqRing);
+        sqTail = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+
+        char* cq = reinterpret_cast<char*>(cqRing);
+        cqHead = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        isSeparateCq = !isSingleMap;
+    }
+
+    ~Ring() {
+        munmap(sqes, sqesSize);
+        if (isSeparateCq) {
+            munmap(cqRing, cqRingSize);
+        }
+        munmap(sqRing, sqRingSize);
+        close(fd);
+    }
+
+    void queueRead(Request& request) {
+        const uint32_t tail = *sqTail;
+        const uint32_t index = tail & sqMask;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(io_uring_sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = request.fd;
+        sqe.off = request.offset;
+        sqe.addr = reinterpret_cast<uint64_t>(request.contents.data() + request.offset);
+        sqe.len = static_cast<uint32_t>(
+            std::min(request.size - request.offset, MaxReadSize)
+        );
+        sqe.user_data = reinterpret_cast<uint64_t>(&request);
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        nQueued++;
+    }
+
+    // Submits all queued reads and waits for at least one of them to complete
+    void submitAndWait() {
+        const long res = syscall(
+            __NR_io_uring_enter,
+            fd,
+            nQueued,
+            1,
+            IORING_ENTER_GETEVENTS,
+            nullptr,
+            0
+        );
+        if (res >= 0) {
+            nQueued -= std::min(nQueued, static_cast<uint32_t>(res));
+        }
+    }
+
+    // Calls the function for every completed read with the request and the result
+    template <typename Func>
+    void reap(Func&& func) {
+        uint32_t head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            Request* request = reinterpret_cast<Request*>(cqe.user_data);
+            const int res = cqe.res;
+            head++;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            func(*request, res);
+        }
+    }
+
+    int fd = -1;
+    void* sqRing = nullptr;
+    void* cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    size_t sqesSize = 0;
+    bool isSeparateCq = false;
+
+    io_uring_sqe* sqes = nullptr;
+    uint32_t* sqTail = nullptr;
+    uint32_t sqMask = 0;
+    uint32_t* sqArray = nullptr;
+    uint32_t* cqHead = nullptr;
+    uint32_t* cqTail = nullptr;
+    uint32_t cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    uint32_t nQueued = 0;
+};
+#else // __linux__
+struct FileReader::Ring {};
+#endif // __linux__
+
+FileReader& FileReader::instance() {
+    static FileReader Instance(PendingSettings ? *PendingSettings : Settings());
+    return Instance;
+}
+
+void FileReader::initialize(Settings settings) {
+    PendingSettings = std::make_unique<Settings>(settings);
+}
+
+FileReader::FileReader(Settings settings)
+    : _settings(settings)
+{
+#ifdef __linux__
+    try {
+        _ring = std::make_unique<Ring>(_settings.queueDepth);
+        _ringThread = std::thread(&FileReader::ringLoop, this);
+        sgct::Log::Info("Reading images through io_uring");
+        return;
+    }
+    catch (const std::runtime_error& e) {
+        sgct::Log::Info("io_uring is not available (%s)", e.what());
+    }
+#endif // __linux__
+
+    _fallbackWorkers = std::make_unique<WorkerPool>(
+        std::min(_settings.queueDepth, 16u)
+    );
+}
+
+FileReader::~FileReader() {
+    {
+        std::lock_guard lock(_mutex);
+        _isRunning = false;
+        _queue.clear();
+    }
+    _condition.notify_all();
+
+    if (_ringThread.joinable()) {
+        _ringThread.join();
+    }
+    _fallbackWorkers = nullptr;
+}
+
+void FileReader::read(std::filesystem::path path, Callback callback) {
+    auto request = std::make_shared<Request>();
+    request->path = std::move(path);
+    request->callback = std::move(callback);
+
+#ifdef __linux__
+    request->fd = open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (request->fd < 0 || fstat(request->fd, &info) != 0) {
+        request->callback({}, std::strerror(errno));
+        if (request->fd >= 0) {
+            close(request->fd);
+        }
+        return;
+    }
+    request->size = static_cast<uint64_t>(info.st_size);
+
+    if (!_ring) {
+        // Let the kernel start reading while the request is waiting for a thread
+        posix_fadvise(request->fd, 0, 0, POSIX_FADV_WILLNEED);
+    }
+#else // __linux__
+    std::error_code ec;
+    request->size = std::filesystem::file_size(request->path, ec);
+    if (ec) {
+        request->callback({}, ec.message());
+        return;
+    }
+#endif // __linux__
+
+    {
+        std::lock_guard lock(_mutex);
+        _queue.push_back(std::move(request));
+    }
+
+    if (_ring) {
+        _condition.notify_one();
+    }
+    else {
+        dispatchToWorkers();
+    }
+}
+
+void FileReader::dispatchToWorkers() {
+    std::lock_guard lock(_mutex);
+    while (!_queue.empty() && _nInFlight < _settings.queueDepth) {
+        std::shared_ptr<Request> request = _queue.front();
+        if (_nInFlight > 0 &&
+            _bytesInFlight + request->size > _settings.maxBytesInFlight)
+        {
+            break;
+        }
+        _queue.pop_front();
+        _nInFlight++;
+        _bytesInFlight += request->size;
+
+        _fallbackWorkers->enqueue([this, request]() {
+            std::string error;
+            {
+                TraceScope scope("Read file");
+                request->contents.resize(request->size);
+                error = readRemaining(*request);
+            }
+            finish(*request, std::move(error));
+            dispatchToWorkers();
+        });
+    }
+}
+
+void FileReader::finish(Request& request, std::string error) {
+#ifdef __linux__
+    close(request.fd);
+    request.fd = -1;
+#endif // __linux__
+
+    if (!error.empty()) {
+        request.contents.clear();
+    }
+    request.callback(std::move(request.contents), std::move(error));
+
+    std::lock_guard lock(_mutex);
+    _nInFlight--;
+    _bytesInFlight -= request.size;
+}
+
+std::string FileReader::readRemaining(Request& request) {
+#ifdef __linux__
+    while (request.offset < request.size) {
+        const ssize_t res = pread(
+            request.fd,
+            request.contents.data() + request.offset,
+            request.size - request.offset,
+            request.offset
+        );
+        if (res <= 0) {
+            return res < 0 ? std::strerror(errno) : "Unexpected end of file";
+        }
+        request.offset += res;
+    }
+#else // __linux__
+    std::ifstream f(request.path, std::ios::binary);
+    f.read(reinterpret_cast<char*>(request.contents.data()), request.size);
+    if (!f.good()) {
+        return "Could not read file";
+    }
+#endif // __linux__
+    return "";
+}
+
+void FileReader::ringLoop() {
+#ifdef __linux__
+    while (true) {
+        {
+            std::unique_lock lock(_mutex);
+            // Fill up the submission queue as far as our limits allow
+            while (!_queue.empty() && _nInFlight < _settings.queueDepth) {
+                std::shared_ptr<Request> request = _queue.front();
+                if (_nInFlight > 0 &&
+                    _bytesInFlight + request->size > _settings.maxBytesInFlight)
+                {
+                    break;
+                }
+                _queue.pop_front();
+                _nInFlight++;
+                _bytesInFlight += request->size;
+
+                request->contents.resize(request->size);
+                Request* r = request.get();
+                _inFlight[r] = std::move(request);
+                if (r->size == 0) {
+                    lock.unlock();
+                    finish(*r, "");
+                    lock.lock();
+                    _inFlight.erase(r);
+                }
+                else {
+                    _ring->queueRead(*r);
+                }
+            }
+
+            if (_nInFlight == 0) {
+                if (!_isRunning) {
+                    return;
+                }
+                _condition.wait(
+                    lock,
+                    [this]() { return !_isRunning || !_queue.empty(); }
+                );
+                continue;
+            }
+        }
+
+        _ring->submitAndWait();
+        _ring->reap([this](Request& request, int res) {
+            if (res == -EINTR || res == -EAGAIN) {
+                _ring->queueRead(request);
+                return;
+            }
+
+            if (res > 0) {
+                request.offset += static_cast<uint64_t>(res);
+                if (request.offset < request.size) {
+                    // Short read, so we have to ask for the rest
+                    _ring->queueRead(request);
+                    return;
+                }
+            }
+
+            std::string error;
+            if (res == -EINVAL || res == -EOPNOTSUPP) {
+                // Kernels before 5.6 don't know about IORING_OP_READ
+                error = readRemaining(request);
+            }
+            else if (res < 0) {
+                error = std::strerror(-res);
+            }
+            else if (res == 0) {
+                error = "Unexpected end of file";
+            }
+            finish(request, std::move(error));
+
+            std::lock_guard lock(_mutex);
+            _inFlight.erase(&request);
+        });
+    }
+#endif // __linux__
+}
@@ -0,0 +1,105 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __FILEREADER_H__
+#define __FILEREADER_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class WorkerPool;
+
+// Reads whole files asynchronously so that the I/O for upcoming images overlaps with
+// the decoding of previous ones. On Linux the reads are batched through io_uring, which
+// keeps many requests in flight on a single thread; if io_uring is not available, a pool
+// of threads performs blocking reads after telling the kernel to start reading ahead
+class FileReader {
+public:
+    // The error is empty if the file was read successfully
+    using Callback = std::function<void(std::vector<unsigned char> contents,
+        std::string error)>;
+
+    struct Settings {
+        // The maximum number of reads that are submitted at the same time
+        uint32_t queueDepth = 32;
+        // Requests are held back while the files in flight are larger than this
+        uint64_t maxBytesInFlight = 256 * 1024 * 1024;
+    };
+
+    static FileReader& instance();
+
+    // Has to be called before the first file is read for the settings to take effect
+    static void initialize(Settings settings);
+
+    ~FileReader();
+
+    // Reads the file and calls the callback on an I/O thread once it is done. The
+    // callback should return quickly and hand off any expensive work to other threads
+    void read(std::filesystem::path path, Callback callback);
+
+private:
+    struct Request;
+    struct Ring;
+
+    explicit FileReader(Settings settings);
+
+    void ringLoop();
+    void dispatchToWorkers();
+    void finish(Request& request, std::string error);
+
+    // Reads the rest of the file with blocking calls and returns an error message if
+    // that fails
+    static std::string readRemaining(Request& request);
+
+    const Settings _settings;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<std::shared_ptr<Request>> _queue;
+    uint64_t _bytesInFlight = 0;
+    uint32_t _nInFlight = 0;
+    bool _isRunning = true;
+
+    std::map<Request*, std::shared_ptr<Request>> _inFlight;
+    std::unique_ptr<Ring> _ring;
+    std::thread _ringThread;
+    std::unique_ptr<WorkerPool> _fallbackWorkers;
+};
+
+#endif // __FILEREADER_H__
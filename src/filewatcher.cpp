@@ -0,0 +1,110 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "filewatcher.h"
+
+#include <sgct/log.h>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <array>
+#include <cstring>
+#endif // __linux__
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+    _handle = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (_handle < 0) {
+        sgct::Log::Warning("Could not initialize inotify: %s", std::strerror(errno));
+    }
+#endif // __linux__
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (_handle >= 0) {
+        close(_handle);
+    }
+#endif // __linux__
+}
+
+bool FileWatcher::watchDirectory(const std::filesystem::path& directory) {
+#ifdef __linux__
+    if (_handle < 0) {
+        return false;
+    }
+
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE;
+    const int wd = inotify_add_watch(_handle, directory.string().c_str(), mask);
+    if (wd < 0) {
+        return false;
+    }
+    _directories[wd] = directory;
+    return true;
+#else // __linux__
+    (void)directory;
+    return false;
+#endif // __linux__
+}
+
+std::vector<std::filesystem::path> FileWatcher::changedFiles() {
+    std::vector<std::filesystem::path> res;
+
+#ifdef __linux__
+    if (_handle < 0) {
+        return res;
+    }
+
+    alignas(inotify_event) std::array<char, 4096> buffer;
+    while (true) {
+        const ssize_t length = read(_handle, buffer.data(), buffer.size());
+        if (length <= 0) {
+            // EAGAIN means that there are no more pending events
+            break;
+        }
+
+        for (ssize_t i = 0; i < length;) {
+            const inotify_event* event = reinterpret_cast<inotify_event*>(&buffer[i]);
+            auto it = _directories.find(event->wd);
+            if (it != _directories.end() && event->len > 0) {
+                std::filesystem::path p = it->second / event->name;
+                if (std::find(res.begin(), res.end(), p) == res.end()) {
+                    res.push_back(std::move(p));
+                }
+            }
+            i += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif // __linux__
+
+    return res;
+}
@@ -0,0 +1,164 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "framecapture.h"
+
+#include <sgct/log.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+FrameCapture::FrameCapture(Settings settings)
+    : _settings(std::move(settings))
+    , _writer(0, _settings.maxBytesInFlight)
+{
+    std::filesystem::create_directories(_settings.folder);
+}
+
+void FrameCapture::capture(const std::string& view, unsigned int frameNumber,
+                           glm::ivec2 size)
+{
+    Ring& ring = _rings[view];
+    if (ring.slots.empty()) {
+        ring.slots.resize(std::max(_settings.nBuffers, 1u));
+    }
+
+    Slot& slot = ring.slots[ring.next];
+    if (slot.fence && !finish(slot, false)) {
+        // All buffers of this view are still in flight
+        _nDroppedFrames++;
+        return;
+    }
+
+    const GLsizeiptr nBytes = static_cast<GLsizeiptr>(size.x) * size.y * 4;
+    if (slot.pbo == 0) {
+        glGenBuffers(1, &slot.pbo);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.size != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, nBytes, nullptr, GL_STREAM_READ);
+        slot.size = size;
+    }
+    // With a bound pixel pack buffer, glReadPixels only queues the transfer
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    char name[32];
+    std::snprintf(
+        name,
+        sizeof(name),
+        "_%06u.%s",
+        frameNumber,
+        _settings.format == Format::Raw ? "raw" : "png"
+    );
+    slot.path = _settings.folder / (view + name);
+
+    ring.next = (ring.next + 1) % ring.slots.size();
+}
+
+void FrameCapture::update() {
+    for (std::pair<const std::string, Ring>& p : _rings) {
+        for (Slot& slot : p.second.slots) {
+            if (slot.fence) {
+                finish(slot, false);
+            }
+        }
+    }
+}
+
+void FrameCapture::deinitialize() {
+    for (std::pair<const std::string, Ring>& p : _rings) {
+        for (Slot& slot : p.second.slots) {
+            if (slot.fence) {
+                finish(slot, true);
+            }
+            glDeleteBuffers(1, &slot.pbo);
+        }
+    }
+    _rings.clear();
+    _writer.waitForWrites();
+
+    sgct::Log::Info(
+        "Captured %u frames, dropped %u frames",
+        _nCapturedFrames, _nDroppedFrames
+    );
+}
+
+unsigned int FrameCapture::nCapturedFrames() const {
+    return _nCapturedFrames;
+}
+
+unsigned int FrameCapture::nDroppedFrames() const {
+    return _nDroppedFrames;
+}
+
+bool FrameCapture::finish(Slot& slot, bool wait) {
+    // Flushing makes sure that the fence is eventually signaled even if nothing else
+    // flushes the command stream
+    const GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+    const GLenum res = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (res == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+    if (res == GL_WAIT_FAILED) {
+        _nDroppedFrames++;
+        return true;
+    }
+
+    // The frame is only read back if the writer has room for it, so dropped frames
+    // don't pay for the copy
+    const size_t nBytes = static_cast<size_t>(slot.size.x) * slot.size.y * 4;
+    std::vector<unsigned char> pixels;
+    if (!_writer.tryReserve(nBytes, pixels)) {
+        _nDroppedFrames++;
+        return true;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, nBytes, GL_MAP_READ_BIT);
+    if (data) {
+        std::memcpy(pixels.data(), data, nBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (data) {
+        _writer.writeReserved(std::move(slot.path), slot.size, std::move(pixels));
+        _nCapturedFrames++;
+    }
+    else {
+        _writer.cancelReservation(std::move(pixels));
+        _nDroppedFrames++;
+    }
+    return true;
+}
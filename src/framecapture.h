@@ -0,0 +1,109 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __FRAMECAPTURE_H__
+#define __FRAMECAPTURE_H__
+
+#include "framewriter.h"
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Captures the rendered frames to image files without stalling the render loop. Each
+// frame is read back into one of a ring of pixel buffer objects whose transfer is
+// tracked by a fence. The buffers are only mapped once their fence has been signaled a
+// few frames later, and the pixels are handed to a FrameWriter that encodes them on the
+// background workers. Frames are dropped, and counted, instead of waiting if all buffers
+// of the ring are still in flight or if too many frames are waiting to be written
+class FrameCapture {
+public:
+    enum class Format {
+        Png,
+        Raw
+    };
+
+    struct Settings {
+        std::filesystem::path folder = "capture";
+        Format format = Format::Png;
+        // The number of frames per view that can be in flight on the GPU
+        unsigned int nBuffers = 3;
+        // The size of the frames that are waiting to be written, 0 means no limit
+        uint64_t maxBytesInFlight = uint64_t(512) * 1024 * 1024;
+    };
+
+    explicit FrameCapture(Settings settings);
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Starts reading back the region of the currently bound framebuffer. The view is the
+    // name that separates the files of multiple windows and eyes
+    void capture(const std::string& view, unsigned int frameNumber, glm::ivec2 size);
+
+    // Hands all frames whose transfer has finished to the frame writer. Has to be called
+    // regularly on the thread that owns the OpenGL context
+    void update();
+
+    // Finishes the pending transfers, waits for all frames to be written, and releases
+    // the buffers
+    void deinitialize();
+
+    unsigned int nCapturedFrames() const;
+    unsigned int nDroppedFrames() const;
+
+private:
+    struct Slot {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        glm::ivec2 size = glm::ivec2(0);
+        std::filesystem::path path;
+    };
+
+    struct Ring {
+        std::vector<Slot> slots;
+        size_t next = 0;
+    };
+
+    // Blocks on the fence if wait is true, returns false if the transfer is not finished
+    bool finish(Slot& slot, bool wait);
+
+    const Settings _settings;
+    std::map<std::string, Ring> _rings;
+    FrameWriter _writer;
+
+    unsigned int _nCapturedFrames = 0;
+    unsigned int _nDroppedFrames = 0;
+};
+
+#endif // __FRAMECAPTURE_H__
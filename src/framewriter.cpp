@@ -0,0 +1,175 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "framewriter.h"
+
+#include "workerpool.h"
+#include <sgct/image.h>
+#include <sgct/log.h>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+FrameWriter::FrameWriter(unsigned int maxPendingFrames, uint64_t maxPendingBytes)
+    : _maxPendingFrames(
+        maxPendingFrames > 0 ? maxPendingFrames : 2 * backgroundWorkers().nThreads()
+    )
+    , _maxPendingBytes(maxPendingBytes)
+{}
+
+FrameWriter::~FrameWriter() {
+    waitForWrites();
+}
+
+void FrameWriter::write(std::filesystem::path path, glm::ivec2 size,
+                        std::vector<unsigned char> pixels)
+{
+    {
+        std::unique_lock lock(_mutex);
+        _frameWritten.wait(lock, [&]() { return hasRoomFor(pixels.size()); });
+        _nPendingFrames++;
+        _nPendingBytes += pixels.size();
+    }
+    enqueue(std::move(path), size, std::move(pixels), false);
+}
+
+bool FrameWriter::tryWrite(std::filesystem::path path, glm::ivec2 size,
+                           std::vector<unsigned char> pixels)
+{
+    {
+        std::lock_guard lock(_mutex);
+        if (!hasRoomFor(pixels.size())) {
+            return false;
+        }
+        _nPendingFrames++;
+        _nPendingBytes += pixels.size();
+    }
+    enqueue(std::move(path), size, std::move(pixels), false);
+    return true;
+}
+
+bool FrameWriter::tryReserve(size_t nBytes, std::vector<unsigned char>& pixels) {
+    {
+        std::lock_guard lock(_mutex);
+        if (!hasRoomFor(nBytes)) {
+            return false;
+        }
+        _nPendingFrames++;
+        _nPendingBytes += nBytes;
+        if (!_freeBuffers.empty()) {
+            pixels = std::move(_freeBuffers.back());
+            _freeBuffers.pop_back();
+        }
+    }
+    // Frames of the same view have the same size, so this only allocates when the size
+    // of the frames changes
+    pixels.resize(nBytes);
+    return true;
+}
+
+void FrameWriter::writeReserved(std::filesystem::path path, glm::ivec2 size,
+                                std::vector<unsigned char> pixels)
+{
+    enqueue(std::move(path), size, std::move(pixels), true);
+}
+
+void FrameWriter::cancelReservation(std::vector<unsigned char> pixels) {
+    std::lock_guard lock(_mutex);
+    release(std::move(pixels), true);
+}
+
+void FrameWriter::waitForWrites() {
+    std::unique_lock lock(_mutex);
+    _frameWritten.wait(lock, [&]() { return _nPendingFrames == 0; });
+}
+
+bool FrameWriter::hasRoomFor(uint64_t nBytes) const {
+    if (_nPendingFrames == 0) {
+        return true;
+    }
+    const bool hasRoomForBytes =
+        _maxPendingBytes == 0 || _nPendingBytes + nBytes <= _maxPendingBytes;
+    return _nPendingFrames < _maxPendingFrames && hasRoomForBytes;
+}
+
+void FrameWriter::release(std::vector<unsigned char> pixels, bool isReserved) {
+    _nPendingFrames--;
+    _nPendingBytes -= pixels.size();
+    if (isReserved && _freeBuffers.size() < _maxPendingFrames) {
+        _freeBuffers.push_back(std::move(pixels));
+    }
+    _frameWritten.notify_all();
+}
+
+void FrameWriter::enqueue(std::filesystem::path path, glm::ivec2 size,
+                          std::vector<unsigned char> pixels, bool isReserved)
+{
+    auto data = std::make_shared<std::vector<unsigned char>>(std::move(pixels));
+    backgroundWorkers().enqueue([this, data, size, isReserved, path = std::move(path)]() {
+        // Both formats store the rows from top to bottom
+        const size_t rowSize = static_cast<size_t>(size.x) * 4;
+        try {
+            if (path.extension() == ".raw") {
+                std::ofstream file(path, std::ios::binary);
+                for (int y = size.y - 1; y >= 0; --y) {
+                    file.write(
+                        reinterpret_cast<const char*>(data->data() + rowSize * y),
+                        rowSize
+                    );
+                }
+                if (!file.good()) {
+                    throw std::runtime_error("Could not write file");
+                }
+            }
+            else {
+                sgct::Image img;
+                img.setSize(size);
+                img.setChannels(4);
+                img.setBytesPerChannel(1);
+                img.allocateOrResizeData();
+                for (int y = 0; y < size.y; ++y) {
+                    std::memcpy(
+                        img.data() + rowSize * (size.y - 1 - y),
+                        data->data() + rowSize * y,
+                        rowSize
+                    );
+                }
+                img.save(path.string());
+            }
+        }
+        catch (const std::runtime_error& e) {
+            sgct::Log::Error("Error writing %s: %s", path.string().c_str(), e.what());
+        }
+
+        std::lock_guard lock(_mutex);
+        release(std::move(*data), isReserved);
+    });
+}
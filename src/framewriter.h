@@ -0,0 +1,96 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __FRAMEWRITER_H__
+#define __FRAMEWRITER_H__
+
+#include <glm/glm.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+// Encodes rendered frames into image files on the background workers, so that writing a
+// frame overlaps with rendering the next ones. The number and total size of the frames
+// that are waiting to be written are bounded to limit the memory that they occupy
+class FrameWriter {
+public:
+    // 0 frames allows two pending frames per background worker, 0 bytes does not limit
+    // the size of the pending frames. A single frame is always allowed
+    explicit FrameWriter(unsigned int maxPendingFrames = 0, uint64_t maxPendingBytes = 0);
+    ~FrameWriter();
+
+    FrameWriter(const FrameWriter&) = delete;
+    FrameWriter& operator=(const FrameWriter&) = delete;
+
+    // The pixels are RGBA with 8 bits per channel and the rows ordered from bottom to top
+    // as returned by glReadPixels. The file format is picked from the extension of the
+    // path, where .raw files contain the pixels without a header and with the rows
+    // ordered from top to bottom. Blocks while too many frames are waiting to be written
+    void write(std::filesystem::path path, glm::ivec2 size,
+        std::vector<unsigned char> pixels);
+
+    // The same as write, but returns false without writing the frame instead of blocking
+    bool tryWrite(std::filesystem::path path, glm::ivec2 size,
+        std::vector<unsigned char> pixels);
+
+    // Reserves room for a frame of nBytes without blocking, so that the pixels only have
+    // to be produced if the frame will be written. The buffer for the pixels is reused
+    // from frames that were reserved before and have been written. Returns false if
+    // there is no room. A reserved frame has to be passed to either writeReserved or
+    // cancelReservation
+    bool tryReserve(size_t nBytes, std::vector<unsigned char>& pixels);
+    void writeReserved(std::filesystem::path path, glm::ivec2 size,
+        std::vector<unsigned char> pixels);
+    void cancelReservation(std::vector<unsigned char> pixels);
+
+    // Blocks until all frames have been written
+    void waitForWrites();
+
+private:
+    // Has to be called while holding the mutex
+    bool hasRoomFor(uint64_t nBytes) const;
+    // Has to be called while holding the mutex
+    void release(std::vector<unsigned char> pixels, bool isReserved);
+    void enqueue(std::filesystem::path path, glm::ivec2 size,
+        std::vector<unsigned char> pixels, bool isReserved);
+
+    const unsigned int _maxPendingFrames;
+    const uint64_t _maxPendingBytes;
+    unsigned int _nPendingFrames = 0;
+    uint64_t _nPendingBytes = 0;
+    // The buffers of written frames that were reserved, ready to be reused
+    std::vector<std::vector<unsigned char>> _freeBuffers;
+    std::mutex _mutex;
+    std::condition_variable _frameWritten;
+};
+
+#endif // __FRAMEWRITER_H__
@@ -0,0 +1,76 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __HEADLESS_H__
+#define __HEADLESS_H__
+
+#include "framewriter.h"
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <filesystem>
+
+struct GLFWwindow;
+
+// An OpenGL context with an offscreen framebuffer for rendering image sequences to disk
+// without an SGCT window. The context is created through OSMesa if GLFW supports it, so
+// that it works on machines without a GPU or a display, and through the regular context
+// creation of the platform otherwise
+class HeadlessContext {
+public:
+    explicit HeadlessContext(glm::ivec2 size);
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+    // Binds and clears the offscreen framebuffer
+    void beginFrame();
+
+    // Reads back the rendered frame and writes it to the path on a background thread, so
+    // that encoding the frame overlaps with rendering the next ones. Blocks if too many
+    // frames are still waiting to be written
+    void save(std::filesystem::path path);
+
+    // Blocks until all frames have been written
+    void waitForWrites();
+
+    glm::ivec2 size() const;
+
+private:
+    GLFWwindow* _window = nullptr;
+    GLuint _framebuffer = 0;
+    GLuint _colorBuffer = 0;
+    GLuint _depthBuffer = 0;
+    const glm::ivec2 _size;
+
+    FrameWriter _writer;
+};
+
+#endif // __HEADLESS_H__
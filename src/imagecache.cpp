@@ -30,17 +30,220 @@
 
 #include "imagecache.h"
 
+#include "assetcache.h"
+#include "filereader.h"
+#include "metrics.h"
+#include "thumbnail.h"
+#include "trace.h"
+#include "workerpool.h"
 #include <sgct/log.h>
-#include <sgct/texturemanager.h>
+#include <algorithm>
+#include <fstream>
+
+namespace {
+    std::vector<unsigned char> readFile(const std::filesystem::path& path) {
+        TraceScope scope("Read file");
+        std::ifstream f(path, std::ios::binary | std::ios::ate);
+        if (!f.good()) {
+            throw std::runtime_error("Could not open file");
+        }
+
+        std::vector<unsigned char> res(static_cast<size_t>(f.tellg()));
+        f.seekg(0);
+        f.read(reinterpret_cast<char*>(res.data()), res.size());
+        return res;
+    }
+
+    bool containsTiledImages(const std::vector<std::filesystem::path>& paths) {
+        return std::any_of(paths.begin(), paths.end(), TiledImage::isTiledImage);
+    }
+} // namespace
 
 ImageCache::ImageCache(std::vector<std::filesystem::path> paths)
     : _paths(std::move(paths))
+    , _hasTiledImages(containsTiledImages(_paths))
+    , _store(std::make_shared<FrameStore>())
+{}
+
+void ImageCache::setPaths(std::vector<std::filesystem::path> paths,
+                          uint32_t firstMovedImage)
 {
-    //std::fill(_imageCache.begin(), _imageCache.end(), 0);
+    _paths = std::move(paths);
+    _hasTiledImages = containsTiledImages(_paths);
+
+    std::lock_guard lock(_store->mutex);
+    // Frames that are appended to a sequence while it is playing only discard what was
+    // loaded for the new images, so the playback doesn't stall
+    _store->images.erase(
+        _store->images.lower_bound(firstMovedImage),
+        _store->images.end()
+    );
+    _store->pending.erase(
+        _store->pending.lower_bound(firstMovedImage),
+        _store->pending.end()
+    );
+    _store->deltas.erase(
+        _store->deltas.lower_bound(firstMovedImage),
+        _store->deltas.end()
+    );
+    if (_store->shownIndex >= firstMovedImage) {
+        _store->shownIndex = std::nullopt;
+        _store->shownImage = nullptr;
+    }
+
+    if (_currentImage >= firstMovedImage) {
+        _currentImage = std::nullopt;
+        _loadedImage.clear();
+        _isPreview = false;
+        _store->generation++;
+        _store->isReloading = false;
+        _store->isReloadPrepared = false;
+        _store->reloadedImage = nullptr;
+    }
+}
+
+void ImageCache::setRegion(const ImageRegion& region) {
+    if (region == _region) {
+        return;
+    }
+    _region = region;
+    if (!_hasTiledImages) {
+        return;
+    }
+
+    // The current image is loaded for the new region by the next setCurrentImage
+    _currentImage = std::nullopt;
+    _isPreview = false;
+
+    std::lock_guard lock(_store->mutex);
+    _store->images.clear();
+    _store->pending.clear();
+    _store->deltas.clear();
+    _store->generation++;
+}
+
+const ImageRegion& ImageCache::region() const {
+    return _region;
+}
+
+void ImageCache::prefetch(const std::vector<uint32_t>& images) {
+    const uint32_t nImages = static_cast<uint32_t>(_paths.size());
+
+    // The full resolution version of an image that is shown as a preview is still needed
+    auto isNeeded = [&](uint32_t i) {
+        const bool isPreview = _isPreview && i == _currentImage;
+        return isPreview || std::find(images.begin(), images.end(), i) != images.end();
+    };
+
+    std::lock_guard lock(_store->mutex);
+
+    // Forget about everything that is no longer needed. Pending images that are removed
+    // here are skipped by the decode job once it gets to them
+    for (auto it = _store->images.begin(); it != _store->images.end();) {
+        it = isNeeded(it->first) ? ++it : _store->images.erase(it);
+    }
+    for (auto it = _store->pending.begin(); it != _store->pending.end();) {
+        it = isNeeded(it->first) ? ++it : _store->pending.erase(it);
+    }
+    for (auto it = _store->deltas.begin(); it != _store->deltas.end();) {
+        it = isNeeded(it->first) ? ++it : _store->deltas.erase(it);
+    }
+
+    for (uint32_t i : images) {
+        if (i < nImages) {
+            schedule(i);
+        }
+    }
+}
+
+void ImageCache::schedule(uint32_t i) {
+    if (_store->images.find(i) != _store->images.end() || _store->pending.count(i)) {
+        return;
+    }
+
+    const uint32_t job = _store->nScheduledJobs++;
+    _store->pending[i] = job;
+    backgroundWorkers().enqueue([store = _store, file = _paths[i], i, job,
+                                 region = _region]()
+    {
+        if (!store->isWanted(i, job)) {
+            // The image was discarded before we got to it
+            return;
+        }
+
+        // On the nodes, the image is read from the local copy of the master's file
+        const std::filesystem::path path = AssetClient::fetch(file);
+
+        if (TiledImage::isTiledImage(path)) {
+            // Only the tiles of the region are read, which is too little to be worth
+            // going through the file reader
+            store->finish(i, job, load(path, true, false, region));
+            store->updateDeltas(i);
+            return;
+        }
+
+        if (std::shared_ptr<const DecodedImage> image = existingImage(path); image) {
+            store->finish(i, job, std::move(image));
+            return;
+        }
+
+        // The file is read asynchronously and the decoding is then handed back to
+        // the worker pool so that the I/O thread is never blocked by decoding
+        FileReader::instance().read(
+            path,
+            [store, path, i, job](std::vector<unsigned char> contents,
+                                  std::string error)
+            {
+                if (!error.empty()) {
+                    sgct::Log::Error(
+                        "Error reading image %s: %s",
+                        path.string().c_str(), error.c_str()
+                    );
+                    store->finish(i, job, nullptr);
+                    return;
+                }
+
+                backgroundWorkers().enqueue(
+                    [store, path, i, job, c = std::move(contents)]() mutable {
+                        if (store->isWanted(i, job)) {
+                            const bool storesThumbnail = thumbnailImage(i) == i;
+                            store->finish(
+                                i,
+                                job,
+                                decode(path, std::move(c), true, storesThumbnail)
+                            );
+                            // Comparing with the neighbors here leaves only
+                            // the upload of changed tiles to the render thread
+                            store->updateDeltas(i);
+                        }
+                    }
+                );
+            }
+        );
+    });
+}
+
+uint64_t ImageCache::readyMask(const std::vector<uint32_t>& images) const {
+    const uint32_t nImages = static_cast<uint32_t>(_paths.size());
+    const size_t n = std::min<size_t>(images.size(), 64);
+
+    std::lock_guard lock(_store->mutex);
+    uint64_t mask = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t image = images[i];
+        if (image >= nImages || _store->images.find(image) != _store->images.end()) {
+            mask |= uint64_t(1) << i;
+        }
+    }
+    return mask;
 }
 
 void ImageCache::setCurrentImage(uint32_t currentImage) {
+    TraceScope scope("Set current image");
     if (currentImage == _currentImage) {
+        if (_isPreview) {
+            refinePreview();
+        }
         return;
     }
     if (currentImage >= _paths.size()) {
@@ -48,24 +251,413 @@ void ImageCache::setCurrentImage(uint32_t currentImage) {
     }
 
     _currentImage = currentImage;
+    _loadedImage = _paths[currentImage].string();
+
+    std::shared_ptr<const DecodedImage> image;
+    std::shared_ptr<const TileDelta> delta;
+    bool isLoaded = false;
+    {
+        std::lock_guard lock(_store->mutex);
+        // A reload of the previous image is no longer of interest
+        _store->isReloading = false;
+        _store->isReloadPrepared = false;
+        _store->reloadedImage = nullptr;
+
+        auto it = _store->images.find(currentImage);
+        if (it != _store->images.end()) {
+            image = std::move(it->second);
+            isLoaded = true;
+            static Counter& Hits = Metrics::instance().counter(
+                "image_cache_requests_total",
+                "The images that were shown, by whether they were decoded in advance",
+                metricLabel("result", "hit")
+            );
+            Hits.add();
+            _store->images.erase(it);
+
+            auto d = _store->deltas.find(currentImage);
+            if (d != _store->deltas.end()) {
+                delta = std::move(d->second);
+                _store->deltas.erase(d);
+            }
+        }
+    }
+
+    if (!isLoaded) {
+        static Counter& Misses = Metrics::instance().counter(
+            "image_cache_requests_total",
+            "The images that were shown, by whether they were decoded in advance",
+            metricLabel("result", "miss")
+        );
+        Misses.add();
+
+        // Instead of waiting for the full image, we show the thumbnail of the closest
+        // image before it that has one and keep decoding the full resolution image in
+        // the background. If the texture exists already, there is nothing to wait for in
+        // the first place
+        const std::filesystem::path& path = _paths[currentImage];
+        const auto startTime = std::chrono::steady_clock::now();
+        std::shared_ptr<const DecodedImage> thumbnail;
+        if (!existingImage(AssetClient::cachedPath(path))) {
+            const uint32_t preview = thumbnailImage(currentImage);
+            thumbnail = loadThumbnail(AssetClient::cachedPath(_paths[preview]));
+        }
+        if (thumbnail) {
+            show(std::move(thumbnail), nullptr);
+            _isPreview = true;
+            _previewStartTime = startTime;
+
+            std::lock_guard lock(_store->mutex);
+            schedule(currentImage);
+            return;
+        }
+
+        {
+            // If a decode job is still working on the image, the result is discarded as
+            // we can't wait for it to be scheduled
+            std::lock_guard lock(_store->mutex);
+            _store->pending.erase(currentImage);
+        }
+        sgct::Log::Debug("Decoding image %s", path.string().c_str());
+        const bool storesThumbnail = thumbnailImage(currentImage) == currentImage;
+        image = load(path, true, storesThumbnail, _region);
+    }
+    show(std::move(image), std::move(delta));
+}
+
+void ImageCache::refinePreview() {
+    std::shared_ptr<const DecodedImage> image;
+    {
+        std::lock_guard lock(_store->mutex);
+        auto it = _store->images.find(*_currentImage);
+        if (it == _store->images.end()) {
+            return;
+        }
+        image = std::move(it->second);
+        _store->images.erase(it);
+    }
+
+    show(std::move(image), nullptr);
+    // If the image failed to load, there is nothing better than the preview to show
+    _isPreview = false;
+
+    using namespace std::chrono;
+    const duration<double, std::milli> dt = steady_clock::now() - _previewStartTime;
+    const double ms = dt.count();
+    sgct::Log::Info(
+        "Replaced preview of %s with the full image after %.1f ms",
+        loadedImage().c_str(), ms
+    );
+}
+
+void ImageCache::reload(uint32_t image) {
+    AssetClient::invalidate(_paths[image]);
+    {
+        std::lock_guard lock(_store->mutex);
+        _store->images.erase(image);
+        _store->pending.erase(image);
+        _store->deltas.erase(image);
+        _store->deltas.erase(image + 1);
+    }
+    if (image != _currentImage) {
+        // The new version will be loaded when the image is prefetched the next time
+        return;
+    }
+
+    sgct::Log::Info("Reloading image %s", _paths[image].string().c_str());
+    _reloadStartTime = std::chrono::steady_clock::now();
+
+    std::lock_guard lock(_store->mutex);
+    _store->isReloading = true;
+    _store->isReloadPrepared = false;
+    _store->reloadedImage = nullptr;
+    const uint32_t generation = _store->generation;
+    const bool storesThumbnail = thumbnailImage(image) == image;
+    backgroundWorkers().enqueue([store = _store, path = _paths[image], generation,
+                                 storesThumbnail, region = _region]()
+    {
+        std::shared_ptr<const DecodedImage> img =
+            load(path, true, storesThumbnail, region);
+
+        std::lock_guard l(store->mutex);
+        if (store->generation == generation && store->isReloading) {
+            store->isReloadPrepared = true;
+            store->reloadedImage = std::move(img);
+        }
+    });
+}
 
-    if (_texture > 0) {
-        sgct::TextureManager::instance().removeTexture(_texture);
+bool ImageCache::hasPendingReload() const {
+    std::lock_guard lock(_store->mutex);
+    return _store->isReloading && !_store->isReloadPrepared;
+}
+
+bool ImageCache::hasPreparedReload() const {
+    std::lock_guard lock(_store->mutex);
+    return _store->isReloadPrepared;
+}
+
+void ImageCache::applyReload() {
+    std::shared_ptr<const DecodedImage> image;
+    {
+        std::lock_guard lock(_store->mutex);
+        if (!_store->isReloadPrepared) {
+            return;
+        }
+        image = std::move(_store->reloadedImage);
+        _store->isReloading = false;
+        _store->isReloadPrepared = false;
+    }
+
+    show(std::move(image), nullptr);
+
+    using namespace std::chrono;
+    const duration<double, std::milli> dt = steady_clock::now() - _reloadStartTime;
+    const double ms = dt.count();
+    sgct::Log::Info("Reloaded image %s in %.1f ms", loadedImage().c_str(), ms);
+}
+
+void ImageCache::deinitialize() {
+    if (_textureKey.has_value()) {
+        TextureRegistry::instance().release(*_textureKey);
+    }
+    _texture = 0;
+    _textureKey = std::nullopt;
+    _uvRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+    _textureVersion++;
+    _currentImage = std::nullopt;
+    _loadedImage.clear();
+    _isPreview = false;
+
+    std::lock_guard lock(_store->mutex);
+    _store->images.clear();
+    _store->pending.clear();
+    _store->deltas.clear();
+    _store->shownIndex = std::nullopt;
+    _store->shownImage = nullptr;
+}
+
+void ImageCache::show(std::shared_ptr<const DecodedImage> image,
+                      std::shared_ptr<const TileDelta> delta)
+{
+    if (!image) {
+        // The image failed to load, so we keep showing the previous one
+        return;
+    }
+
+    _isPreview = false;
+    if (image->key == _textureKey) {
+        // A held frame that is identical to the previous image
+        return;
+    }
+
+    TextureRegistry& registry = TextureRegistry::instance();
+    GLuint texture = registry.acquire(image->key);
+    if (texture == 0) {
+        if (image->data.empty()) {
+            // The texture that we were planning on sharing has been released in the
+            // meantime, so we have to decode the image after all
+            image = load(_paths[*_currentImage], false, false, _region);
+            if (!image) {
+                return;
+            }
+        }
+
+        if (delta && delta->from == _textureKey && delta->to == image->key) {
+            // The previous texture is turned into the new one, which also transfers our
+            // reference so there is nothing to release afterwards
+            texture = registry.update(*image, *delta);
+            if (texture != 0) {
+                const uint64_t nDirty = delta->dirtyTiles.size();
+                _nTiles += delta->nTiles;
+                _nSkippedTiles += delta->nTiles - nDirty;
+                _texture = texture;
+                _textureKey = image->key;
+                _uvRect = image->uvRect;
+                _textureVersion++;
+                rememberShownImage(image);
+                return;
+            }
+        }
+
+        texture = registry.create(*image);
+        const glm::ivec2 nTiles =
+            (image->size + TileDelta::TileSize - 1) / TileDelta::TileSize;
+        _nTiles += static_cast<uint64_t>(nTiles.x) * nTiles.y;
     }
-    std::string path = _paths[_currentImage].string();
-    sgct::Log::Debug("Loading image %s", path.c_str());
-    _texture = sgct::TextureManager::instance().loadTexture(path, true);
+
+    if (_textureKey.has_value()) {
+        registry.release(*_textureKey);
+    }
+    _texture = texture;
+    _textureKey = image->key;
+    _uvRect = image->uvRect;
+    _textureVersion++;
+    rememberShownImage(image);
+}
+
+void ImageCache::rememberShownImage(std::shared_ptr<const DecodedImage> image) {
+    std::lock_guard lock(_store->mutex);
+    _store->shownIndex = _currentImage;
+    _store->shownImage = image->data.empty() ? nullptr : std::move(image);
 }
 
 GLuint ImageCache::texture() const {
     return _texture;
 }
 
-std::string ImageCache::loadedImage() const {
-    if (_currentImage < _paths.size()) {
-        return _paths[_currentImage].string();
+glm::vec4 ImageCache::uvRect() const {
+    return _uvRect;
+}
+
+double ImageCache::skippedTileFraction() const {
+    return _nTiles > 0 ? static_cast<double>(_nSkippedTiles) / _nTiles : 0.0;
+}
+
+uint32_t ImageCache::textureVersion() const {
+    return _textureVersion;
+}
+
+const std::string& ImageCache::loadedImage() const {
+    return _loadedImage;
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::decodeFile(
+                                                    const std::filesystem::path& path)
+{
+    return load(path, false, false, ImageRegion());
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::load(const std::filesystem::path& file,
+                                                     bool allowExistingTexture,
+                                                     bool storesThumbnail,
+                                                     const ImageRegion& region)
+{
+    const std::filesystem::path path = AssetClient::fetch(file);
+    if (TiledImage::isTiledImage(path)) {
+        // The key of a region is only known once the header has been read, so existing
+        // textures are found when the region is shown instead
+        try {
+            return std::make_shared<DecodedImage>(TiledImage(path).load(region));
+        }
+        catch (const std::runtime_error& e) {
+            sgct::Log::Error(
+                "Error reading tiled image %s: %s", path.string().c_str(), e.what()
+            );
+            return nullptr;
+        }
+    }
+
+    if (allowExistingTexture) {
+        if (std::shared_ptr<const DecodedImage> image = existingImage(path); image) {
+            return image;
+        }
+    }
+
+    try {
+        return decode(path, readFile(path), allowExistingTexture, storesThumbnail);
+    }
+    catch (const std::runtime_error& e) {
+        sgct::Log::Error("Error reading image %s: %s", path.string().c_str(), e.what());
+        return nullptr;
     }
-    else {
-        return "";
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::existingImage(
+                                                        const std::filesystem::path& path)
+{
+    TextureRegistry& registry = TextureRegistry::instance();
+    std::optional<ImageKey> key = registry.knownKey(path);
+    if (key.has_value() && registry.hasTexture(*key)) {
+        auto res = std::make_shared<DecodedImage>();
+        res->key = *key;
+        return res;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::decode(const std::filesystem::path& path,
+                                                       std::vector<unsigned char> data,
+                                                       bool allowExistingTexture,
+                                                       bool storesThumbnail)
+{
+    TextureRegistry& registry = TextureRegistry::instance();
+    try {
+        const ImageKey key = imageKey(data);
+        registry.rememberKey(path, key);
+
+        if (allowExistingTexture && registry.hasTexture(key)) {
+            auto res = std::make_shared<DecodedImage>();
+            res->key = key;
+            return res;
+        }
+        std::shared_ptr<const DecodedImage> image = registry.decode(key, std::move(data));
+        if (storesThumbnail) {
+            backgroundWorkers().enqueue(
+                [path, image]() { storeThumbnail(path, *image); }
+            );
+        }
+        return image;
+    }
+    catch (const std::runtime_error& e) {
+        sgct::Log::Error("Error loading image %s: %s", path.string().c_str(), e.what());
+        return nullptr;
+    }
+}
+
+bool ImageCache::FrameStore::isWanted(uint32_t image, uint32_t job) {
+    std::lock_guard lock(mutex);
+    auto it = pending.find(image);
+    return it != pending.end() && it->second == job;
+}
+
+void ImageCache::FrameStore::updateDeltas(uint32_t image) {
+    // The neighbors might have been decoded before this image, in which case nobody has
+    // compared them to it yet
+    for (uint32_t to = std::max<uint32_t>(image, 1); to <= image + 1; ++to) {
+        std::shared_ptr<const DecodedImage> from;
+        std::shared_ptr<const DecodedImage> current;
+        {
+            std::lock_guard lock(mutex);
+            if (deltas.find(to) != deltas.end()) {
+                continue;
+            }
+            from = decoded(to - 1);
+            current = decoded(to);
+        }
+        if (!from || !current) {
+            continue;
+        }
+
+        std::optional<TileDelta> delta = tileDelta(*from, *current);
+        if (!delta.has_value()) {
+            continue;
+        }
+
+        // The images might have been discarded or replaced in the meantime
+        std::lock_guard lock(mutex);
+        if (decoded(to - 1) == from && decoded(to) == current) {
+            deltas[to] = std::make_shared<const TileDelta>(std::move(*delta));
+        }
+    }
+}
+
+std::shared_ptr<const DecodedImage> ImageCache::FrameStore::decoded(uint32_t image) const
+{
+    auto it = images.find(image);
+    if (it != images.end()) {
+        return (it->second && !it->second->data.empty()) ? it->second : nullptr;
+    }
+    return shownIndex == image ? shownImage : nullptr;
+}
+
+void ImageCache::FrameStore::finish(uint32_t image, uint32_t job,
+                                    std::shared_ptr<const DecodedImage> d)
+{
+    std::lock_guard lock(mutex);
+    auto it = pending.find(image);
+    if (it != pending.end() && it->second == job) {
+        pending.erase(it);
+        images[image] = std::move(d);
     }
 }
@@ -31,28 +31,162 @@
 #ifndef __IMAGECACHE_H__
 #define __IMAGECACHE_H__
 
+#include "textureregistry.h"
+#include "tiledimage.h"
 #include <sgct/opengl.h>
-#include <array>
+#include <chrono>
 #include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <vector>
 
 class ImageCache {
 public:
     ImageCache(std::vector<std::filesystem::path> paths);
 
+    // Replaces the images of the sequence. The images before firstMovedImage have to
+    // keep their index and file, so that what was decoded for them in advance is kept.
+    // All later images are discarded, the current texture is kept until the next image
+    // is set
+    void setPaths(std::vector<std::filesystem::path> paths, uint32_t firstMovedImage = 0);
+
+    // Schedules the images to be decoded in the background and discards all previously
+    // decoded images that are not in the list
+    void prefetch(const std::vector<uint32_t>& images);
+
+    // Restricts the tiled images of the sequence to the region, which is only loaded at
+    // the resolution that it needs. Images that were loaded for the previous region are
+    // discarded and the current image is loaded again. Other images are not affected
+    void setRegion(const ImageRegion& region);
+    const ImageRegion& region() const;
+
+    // Returns a mask in which bit i is set if images[i] can be shown without having to
+    // wait for it to be decoded. Images past the end of the sequence are always ready as
+    // showing them is a no-op. Only the first 64 images are considered
+    uint64_t readyMask(const std::vector<uint32_t>& images) const;
+
+    // Uploads the requested image. If the background decode has not finished yet, the
+    // thumbnail of the image is shown until it has; without a thumbnail, the image is
+    // decoded on the calling thread. If the image has the same contents as the previous
+    // one or is already shown by a different object, the existing texture is used
+    // instead. Has to be called from the rendering thread every frame
     void setCurrentImage(uint32_t currentImage);
 
+    // Reloads an image whose file has changed on disk. If it is the current image, the
+    // new version is decoded in the background and only shown once applyReload is called
+    void reload(uint32_t image);
+    bool hasPendingReload() const;
+    bool hasPreparedReload() const;
+    void applyReload();
+
+    void deinitialize();
+
+    // Reads and decodes the image on the calling thread without creating a texture, for
+    // rendering without a GPU. Returns nullptr if the image could not be loaded
+    static std::shared_ptr<const DecodedImage> decodeFile(
+        const std::filesystem::path& path);
+
     GLuint texture() const;
-    std::string loadedImage() const;
+    // The part of the texture coordinates that the texture covers as offset and size
+    glm::vec4 uvRect() const;
+    // The path of the current image, or an empty string if there is none. The string is
+    // only rebuilt when the image changes, so this can be called every frame
+    const std::string& loadedImage() const;
+
+    // Is increased whenever the contents of the texture change, which can happen without
+    // the texture itself changing
+    uint32_t textureVersion() const;
+
+    // The fraction of texture tiles that did not have to be uploaded because they were
+    // identical to the same tile in the previous image
+    double skippedTileFraction() const;
 
 private:
-    uint32_t _currentImage = 0;
-    //std::array<GLuint, 64> _imageCache;
+    // The state that is shared with the decode jobs. It lives in a shared_ptr so that
+    // jobs that are still in flight stay valid if the cache is moved or destroyed. An
+    // image without data refers to a texture that already existed when it was loaded,
+    // a nullptr is stored for images that failed to load
+    struct FrameStore {
+        // Returns whether the image is still waiting to be loaded by the job
+        bool isWanted(uint32_t image, uint32_t job);
+        void finish(uint32_t image, uint32_t job, std::shared_ptr<const DecodedImage> d);
+
+        // Computes the tile deltas between the image and its neighbors if they have been
+        // decoded already. Has to be called without holding the mutex
+        void updateDeltas(uint32_t image);
+
+        // Returns the decoded data of the image if it is available. Has to be called
+        // while holding the mutex
+        std::shared_ptr<const DecodedImage> decoded(uint32_t image) const;
+
+        std::mutex mutex;
+        std::map<uint32_t, std::shared_ptr<const DecodedImage>> images;
+        // The images that are being loaded and the number of the job that loads them.
+        // Jobs whose image was discarded or scheduled again are ignored when they finish
+        std::map<uint32_t, uint32_t> pending;
+        uint32_t nScheduledJobs = 0;
+        // The difference between image i - 1 and image i is stored at index i
+        std::map<uint32_t, std::shared_ptr<const TileDelta>> deltas;
+        // The image that is currently shown, so that the next image can be compared to it
+        std::optional<uint32_t> shownIndex;
+        std::shared_ptr<const DecodedImage> shownImage;
+        // Incremented whenever the current image is discarded to invalidate its reload
+        uint32_t generation = 0;
+
+        // The new version of the current image after its file has been changed
+        bool isReloading = false;
+        bool isReloadPrepared = false;
+        std::shared_ptr<const DecodedImage> reloadedImage;
+    };
+
+    // Tiled images are loaded for the region, all other images are loaded completely. On
+    // the nodes, the file is fetched from the master first
+    static std::shared_ptr<const DecodedImage> load(const std::filesystem::path& path,
+        bool allowExistingTexture, bool storesThumbnail, const ImageRegion& region);
+
+    // Returns a placeholder if we have seen this file before and its texture is still
+    // around, in which case we neither have to read nor decode it
+    static std::shared_ptr<const DecodedImage> existingImage(
+        const std::filesystem::path& path);
+
+    // A thumbnail is only stored for the images that are likely to be seeked to
+    static std::shared_ptr<const DecodedImage> decode(const std::filesystem::path& path,
+        std::vector<unsigned char> contents, bool allowExistingTexture,
+        bool storesThumbnail);
+    // Schedules the image to be decoded in the background unless it already is. Has to
+    // be called while holding the mutex of the frame store
+    void schedule(uint32_t image);
+
+    // Replaces the preview with the full resolution image once it has been decoded
+    void refinePreview();
+
+    void show(std::shared_ptr<const DecodedImage> image,
+        std::shared_ptr<const TileDelta> delta);
+    void rememberShownImage(std::shared_ptr<const DecodedImage> image);
+
+    std::optional<uint32_t> _currentImage;
+    std::string _loadedImage;
+    // The current image is shown as a thumbnail while the full image is being decoded
+    bool _isPreview = false;
+    std::chrono::steady_clock::time_point _previewStartTime;
 
     GLuint _texture = 0;
+    std::optional<ImageKey> _textureKey;
+    glm::vec4 _uvRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+    uint32_t _textureVersion = 0;
+
+    std::chrono::steady_clock::time_point _reloadStartTime;
 
-    const std::vector<std::filesystem::path> _paths;
+    uint64_t _nTiles = 0;
+    uint64_t _nSkippedTiles = 0;
 
+    std::vector<std::filesystem::path> _paths;
+    bool _hasTiledImages = false;
+    ImageRegion _region;
+    std::shared_ptr<FrameStore> _store;
 };
 
 
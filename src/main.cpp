@@ -28,15 +28,47 @@
  * DAMAGE.                                                                               *
  ****************************************************************************************/
 
+#include "allocationtracker.h"
+#include "assetcache.h"
+#include "benchmark.h"
+#include "deltasync.h"
+#include "filereader.h"
+#include "filewatcher.h"
+#include "framecapture.h"
+#include "framewriter.h"
+#include "headless.h"
 #include "inireader.h"
+#include "metrics.h"
+#include "multiview.h"
 #include "object.h"
+#include "playback.h"
+#include "rasterizer.h"
+#include "readiness.h"
+#include "renderlist.h"
+#include "scenebatch.h"
+#include "sequenceindex.h"
+#include "thumbnail.h"
+#include "tiledimage.h"
+#include "trace.h"
+#include "visibility.h"
+#include "workerpool.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <sgct/sgct.h>
 #include <glfw/glfw3.h>
+#include <algorithm>
 #include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -50,6 +82,24 @@ namespace {
     constexpr const float Sensitivity = 1.f / 25.f;
 #endif // WIN32
 
+    // The viewports are widened by this fraction when testing whether objects are in
+    // view, so that their images are loaded shortly before they become visible
+    constexpr const float VisibilityMargin = 0.25f;
+    // Objects only release their images after being out of view for this long, so that
+    // moving the camera back and forth doesn't load the same images over and over
+    constexpr const std::chrono::seconds ReleaseDelay = std::chrono::seconds(2);
+    // While the camera moves, the regions of the tiled images are recomputed at most this
+    // often, as this goes through the vertices of every object on the CPU. The margin
+    // around the regions covers the camera movement in the meantime
+    constexpr const std::chrono::milliseconds RegionUpdateInterval =
+        std::chrono::milliseconds(100);
+    // The master sends the complete synchronized state this often, so that a client that
+    // failed to decode a frame catches up even if it can't report back
+    constexpr const uint32_t KeyframeInterval = 600;
+    // A client keeps asking for a keyframe until its report after the keyframe arrives,
+    // so the requests are only answered this many frames apart
+    constexpr const uint32_t KeyframeRequestInterval = 30;
+
     constexpr const char* VertexShader = R"(
 #version 330 core
 
@@ -61,10 +111,15 @@ out vec3 tr_position;
 out vec3 tr_normal;
 out vec2 tr_uv;
 
-uniform mat4 mvp;
+uniform mat4 model;
+layout (std140) uniform ViewportData {
+  mat4 mvp[16];
+  int flipTex;
+  int nViews;
+};
 
 void main() {
-  gl_Position = mvp * vec4(in_position, 1.0);
+  gl_Position = mvp[0] * model * vec4(in_position, 1.0);
 
   tr_position = in_position;
   tr_normal = in_normal;
@@ -82,15 +137,142 @@ in vec2 tr_uv;
 out vec4 color;
 
 uniform sampler2D tex;
-uniform int flipTex;
+// The part of the texture coordinates that the texture covers as offset and size
+uniform vec4 uvRect;
+layout (std140) uniform ViewportData {
+  mat4 mvp[16];
+  int flipTex;
+  int nViews;
+};
 
 void main() {
   vec2 texCoords = tr_uv;
   if (flipTex != 0) {
     texCoords.y = 1.0 - texCoords.y;
   }
+  texCoords = (texCoords - uvRect.xy) / uvRect.zw;
   color = texture(tex, texCoords);
 }
+)";
+
+    // The same as above, but for drawing all objects at once with the SceneBatch
+    constexpr const char* BatchedVertexShader = R"(
+#version 330 core
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_uv;
+layout (location = 3) in uint in_layer;
+layout (location = 4) in mat4 in_model;
+
+out vec3 tr_position;
+out vec3 tr_normal;
+out vec2 tr_uv;
+flat out uint tr_layer;
+
+layout (std140) uniform ViewportData {
+  mat4 mvp[16];
+  int flipTex;
+  int nViews;
+};
+
+void main() {
+  gl_Position = mvp[0] * in_model * vec4(in_position, 1.0);
+
+  tr_position = in_position;
+  tr_normal = in_normal;
+  tr_uv = in_uv;
+  tr_layer = in_layer;
+}
+)";
+
+    constexpr const char* BatchedFragmentShader = R"(
+#version 330 core
+
+in vec3 tr_position;
+in vec3 tr_normal;
+in vec2 tr_uv;
+flat in uint tr_layer;
+
+out vec4 color;
+
+uniform sampler2DArray tex;
+layout (std140) uniform ViewportData {
+  mat4 mvp[16];
+  int flipTex;
+  int nViews;
+};
+
+void main() {
+  color = texture(tex, vec3(tr_uv, float(tr_layer)));
+}
+)";
+
+    // The vertex shaders for rendering all views at once with the MultiViewTarget, where
+    // the instance index modulo the number of views selects the view
+    constexpr const char* MultiViewVertexShader = R"(
+#version 410 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_uv;
+
+out vec3 tr_position;
+out vec3 tr_normal;
+out vec2 tr_uv;
+
+uniform mat4 model;
+layout (std140) uniform ViewportData {
+  mat4 mvp[16];
+  int flipTex;
+  int nViews;
+};
+
+void main() {
+  int view = gl_InstanceID % nViews;
+  gl_Position = mvp[view] * model * vec4(in_position, 1.0);
+  gl_Layer = view;
+  gl_ViewportIndex = view;
+
+  tr_position = in_position;
+  tr_normal = in_normal;
+  tr_uv = in_uv;
+}
+)";
+
+    constexpr const char* BatchedMultiViewVertexShader = R"(
+#version 410 core
+#extension GL_ARB_shader_viewport_layer_array : require
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_uv;
+layout (location = 3) in uint in_layer;
+layout (location = 4) in mat4 in_model;
+
+out vec3 tr_position;
+out vec3 tr_normal;
+out vec2 tr_uv;
+flat out uint tr_layer;
+
+layout (std140) uniform ViewportData {
+  mat4 mvp[16];
+  int flipTex;
+  int nViews;
+};
+
+void main() {
+  int view = gl_InstanceID % nViews;
+  gl_Position = mvp[view] * in_model * vec4(in_position, 1.0);
+  gl_Layer = view;
+  gl_ViewportIndex = view;
+
+  tr_position = in_position;
+  tr_normal = in_normal;
+  tr_uv = in_uv;
+  tr_layer = in_layer;
+}
 )";
 
     // Synchronized values
@@ -99,9 +281,13 @@ void main() {
     double lookAtTheta = 0.0;
 
     bool useSpoutTextures = false;
-    uint32_t currentImage = 0;
+    uint32_t reloadEpoch = 0;
     bool showHelp = false;
     bool showStatistics = false;
+    bool isCapturing = false;
+    bool isTracing = false;
+    // Every increase makes all nodes save their trace
+    uint32_t traceEpoch = 0;
 
     // State value
     std::vector<Object> objects;
@@ -112,12 +298,535 @@ void main() {
     bool printCornerVertices = false;
     bool renderModels = false;
     bool renderCylinder = false;
+    bool batchedRendering = false;
+    bool singlePassRendering = false;
+    // Every node only loads the images of the objects that are in view of its viewports
+    bool viewportCulling = false;
+    // Tiled images are only loaded for the part that is visible on this node
+    bool regionStreaming = false;
+    std::vector<glm::mat4> viewProjections;
+    // The views for which the regions of the objects were last computed
+    std::vector<glm::mat4> regionViewProjections;
+    std::chrono::steady_clock::time_point lastRegionUpdate;
+    bool haveRegionsChanged = true;
     float cylinderHeight = 0.f;
     float cylinderRadius = 0.f;
 
+    // The rate of the objects that don't have their own, and of the headless rendering
+    double playbackFps = 30.0;
+    // The number of frames of every object that are scheduled to be decoded in advance
+    uint32_t lookahead = 8;
+    // The smoothed time between the frames on the master, which is used to predict the
+    // frames that will be shown next
+    double frameInterval = 0.0;
+    std::chrono::steady_clock::time_point lastPreSyncTime;
+    std::unique_ptr<ReadinessReporter> readinessReporter;
+    std::unique_ptr<ReadinessCollector> readinessCollector;
+    NodeStatus nodeStatus;
+
+    // Changed files are swapped in on all nodes at the same time, whenever the master
+    // increases the reload epoch
+    uint32_t appliedReloadEpoch = 0;
+    std::unique_ptr<FileWatcher> modelWatcher;
+
+    // Draws all objects with a single draw call if possible
+    std::unique_ptr<SceneBatch> sceneBatch;
+    RenderList renderList;
+    // Renders all eyes and viewports of a window at once if possible
+    std::unique_ptr<MultiViewTarget> multiView;
+    // Writes the rendered frames to disk while capturing is enabled
+    std::unique_ptr<FrameCapture> frameCapture;
+    FrameCapture::Settings captureSettings;
+
+    // Records the phases of the frames for saving them as Chrome traces
+    uint32_t appliedTraceEpoch = 0;
+    std::filesystem::path traceFolder = "trace";
+    bool saveTraceOnExit = false;
+    Trace::Clock::time_point lastPostDrawTime;
+
+    // The synchronized state is serialized into this buffer every frame, which keeps its
+    // capacity so that only the copy that is handed to SGCT has to be allocated
+    std::vector<std::byte> syncBuffer;
+    // Only the changes since the previous frame are sent to the clients
+    DeltaEncoder syncEncoder;
+    uint32_t nFramesSinceKeyframe = 0;
+    // A client that failed to decode the synchronized state ignores the changes until
+    // the next keyframe, as they would be applied to the wrong values
+    bool isSyncBroken = false;
+    uint64_t nSyncBytes = 0;
+    uint32_t nSyncFrames = 0;
+    std::chrono::steady_clock::time_point lastSyncReport;
+
+    // The heap allocations of the render thread, counted from the start of one frame to
+    // the start of the next. Only available in builds that track allocations
+    AllocationCounts frameStartAllocations;
+    AllocationCounts lastFrameAllocations;
+
+    // Answers the scrapes of the monitoring
+    std::unique_ptr<MetricsServer> metricsServer;
+    uint64_t lastUploadedBytes = 0;
+
+    // The master reads the obj files and images and sends them to the other nodes
+    bool distributeAssets = false;
+    AssetServer::Settings assetServerSettings;
+    AssetClient::Settings assetClientSettings;
+    std::unique_ptr<AssetServer> assetServer;
+
+    // The master can record the synchronized state of every frame and replay it instead
+    // of the interactive input, which makes runs comparable between builds
+    std::unique_ptr<StateRecorder> stateRecorder;
+    std::unique_ptr<StateReplay> stateReplay;
+    std::unique_ptr<BenchmarkStats> benchmarkStats;
+    std::filesystem::path benchmarkOutput = "benchmark.json";
+    // 0 replays all recorded frames
+    uint32_t nBenchmarkFrames = 0;
+    uint32_t nReplayedFrames = 0;
+
+    // Renders a range of images to disk without an SGCT window
+    struct HeadlessSettings {
+        glm::ivec2 size = glm::ivec2(1920, 1080);
+        // The vertical field of view in degrees
+        float fieldOfView = 90.f;
+        std::filesystem::path outputFolder = "render";
+        uint32_t firstImage = 0;
+        // 0 renders all images up to the end of the longest sequence
+        uint32_t nImages = 0;
+        // Renders with the Rasterizer on the CPU instead of with OpenGL
+        bool useSoftwareRenderer = false;
+    };
+
+    template <typename T>
+    T readValue(const Group& group, const std::string& key, T defaultValue) {
+        auto it = group.find(key);
+        if (it == group.end()) {
+            return defaultValue;
+        }
+
+        T res = defaultValue;
+#ifdef WIN32
+        std::from_chars(it->second.data(), it->second.data() + it->second.size(), res);
+#else // WIN32
+        std::istringstream str(it->second);
+        str >> res;
+#endif // WIN32
+        return res;
+    }
+
+    // Removes the option and its value from the arguments and returns the value
+    std::optional<std::string> takeArgument(std::vector<std::string>& arg,
+                                            const std::string& option)
+    {
+        auto it = std::find(arg.begin(), arg.end(), option);
+        if (it == arg.end() || it + 1 == arg.end()) {
+            return std::nullopt;
+        }
+        std::string value = *(it + 1);
+        arg.erase(it, it + 2);
+        return value;
+    }
+
+    // Reads a vector of three whitespace-separated values, such as "1 0 -2.5". A single
+    // value is used for all three components
+    glm::vec3 readVec3(const Group& group, const std::string& key, glm::vec3 defaultValue)
+    {
+        auto it = group.find(key);
+        if (it == group.end()) {
+            return defaultValue;
+        }
+
+        std::istringstream str(it->second);
+        float x = 0.f;
+        float y = 0.f;
+        float z = 0.f;
+        if (!(str >> x)) {
+            return defaultValue;
+        }
+        if (!(str >> y >> z)) {
+            return glm::vec3(x);
+        }
+        return glm::vec3(x, y, z);
+    }
+
+    // Returns the rate of the object with the provided name from the [Fps] section and
+    // its loop from the [Loop] section, which contains the first and the last image of
+    // the loop, such as "100 199". Invalid entries are ignored with a warning
+    Playback readPlayback(Ini& ini, const std::string& name) {
+        Playback playback;
+        playback.fps = readValue(ini["Fps"], name, playbackFps);
+        if (!std::isfinite(playback.fps) || playback.fps <= 0.0) {
+            Log::Warning(
+                "Invalid rate of %s, using %.2f fps instead",
+                name.c_str(), playbackFps
+            );
+            playback.fps = playbackFps;
+        }
+
+        const Group& loop = ini["Loop"];
+        auto it = loop.find(name);
+        if (it != loop.end()) {
+            std::istringstream str(it->second);
+            uint32_t first = 0;
+            uint32_t last = 0;
+            if ((str >> first >> last) && first <= last) {
+                playback.loopFirst = first;
+                playback.loopEnd = last + 1;
+            }
+            else {
+                Log::Warning(
+                    "Invalid loop of %s, playing without a loop: %s",
+                    name.c_str(), it->second.c_str()
+                );
+            }
+        }
+
+        // The schedule is only planned on the master and has the same size on all nodes
+        playback.schedule.resize(std::min(lookahead, ReadinessWindow));
+        playback.plan(0.0);
+        return playback;
+    }
+
+    // Returns the placement of the object with the provided name from the [Position],
+    // [Rotation] (in degrees, applied in the order y, x, z) and [Scale] sections
+    glm::mat4 readTransform(Ini& ini, const std::string& name) {
+        const glm::vec3 position = readVec3(ini["Position"], name, glm::vec3(0.f));
+        const glm::vec3 rotation = readVec3(ini["Rotation"], name, glm::vec3(0.f));
+        const glm::vec3 scale = readVec3(ini["Scale"], name, glm::vec3(1.f));
+
+        glm::mat4 transform = glm::translate(glm::mat4(1.f), position);
+        transform = glm::rotate(transform, glm::radians(rotation.y), glm::vec3(0, 1, 0));
+        transform = glm::rotate(transform, glm::radians(rotation.x), glm::vec3(1, 0, 0));
+        transform = glm::rotate(transform, glm::radians(rotation.z), glm::vec3(0, 0, 1));
+        return glm::scale(transform, scale);
+    }
+
+    // Describes which of the upcoming frames of every object are ready on this node. The
+    // status is updated in place so that it keeps its memory between the frames
+    void updateNodeStatus(NodeStatus& status) {
+        status.sequences.resize(objects.size());
+        status.nPendingReloads = 0;
+        status.nPreparedReloads = 0;
+        status.needsKeyframe = isSyncBroken;
+        for (size_t i = 0; i < objects.size(); ++i) {
+            const Object& obj = objects[i];
+            status.sequences[i].firstFrame = obj.playback.currentFrame + 1;
+            // Objects that are out of view must not hold back the other nodes
+            status.sequences[i].readyMask = obj.isVisible ?
+                obj.imageCache.readyMask(obj.upcomingImages) :
+                ~uint64_t(0);
+            status.nPendingReloads += obj.hasPendingReload() ? 1 : 0;
+            status.nPreparedReloads += obj.hasPreparedReload() ? 1 : 0;
+        }
+    }
+
+    void checkForChangedModels() {
+        if (!modelWatcher) {
+            return;
+        }
+
+        for (const std::filesystem::path& p : modelWatcher->changedFiles()) {
+            for (Object& obj : objects) {
+                if (obj.type != Object::Type::Model) {
+                    continue;
+                }
+                const std::filesystem::path objPath =
+                    std::filesystem::absolute(obj.objFile).lexically_normal();
+                if (objPath == p.lexically_normal()) {
+                    obj.reloadModel();
+                }
+            }
+        }
+    }
+
+    glm::mat4 cameraMatrix() {
+        glm::mat4 translation = glm::translate(glm::mat4(1.f), eyePosition);
+
+        glm::quat phiRotation = glm::angleAxis(
+            static_cast<float>(lookAtPhi),
+            glm::vec3(0.f, 1.f, 0.f)
+        );
+        glm::quat thetaRotation = glm::angleAxis(
+            static_cast<float>(lookAtTheta),
+            glm::vec3(1.f, 0.f, 0.f)
+        );
+        glm::quat view = thetaRotation * phiRotation;
+        return glm::mat4_cast(view) * translation;
+    }
+
+    // Restricts the tiled images of every object to the texture coordinates of the
+    // triangles that are in view and to the number of pixels of this node. A region is
+    // only replaced if the visible part has left it or has become much smaller, so that
+    // small camera movements don't cause the images to be loaded again
+    void updateImageRegions(bool canCull) {
+        using namespace std::chrono;
+        const steady_clock::time_point now = steady_clock::now();
+        if (!haveRegionsChanged && (viewProjections == regionViewProjections ||
+                                    now - lastRegionUpdate < RegionUpdateInterval))
+        {
+            return;
+        }
+        haveRegionsChanged = false;
+        regionViewProjections = viewProjections;
+        lastRegionUpdate = now;
+
+        const uint64_t maxTexels = nodePixels();
+        for (Object& obj : objects) {
+            TexCoordRange visible;
+            if (canCull) {
+                for (const Mesh::Part& part : obj.mesh->parts) {
+                    if (!part.texture.empty()) {
+                        // Parts with a texture don't show the image sequence
+                        continue;
+                    }
+                    for (const glm::mat4& viewProjection : viewProjections) {
+                        addVisibleTexCoords(
+                            viewProjection * obj.transform,
+                            obj.mesh->vertices,
+                            part.first,
+                            part.nVertices,
+                            VisibilityMargin,
+                            visible
+                        );
+                    }
+                }
+                if (visible.min.x > visible.max.x) {
+                    // Nothing to show, which the viewport culling takes care of
+                    continue;
+                }
+            }
+            else {
+                visible.min = glm::vec2(0.f);
+                visible.max = glm::vec2(1.f);
+            }
+
+            const ImageRegion& current = obj.imageCache.region();
+            const bool isInside = current.min.x <= visible.min.x &&
+                current.min.y <= visible.min.y && current.max.x >= visible.max.x &&
+                current.max.y >= visible.max.y;
+            const glm::vec2 size = visible.max - visible.min;
+            const glm::vec2 currentSize = current.max - current.min;
+            const bool isTooLarge = currentSize.x * currentSize.y > 2.f * size.x * size.y;
+            if (isInside && !isTooLarge && current.maxTexels == maxTexels) {
+                continue;
+            }
+
+            ImageRegion region;
+            region.min = visible.min - size * 0.1f;
+            region.max = visible.max + size * 0.1f;
+            region.maxTexels = maxTexels;
+            obj.imageCache.setRegion(region);
+        }
+    }
+
+    // Decides which objects can be seen in the viewports of this node. This is repeated
+    // every frame, so that objects that the camera moves into view are loaded on demand
+    void updateVisibility() {
+        if (!viewportCulling && !regionStreaming) {
+            return;
+        }
+
+        // Non-linear projections see the objects in every direction
+        const bool canCull = nodeViewProjections(viewProjections);
+        const glm::mat4 camera = cameraMatrix();
+        for (glm::mat4& viewProjection : viewProjections) {
+            viewProjection = viewProjection * camera;
+        }
+
+        const std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+        for (Object& obj : objects) {
+            bool isInView = !viewportCulling || !canCull;
+            for (size_t i = 0; !isInView && i < viewProjections.size(); ++i) {
+                const glm::mat4 clip = viewProjections[i] * obj.transform;
+                isInView = isInFrustum(clip, obj.mesh->bounds, VisibilityMargin);
+            }
+
+            if (isInView != obj.isVisible) {
+                Log::Debug(
+                    "%s is %s", obj.name.c_str(), isInView ? "in view" : "out of view"
+                );
+            }
+            obj.isVisible = isInView;
+            if (isInView) {
+                obj.lastVisibleTime = now;
+            }
+        }
+
+        if (regionStreaming) {
+            updateImageRegions(canCull);
+        }
+    }
+
+    void saveTrace() {
+        const int nodeId = ClusterManager::instance().thisNodeId();
+        char name[64];
+        std::snprintf(name, sizeof(name), "node%i_%u.json", nodeId, traceEpoch);
+        try {
+            std::filesystem::create_directories(traceFolder);
+            const std::filesystem::path path = traceFolder / name;
+            Trace::instance().save(path, nodeId, "Node " + std::to_string(nodeId));
+            Log::Info("Saved trace to %s", path.string().c_str());
+        }
+        catch (const std::exception& e) {
+            Log::Error("Error saving trace: %s", e.what());
+        }
+    }
+
+    // Has to be called before the objects are loaded, as the nodes fetch their files from
+    // the master from then on. Only the folders of the objects are served
+    void startAssetDistribution() {
+        if (!Engine::instance().isMaster()) {
+            // Nodes that run on the same machine must not share their files
+            AssetClient::Settings settings = assetClientSettings;
+            const int nodeId = ClusterManager::instance().thisNodeId();
+            settings.cacheFolder /= "node" + std::to_string(nodeId);
+            AssetClient::initialize(std::move(settings));
+            return;
+        }
+
+        std::vector<std::filesystem::path> folders;
+        for (const Object& obj : objects) {
+            if (!obj.objFile.empty()) {
+                folders.push_back(std::filesystem::absolute(obj.objFile).parent_path());
+            }
+            if (!obj.imageIndex.folder().empty()) {
+                folders.push_back(obj.imageIndex.folder());
+            }
+        }
+        try {
+            assetServer = std::make_unique<AssetServer>(
+                assetServerSettings,
+                std::move(folders)
+            );
+            Log::Info("Serving assets on port %u", assetServerSettings.port);
+        }
+        catch (const std::runtime_error& e) {
+            Log::Error("Asset distribution disabled: %s", e.what());
+        }
+    }
+
+    // The vertex buffers are shared between the objects that use the same mesh, so the
+    // sum over all objects can be larger than the memory that is actually used
+    void updateObjectMetrics() {
+        for (const Object& obj : objects) {
+            Gauge& vboBytes = Metrics::instance().gauge(
+                "object_vbo_bytes",
+                "The size of the vertex buffer of each object",
+                metricLabel("object", obj.name)
+            );
+            vboBytes.set(static_cast<int64_t>(obj.mesh->nVertices * sizeof(Vertex)));
+        }
+    }
+
+    void finishBenchmark() {
+        const BenchmarkReport report = benchmarkStats->report();
+        try {
+            saveReport(benchmarkOutput, report);
+        }
+        catch (const std::runtime_error& e) {
+            Log::Error("%s", e.what());
+        }
+        Log::Info(
+            "Replayed %llu frames: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, "
+            "peak RSS %llu MB",
+            static_cast<unsigned long long>(report.nFrames),
+            report.frameTimeP50 * 1000.0,
+            report.frameTimeP95 * 1000.0,
+            report.frameTimeP99 * 1000.0,
+            static_cast<unsigned long long>(report.peakResidentBytes / (1024 * 1024))
+        );
+    }
+
+    // Visits all synchronized values in the same order with either the DeltaEncoder on
+    // the master or the DeltaDecoder on the clients. SyncVersion has to be increased
+    // whenever the fields change
+    template <typename Coder>
+    void synchronize(Coder& coder) {
+        coder.beginGroup();
+        coder.field(eyePosition.x);
+        coder.field(eyePosition.y);
+        coder.field(eyePosition.z);
+        coder.field(lookAtPhi);
+        coder.field(lookAtTheta);
+        coder.field(reloadEpoch);
+        coder.field(showHelp);
+        coder.field(showStatistics);
+        coder.field(isCapturing);
+        coder.field(isTracing);
+        coder.field(traceEpoch);
+        coder.field(useSpoutTextures);
+        coder.endGroup();
+
+        // Objects that are not playing only cost the single byte of their empty mask
+        for (Object& obj : objects) {
+            coder.beginGroup();
+            coder.field(obj.playback.fps);
+            coder.field(obj.playback.loopFirst);
+            coder.field(obj.playback.loopEnd);
+            coder.field(obj.playback.currentFrame);
+            coder.field(obj.playback.targetFrame);
+            coder.field(obj.playback.nDroppedImages);
+            coder.field(obj.playback.nLateImages);
+            coder.endGroup();
+
+            coder.beginGroup();
+            for (uint32_t& offset : obj.playback.schedule) {
+                coder.field(offset);
+            }
+            coder.endGroup();
+        }
+    }
+
+    // Loads the current images, applies reloads, and records the render list for the
+    // current frame
+    void prepareFrame() {
+        TraceScope scope("Prepare frame");
+        checkForChangedModels();
+        const bool applyReloads = reloadEpoch != appliedReloadEpoch;
+        appliedReloadEpoch = reloadEpoch;
+        updateVisibility();
+        const std::chrono::steady_clock::time_point now =
+            std::chrono::steady_clock::now();
+
+        for (Object& obj : objects) {
+            obj.updateImages();
+            if (applyReloads) {
+                obj.applyReloads();
+                // The visible part of the images depends on the geometry
+                haveRegionsChanged = true;
+            }
+            obj.playback.upcomingImages(ReadinessWindow, obj.upcomingImages);
+            if (!obj.isVisible) {
+                const bool hasImages = obj.imageCache.texture() != 0 ||
+                    !obj.materialImages.empty();
+                if (hasImages && now - obj.lastVisibleTime > ReleaseDelay) {
+                    obj.releaseImages();
+                }
+                continue;
+            }
+            obj.imageCache.setCurrentImage(obj.playback.currentImage());
+            obj.playback.scheduledImages(obj.scheduledImages);
+            obj.imageCache.prefetch(obj.scheduledImages);
+            obj.updateMaterialImages();
+        }
+        if (applyReloads) {
+            updateObjectMetrics();
+        }
+        bool isSceneBatched = false;
+        if (sceneBatch) {
+            if (applyReloads) {
+                sceneBatch->setGeometry(objects);
+            }
+            isSceneBatched = !useSpoutTextures && sceneBatch->updateTextures(objects);
+        }
+        SceneBatch* batch = isSceneBatched ? sceneBatch.get() : nullptr;
+        renderList.build(objects, batch, useSpoutTextures);
+    }
+
 } // namespace
 
-void initGL(GLFWwindow*) {
+// Loads the objects and sets up the rendering. This is shared by the cluster and the
+// headless rendering, so it must not rely on the Engine
+void initScene() {
     for (Object& obj : objects) {
         if (obj.type == Object::Type::Model) {
             obj.initializeFromModel(printCornerVertices);
@@ -125,72 +834,244 @@ void initGL(GLFWwindow*) {
         if (obj.type == Object::Type::Cylinder) {
             obj.initializeFromCylinder(cylinderRadius, cylinderHeight);
         }
-        obj.imageCache.setCurrentImage(0);
     }
+    // The meshes are needed for deciding which objects are in view, so their images are
+    // loaded afterwards
+    updateVisibility();
+    for (Object& obj : objects) {
+        if (obj.isVisible) {
+            obj.imageCache.setCurrentImage(0);
+            obj.updateMaterialImages();
+        }
+    }
+    updateObjectMetrics();
     Log::Info("Finished loading");
 
+    modelWatcher = std::make_unique<FileWatcher>();
+    for (const Object& obj : objects) {
+        if (obj.type == Object::Type::Model) {
+            std::filesystem::path p = std::filesystem::absolute(obj.objFile);
+            modelWatcher->watchDirectory(p.parent_path().lexically_normal());
+        }
+    }
+
     ShaderManager::instance().addShaderProgram("wall", VertexShader, FragmentShader);
-}
 
-void preSync() {
-    if (playingImages) {
-        currentImage += 1;
+    if (batchedRendering) {
+        if (SceneBatch::isSupported()) {
+            ShaderManager::instance().addShaderProgram(
+                "wallBatched",
+                BatchedVertexShader,
+                BatchedFragmentShader
+            );
+            sceneBatch = std::make_unique<SceneBatch>();
+            sceneBatch->setGeometry(objects);
+        }
+        else {
+            Log::Warning("Batched rendering requires OpenGL 4.3");
+        }
+    }
+
+    if (singlePassRendering) {
+        if (MultiViewTarget::isSupported()) {
+            ShaderManager::instance().addShaderProgram(
+                "wallMultiView",
+                MultiViewVertexShader,
+                FragmentShader
+            );
+            if (sceneBatch) {
+                ShaderManager::instance().addShaderProgram(
+                    "wallBatchedMultiView",
+                    BatchedMultiViewVertexShader,
+                    BatchedFragmentShader
+                );
+            }
+            multiView = std::make_unique<MultiViewTarget>();
+        }
+        else {
+            Log::Warning(
+                "Single-pass rendering requires GL_ARB_shader_viewport_layer_array"
+            );
+        }
     }
+
+    renderList.initialize(sceneBatch != nullptr, multiView != nullptr);
 }
 
-void postSyncPreDraw() {
-    for (Object& obj : objects) {
-        obj.imageCache.setCurrentImage(currentImage);
+void initGL(GLFWwindow*) {
+    // Only the master writes the manifests of the image folders, the nodes read them
+    SequenceIndex::setWritesManifest(Engine::instance().isMaster());
+    if (distributeAssets && ClusterManager::instance().numberOfNodes() > 1) {
+        startAssetDistribution();
     }
-    Engine::instance().setStatsGraphVisibility(showStatistics);
+    initScene();
 }
 
-void draw(const RenderData& data) {
-    glEnable(GL_CULL_FACE);
+void decode(const std::vector<std::byte>& data, unsigned int pos);
 
-    glm::mat4 translation = glm::translate(glm::mat4(1.f), eyePosition);
+void preSync() {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (lastPostDrawTime.time_since_epoch().count() != 0) {
+        // SGCT swaps the buffers and waits for the other nodes between the frames
+        Trace::instance().record("Swap and barrier", lastPostDrawTime, now);
+    }
+    TraceScope scope("preSync");
+
+    const AllocationCounts allocations = threadAllocations();
+    lastFrameAllocations.nAllocations =
+        allocations.nAllocations - frameStartAllocations.nAllocations;
+    lastFrameAllocations.nBytes = allocations.nBytes - frameStartAllocations.nBytes;
+    frameStartAllocations = allocations;
+
+    const double dt = lastPreSyncTime.time_since_epoch().count() == 0 ?
+        0.0 :
+        std::chrono::duration<double>(now - lastPreSyncTime).count();
+    lastPreSyncTime = now;
+    if (dt > 0.0) {
+        static Histogram& FrameTime = Metrics::instance().histogram(
+            "frame_seconds",
+            "The time between the starts of consecutive frames",
+            { 0.008, 0.011, 0.017, 0.025, 0.034, 0.05, 0.1, 0.25 }
+        );
+        FrameTime.observe(dt);
+    }
 
-    glm::quat phiRotation = glm::angleAxis(
-        static_cast<float>(lookAtPhi),
-        glm::vec3(0.f, 1.f, 0.f)
-    );
-    glm::quat thetaRotation = glm::angleAxis(
-        static_cast<float>(lookAtTheta),
-        glm::vec3(1.f, 0.f, 0.f)
-    );
-    glm::quat view = thetaRotation * phiRotation;
-    glm::mat4 mvp = data.modelViewProjectionMatrix * glm::mat4_cast(view) * translation;
+    if (stateReplay) {
+        // The recorded state replaces the input and the playback timing of the master
+        if (dt > 0.0) {
+            benchmarkStats->addFrame(dt);
+        }
+        const bool isDone = nBenchmarkFrames > 0 && nReplayedFrames >= nBenchmarkFrames;
+        if (isDone || !stateReplay->next(syncBuffer)) {
+            finishBenchmark();
+            stateReplay = nullptr;
+            Engine::instance().terminate();
+            return;
+        }
+        decode(syncBuffer, 0);
+        nReplayedFrames++;
+        return;
+    }
 
-    const ShaderProgram& prog = ShaderManager::instance().shaderProgram("wall");
-    prog.bind();
+    updateNodeStatus(nodeStatus);
+    if (readinessCollector) {
+        readinessCollector->receive();
+        for (size_t i = 0; i < nodeStatus.sequences.size(); ++i) {
+            SequenceStatus& sequence = nodeStatus.sequences[i];
+            sequence.readyMask &= readinessCollector->clusterMask(i, sequence.firstFrame);
+        }
+        nodeStatus.nPendingReloads += readinessCollector->nPendingReloads();
+        nodeStatus.nPreparedReloads += readinessCollector->nPreparedReloads();
+        if (readinessCollector->needsKeyframe() &&
+            nFramesSinceKeyframe >= KeyframeRequestInterval)
+        {
+            syncEncoder.requestKeyframe();
+            nFramesSinceKeyframe = 0;
+        }
+    }
 
-    glUniformMatrix4fv(
-        glGetUniformLocation(prog.id(), "mvp"),
-        1,
-        GL_FALSE,
-        glm::value_ptr(mvp)
-    );
+    if (nodeStatus.nPreparedReloads > 0 && nodeStatus.nPendingReloads == 0) {
+        // Every node has finished loading the changed files, so they can be swapped in
+        reloadEpoch++;
+    }
 
-    glUniform1i(glGetUniformLocation(prog.id(), "tex"), 0);
+    if (dt > 0.0) {
+        frameInterval = frameInterval == 0.0 ? dt : 0.9 * frameInterval + 0.1 * dt;
+    }
+    for (size_t i = 0; i < objects.size(); ++i) {
+        Playback& playback = objects[i].playback;
+        if (playingImages) {
+            playback.advance(dt, nodeStatus.sequences[i].readyMask);
+        }
+        // All nodes decode the images of the scheduled frames in advance, so that the
+        // images that the master will show next are ready everywhere at the same time
+        playback.plan(playingImages ? frameInterval : 0.0);
+    }
+}
 
-    glUniform1i(glGetUniformLocation(prog.id(), "flipTex"), useSpoutTextures ? 1 : 0);
-    
-    glActiveTexture(GL_TEXTURE0);
-    for (Object& obj : objects) {
-        obj.bindTexture(useSpoutTextures);
+void postSyncPreDraw() {
+    TraceScope scope("postSyncPreDraw");
+    Trace::instance().setEnabled(isTracing);
+    Trace::instance().collectGpuTimes();
+    if (traceEpoch != appliedTraceEpoch) {
+        appliedTraceEpoch = traceEpoch;
+        saveTrace();
+    }
 
-        glBindVertexArray(obj.vao);
-        glDrawArrays(GL_TRIANGLES, 0, obj.nVertices);
+    prepareFrame();
 
-        obj.unbindTexture(useSpoutTextures);
+    // All texture uploads of a frame happen while it is being prepared
+    static Counter& UploadedBytes = Metrics::instance().counter(
+        "texture_upload_bytes_total",
+        "The number of bytes that were uploaded to textures"
+    );
+    static Histogram& FrameUploads = Metrics::instance().histogram(
+        "texture_upload_bytes_per_frame",
+        "The number of bytes that were uploaded to textures in each frame",
+        { 0.0, 1e6, 4e6, 16e6, 64e6, 256e6 }
+    );
+    const uint64_t uploadedBytes = UploadedBytes.value();
+    FrameUploads.observe(static_cast<double>(uploadedBytes - lastUploadedBytes));
+    lastUploadedBytes = uploadedBytes;
+    if (metricsServer) {
+        metricsServer->update();
     }
 
-    prog.unbind();
+    if (frameCapture) {
+        frameCapture->update();
+    }
+    if (readinessReporter) {
+        updateNodeStatus(nodeStatus);
+        readinessReporter->report(nodeStatus);
+    }
+    Engine::instance().setStatsGraphVisibility(showStatistics);
+}
+
+void draw(const RenderData& data) {
+    TraceScope scope("draw");
+    Trace::instance().beginGpu("draw");
+    glEnable(GL_CULL_FACE);
+
+    const glm::mat4 camera = cameraMatrix();
+
+    if (multiView && multiView->canDraw(data)) {
+        multiView->draw(data, camera, renderList);
+    }
+    else {
+        renderList.draw(data.modelViewProjectionMatrix * camera);
+    }
 
     glDisable(GL_CULL_FACE);
+    Trace::instance().endGpu();
 }
 
 void draw2D(const RenderData& data) {
+    TraceScope scope("draw2D");
+    // The window's framebuffer contains all viewports of the eye once the last viewport
+    // has been rendered; the capture is started before the overlays are drawn
+    const bool isLastViewport = data.window.viewports().back().get() == &data.viewport;
+    if (isCapturing && isLastViewport) {
+        if (!frameCapture) {
+            frameCapture = std::make_unique<FrameCapture>(captureSettings);
+        }
+        const char* eye = data.frustumMode == Frustum::Mode::StereoLeftEye ? "left" :
+            data.frustumMode == Frustum::Mode::StereoRightEye ? "right" : "mono";
+        char view[64];
+        std::snprintf(
+            view,
+            sizeof(view),
+            "node%i_window%i_%s",
+            ClusterManager::instance().thisNodeId(),
+            data.window.id(),
+            eye
+        );
+        frameCapture->capture(
+            view,
+            Engine::instance().currentFrameNumber(),
+            data.bufferSize
+        );
+    }
+
     if (!showHelp) {
         return;
     }
@@ -208,7 +1089,8 @@ void draw2D(const RenderData& data) {
             250.f,
             glm::vec4(0.8f, 0.8f, 0.f, 1.f),
             "Help\nWSAD: Move camera\nSpace: Play/stop images\nUp/Down: Advance images\n"
-            "1: Back to first image"
+            "1: Back to first image\nC: Start/stop capturing frames\n"
+            "T: Start tracing/Save trace"
         );
     }
 
@@ -251,10 +1133,13 @@ void draw2D(const RenderData& data) {
                 25.f,
                 h,
                 glm::vec4(0.8f, 0.8f, 0.8f, 1.f),
-                "%s: %s (%i)",
+                "%s: %s (%i) // Frame: %u (target %u) // Skipped tiles: %.0f%%",
                 obj.name.c_str(),
                 obj.imageCache.loadedImage().c_str(),
-                obj.imageCache.texture()
+                obj.imageCache.texture(),
+                obj.playback.currentFrame,
+                obj.playback.targetFrame,
+                obj.imageCache.skippedTileFraction() * 100.0
             );
         }
         h += 25.f;
@@ -273,6 +1158,12 @@ void draw2D(const RenderData& data) {
         );
     }
     else {
+        uint32_t nDroppedImages = 0;
+        uint32_t nLateImages = 0;
+        for (const Object& obj : objects) {
+            nDroppedImages += obj.playback.nDroppedImages;
+            nLateImages += obj.playback.nLateImages;
+        }
         text::print(
             data.window,
             data.viewport,
@@ -281,20 +1172,97 @@ void draw2D(const RenderData& data) {
             25.f,
             h,
             glm::vec4(0.8f, 0.8f, 0.8f, 1.f),
-            "Images // Current image: %i", currentImage
+            "Images // Dropped: %u // Late: %u",
+            nDroppedImages,
+            nLateImages
+        );
+        text::print(
+            data.window,
+            data.viewport,
+            *f1,
+            text::Alignment::TopLeft,
+            25.f,
+            h + 25.f,
+            glm::vec4(0.8f, 0.8f, 0.8f, 1.f),
+            "Decoded images: %u // Shared images: %u",
+            TextureRegistry::instance().nDecodedImages(),
+            TextureRegistry::instance().nSharedImages()
+        );
+    }
+
+    if (frameCapture) {
+        text::print(
+            data.window,
+            data.viewport,
+            *f1,
+            text::Alignment::TopLeft,
+            25.f,
+            h + 50.f,
+            glm::vec4(0.8f, 0.8f, 0.8f, 1.f),
+            "Capture (%s) // Captured frames: %u // Dropped: %u",
+            isCapturing ? "on" : "off",
+            frameCapture->nCapturedFrames(),
+            frameCapture->nDroppedFrames()
+        );
+        h += 25.f;
+    }
+
+    if (isTrackingAllocations()) {
+        text::print(
+            data.window,
+            data.viewport,
+            *f1,
+            text::Alignment::TopLeft,
+            25.f,
+            h + 50.f,
+            glm::vec4(0.8f, 0.8f, 0.8f, 1.f),
+            "Allocations in the last frame: %llu (%llu bytes)",
+            static_cast<unsigned long long>(lastFrameAllocations.nAllocations),
+            static_cast<unsigned long long>(lastFrameAllocations.nBytes)
         );
     }
 }
 
+void postDraw() {
+    lastPostDrawTime = Trace::Clock::now();
+}
+
 void cleanup() {
+    metricsServer = nullptr;
+    if (saveTraceOnExit) {
+        saveTrace();
+    }
+    Trace::instance().deinitialize();
+    readinessReporter = nullptr;
+    readinessCollector = nullptr;
+    assetServer = nullptr;
+    AssetClient::deinitialize();
+    modelWatcher = nullptr;
+    if (frameCapture) {
+        frameCapture->deinitialize();
+        frameCapture = nullptr;
+    }
+    renderList.deinitialize();
+    if (multiView) {
+        multiView->deinitialize();
+        multiView = nullptr;
+    }
+    if (sceneBatch) {
+        sceneBatch->deinitialize();
+        sceneBatch = nullptr;
+    }
+
     for (Object& obj : objects) {
         obj.deinitialize();
     }
     objects.clear();
+    TextureRegistry::instance().deinitialize();
 }
 
 void keyboard(Key key, Modifier, Action action, int) {
-    if (action == Action::Release) {
+    // The clients only receive the changes of the master's state, so changes made on a
+    // client would never be undone
+    if (action == Action::Release || !Engine::instance().isMaster()) {
         return;
     }
 
@@ -315,10 +1283,15 @@ void keyboard(Key key, Modifier, Action action, int) {
             playingImages = !playingImages;
             break;
         case Key::Up:
-            currentImage += 1;
+            for (Object& obj : objects) {
+                obj.playback.seek(obj.playback.currentImage() + 1);
+            }
             break;
         case Key::Down:
-            currentImage = std::max(currentImage - 1, 0u);
+            for (Object& obj : objects) {
+                const uint32_t image = obj.playback.currentImage();
+                obj.playback.seek(image > 0 ? image - 1 : 0);
+            }
             break;
         case Key::F1:
             showHelp = !showHelp;
@@ -326,13 +1299,26 @@ void keyboard(Key key, Modifier, Action action, int) {
         case Key::I:
             showStatistics = !showStatistics;
             break;
+        case Key::C:
+            isCapturing = !isCapturing;
+            break;
+        case Key::T:
+            if (isTracing) {
+                traceEpoch++;
+            }
+            isTracing = true;
+            break;
         case Key::Key1:
-            currentImage = 0;
+            for (Object& obj : objects) {
+                obj.playback.seek(0);
+            }
             playingImages = false;
             useSpoutTextures = false;
             break;
         case Key::Key2:
-            currentImage = 0;
+            for (Object& obj : objects) {
+                obj.playback.seek(0);
+            }
             playingImages = false;
             useSpoutTextures = true;
             break;
@@ -345,6 +1331,10 @@ void keyboard(Key key, Modifier, Action action, int) {
 }
 
 void mousePos(double x, double y) {
+    if (!Engine::instance().isMaster()) {
+        return;
+    }
+
     int width, height;
     GLFWwindow* w = glfwGetCurrentContext();
     glfwGetWindowSize(w, &width, &height);
@@ -395,33 +1385,303 @@ void mouseButton(MouseButton button, Modifier, Action action) {
 }
 
 std::vector<std::byte> encode() {
-    std::vector<std::byte> data;
-    serializeObject(data, eyePosition.x);
-    serializeObject(data, eyePosition.y);
-    serializeObject(data, eyePosition.z);
-
-    serializeObject(data, lookAtPhi);
-    serializeObject(data, lookAtTheta);
-
-    serializeObject(data, currentImage);
-    serializeObject(data, showHelp);
-    serializeObject(data, showStatistics);
-    serializeObject(data, useSpoutTextures);
-    return data;
+    nFramesSinceKeyframe++;
+    if (nFramesSinceKeyframe >= KeyframeInterval) {
+        syncEncoder.requestKeyframe();
+        nFramesSinceKeyframe = 0;
+    }
+    syncBuffer.clear();
+    syncEncoder.begin(syncBuffer);
+    synchronize(syncEncoder);
+    const size_t nBytes = syncEncoder.end();
+    if (stateRecorder) {
+        stateRecorder->record(syncBuffer);
+    }
+
+    static Counter& SyncBytes = Metrics::instance().counter(
+        "sync_bytes_total",
+        "The number of bytes of synchronized state that the master has sent"
+    );
+    SyncBytes.add(nBytes);
+    nSyncBytes += nBytes;
+    nSyncFrames++;
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (now - lastSyncReport >= std::chrono::seconds(10)) {
+        Log::Info(
+            "Synchronized %.1f bytes per frame over the last %u frames",
+            static_cast<double>(nSyncBytes) / nSyncFrames, nSyncFrames
+        );
+        lastSyncReport = now;
+        nSyncBytes = 0;
+        nSyncFrames = 0;
+    }
+    return syncBuffer;
 }
 
 void decode(const std::vector<std::byte>& data, unsigned int pos) {
-    deserializeObject(data, pos, eyePosition.x);
-    deserializeObject(data, pos, eyePosition.y);
-    deserializeObject(data, pos, eyePosition.z);
+    try {
+        DeltaDecoder decoder(data, pos);
+        if (isSyncBroken && !decoder.isKeyframe()) {
+            return;
+        }
+        synchronize(decoder);
+        if (isSyncBroken) {
+            Log::Info("Resynchronized with the master");
+            isSyncBroken = false;
+        }
+    }
+    catch (const std::runtime_error& e) {
+        Log::Error("Error decoding the synchronized state: %s", e.what());
+        isSyncBroken = true;
+    }
+}
+
+namespace {
+    // Calls renderFrame for every image of the headless settings with the path that the
+    // frame should be written to, and reports the progress in frames per second
+    void renderFrames(const HeadlessSettings& settings,
+        const std::function<void(uint32_t, std::filesystem::path)>& renderFrame)
+    {
+        uint32_t nImages = settings.nImages;
+        if (nImages == 0) {
+            for (const Object& obj : objects) {
+                const uint32_t n = static_cast<uint32_t>(obj.imageIndex.paths().size());
+                nImages = std::max(nImages, n - std::min(n, settings.firstImage));
+            }
+        }
+        std::filesystem::create_directories(settings.outputFolder);
+
+        using namespace std::chrono;
+        const steady_clock::time_point start = steady_clock::now();
+        steady_clock::time_point lastReport = start;
+        uint32_t nReportedFrames = 0;
+        for (uint32_t i = 0; i < nImages; ++i) {
+            const uint32_t image = settings.firstImage + i;
+            char name[32];
+            std::snprintf(name, sizeof(name), "%06u.png", image);
+            renderFrame(image, settings.outputFolder / name);
+
+            const steady_clock::time_point now = steady_clock::now();
+            if (now - lastReport >= seconds(1)) {
+                const double dt = duration<double>(now - lastReport).count();
+                Log::Info(
+                    "Rendered %u / %u frames (%.1f fps)",
+                    i + 1, nImages, (i + 1 - nReportedFrames) / dt
+                );
+                lastReport = now;
+                nReportedFrames = i + 1;
+            }
+        }
+
+        const double dt = duration<double>(steady_clock::now() - start).count();
+        Log::Info(
+            "Rendered %u frames to %s in %.2f s (%.1f fps)",
+            nImages, settings.outputFolder.string().c_str(), dt, nImages / dt
+        );
+    }
+
+    glm::mat4 headlessViewProjection(const HeadlessSettings& settings) {
+        const float aspectRatio = static_cast<float>(settings.size.x) / settings.size.y;
+        const glm::mat4 projection = glm::perspective(
+            glm::radians(settings.fieldOfView),
+            aspectRatio,
+            0.1f,
+            1000.f
+        );
+        return projection * cameraMatrix();
+    }
+
+    int renderOpenGL(const HeadlessSettings& settings) {
+        HeadlessContext context(settings.size);
+        initScene();
+        const glm::mat4 mvp = headlessViewProjection(settings);
+
+        // The images ahead of the current one are decoded in the background while the
+        // current one is rendered, and the previous frames are encoded in the background
+        // as well, so the three stages overlap across the cores
+        // The headless frames advance at the rate of [Playback], and every object shows
+        // the image that is due at the time of the frame
+        renderFrames(settings, [&](uint32_t frame, std::filesystem::path path) {
+            for (Object& obj : objects) {
+                obj.playback.seekTime(frame / playbackFps);
+                obj.playback.plan(1.0 / playbackFps);
+            }
+            prepareFrame();
+
+            context.beginFrame();
+            glEnable(GL_CULL_FACE);
+            renderList.draw(mvp);
+            glDisable(GL_CULL_FACE);
+            context.save(std::move(path));
+        });
+        context.waitForWrites();
+        cleanup();
+        return EXIT_SUCCESS;
+    }
 
-    deserializeObject(data, pos, lookAtPhi);
-    deserializeObject(data, pos, lookAtTheta);
+    int renderSoftware(const HeadlessSettings& settings) {
+        using Images = std::vector<std::shared_ptr<const DecodedImage>>;
+
+        // Neither the geometry nor the images are uploaded, so there is no OpenGL
+        // context at all. Objects that use the same obj file share the geometry
+        std::map<std::string, std::shared_ptr<const Mesh::Geometry>> objGeometries;
+        std::vector<std::shared_ptr<const Mesh::Geometry>> geometries;
+        std::vector<std::vector<std::filesystem::path>> sequences;
+        std::vector<Playback> playbacks;
+        std::map<std::string, std::shared_ptr<const DecodedImage>> materialImages;
+        for (const Object& obj : objects) {
+            std::shared_ptr<const Mesh::Geometry> geometry;
+            if (obj.type == Object::Type::Model) {
+                std::shared_ptr<const Mesh::Geometry>& g = objGeometries[obj.objFile];
+                if (!g) {
+                    Log::Info("Loading obj file %s", obj.objFile.c_str());
+                    g = std::make_shared<Mesh::Geometry>(
+                        Mesh::loadObjGeometry(obj.objFile)
+                    );
+                }
+                geometry = g;
+            }
+            else {
+                geometry = std::make_shared<Mesh::Geometry>(
+                    Mesh::cylinderGeometry(cylinderRadius, cylinderHeight)
+                );
+            }
+            for (const Mesh::Part& part : geometry->parts) {
+                if (!part.texture.empty() && !materialImages[part.texture]) {
+                    materialImages[part.texture] = ImageCache::decodeFile(part.texture);
+                }
+            }
+            geometries.push_back(std::move(geometry));
+            sequences.push_back(obj.imageIndex.paths());
+            playbacks.push_back(obj.playback);
+        }
+
+        // The images of the upcoming frames are decoded on the background workers while
+        // the rasterizer renders the current frame on its own threads
+        auto decodeFrame = [&sequences, &playbacks](uint32_t frame) {
+            std::vector<uint32_t> images;
+            for (Playback& playback : playbacks) {
+                playback.seekTime(frame / playbackFps);
+                images.push_back(playback.currentImage());
+            }
+            auto job = std::make_shared<std::packaged_task<Images()>>(
+                [sequences, images]() {
+                    Images res;
+                    for (size_t i = 0; i < sequences.size(); ++i) {
+                        const std::vector<std::filesystem::path>& paths = sequences[i];
+                        res.push_back(
+                            images[i] < paths.size() ?
+                                ImageCache::decodeFile(paths[images[i]]) :
+                                nullptr
+                        );
+                    }
+                    return res;
+                }
+            );
+            std::future<Images> res = job->get_future();
+            backgroundWorkers().enqueue([job]() { (*job)(); });
+            return res;
+        };
+        const uint32_t nDecodeAhead = std::max(lookahead, backgroundWorkers().nThreads());
+        std::deque<std::future<Images>> decodes;
+        uint32_t nextDecode = settings.firstImage;
+
+        Rasterizer rasterizer(settings.size);
+        FrameWriter writer;
+        const glm::mat4 viewProjection = headlessViewProjection(settings);
+        // Objects keep showing their last image past the end of their sequence
+        Images current(objects.size());
+        std::vector<Rasterizer::Surface> surfaces;
+        renderFrames(settings, [&](uint32_t, std::filesystem::path path) {
+            while (decodes.size() < nDecodeAhead) {
+                decodes.push_back(decodeFrame(nextDecode++));
+            }
+            Images images = decodes.front().get();
+            decodes.pop_front();
+            for (size_t i = 0; i < objects.size(); ++i) {
+                if (images[i]) {
+                    current[i] = std::move(images[i]);
+                }
+            }
+
+            surfaces.clear();
+            for (size_t i = 0; i < objects.size(); ++i) {
+                const Mesh::Geometry& geometry = *geometries[i];
+                for (const Mesh::Part& part : geometry.parts) {
+                    Rasterizer::Surface surface;
+                    surface.vertices = geometry.vertices.data() + part.first;
+                    surface.nVertices = part.nVertices;
+                    surface.transform = objects[i].transform;
+                    surface.image = part.texture.empty() ?
+                        current[i].get() :
+                        materialImages[part.texture].get();
+                    surfaces.push_back(surface);
+                }
+            }
+            rasterizer.render(surfaces, viewProjection);
+            writer.write(std::move(path), settings.size, rasterizer.pixels());
+        });
+        for (std::future<Images>& decode : decodes) {
+            decode.wait();
+        }
+        writer.waitForWrites();
+        return EXIT_SUCCESS;
+    }
+
+    // Writes every image of the folder as a tiled image with the same name into the
+    // output folder
+    int convertToTiled(const std::filesystem::path& folder,
+                       const std::filesystem::path& output)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(output, ec);
+        if (ec) {
+            Log::Error("Could not create folder %s", output.string().c_str());
+            return EXIT_FAILURE;
+        }
+
+        SequenceIndex index(folder);
+        int nFailed = 0;
+        for (const std::filesystem::path& path : index.paths()) {
+            if (TiledImage::isTiledImage(path)) {
+                continue;
+            }
+            std::shared_ptr<const DecodedImage> image = ImageCache::decodeFile(path);
+            if (!image) {
+                nFailed++;
+                continue;
+            }
+
+            std::filesystem::path tiled = output / path.filename();
+            tiled.replace_extension(".tiles");
+            try {
+                writeTiledImage(tiled, *image, TiledImage::DefaultTileSize);
+                Log::Info("Converted %s", path.string().c_str());
+            }
+            catch (const std::runtime_error& e) {
+                Log::Error("%s", e.what());
+                nFailed++;
+            }
+        }
+        return nFailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+} // namespace
 
-    deserializeObject(data, pos, currentImage);
-    deserializeObject(data, pos, showHelp);
-    deserializeObject(data, pos, showStatistics);
-    deserializeObject(data, pos, useSpoutTextures);
+int renderHeadless(const HeadlessSettings& settings) {
+    // There are no SGCT viewports to test the objects against
+    viewportCulling = false;
+    regionStreaming = false;
+    // Without a cluster, this is the only process that can keep the manifests up to date
+    SequenceIndex::setWritesManifest(true);
+    try {
+        return settings.useSoftwareRenderer ?
+            renderSoftware(settings) :
+            renderOpenGL(settings);
+    }
+    catch (const std::runtime_error& e) {
+        Log::Error("%s", e.what());
+        return EXIT_FAILURE;
+    }
 }
 
 int main(int argc, char** argv) {
@@ -457,6 +1717,14 @@ int main(int argc, char** argv) {
     renderModels = renderModelsStr == "true";
     const std::string renderCylinderStr = misc["RenderCylinder"];
     renderCylinder = renderCylinderStr == "true";
+    const std::string batchedRenderingStr = misc["BatchedRendering"];
+    batchedRendering = batchedRenderingStr == "true";
+    const std::string singlePassRenderingStr = misc["SinglePassRendering"];
+    singlePassRendering = singlePassRenderingStr == "true";
+    const std::string viewportCullingStr = misc["ViewportCulling"];
+    viewportCulling = viewportCullingStr == "true";
+    const std::string regionStreamingStr = misc["RegionStreaming"];
+    regionStreaming = regionStreamingStr == "true";
 
     std::map<std::string, std::string> models = ini["Models"];
 
@@ -484,6 +1752,113 @@ int main(int argc, char** argv) {
     str >> cylinderRadius;
 #endif // WIN32
 
+    const Group& playbackGroup = ini["Playback"];
+    playbackFps = readValue(playbackGroup, "Fps", playbackFps);
+    if (!std::isfinite(playbackFps) || playbackFps <= 0.0) {
+        Log::Warning("Invalid playback rate, using 30 fps instead");
+        playbackFps = 30.0;
+    }
+    lookahead = readValue(playbackGroup, "Lookahead", 8u);
+    const uint16_t readinessPort = readValue<uint16_t>(
+        playbackGroup,
+        "ReadinessPort",
+        27500
+    );
+
+    const Group& ioGroup = ini["IO"];
+    FileReader::Settings ioSettings;
+    ioSettings.queueDepth = readValue(ioGroup, "QueueDepth", ioSettings.queueDepth);
+    ioSettings.maxBytesInFlight = uint64_t(1024 * 1024) * readValue(
+        ioGroup,
+        "MaxMegabytesInFlight",
+        ioSettings.maxBytesInFlight / (1024 * 1024)
+    );
+    FileReader::initialize(ioSettings);
+
+    const Group& thumbnailGroup = ini["Thumbnails"];
+    ThumbnailSettings thumbnailSettings;
+    if (thumbnailGroup.find("Folder") != thumbnailGroup.end()) {
+        thumbnailSettings.folder = thumbnailGroup.at("Folder");
+    }
+    thumbnailSettings.maxBytes = uint64_t(1024 * 1024) * readValue(
+        thumbnailGroup,
+        "MaxMegabytes",
+        thumbnailSettings.maxBytes / (1024 * 1024)
+    );
+    thumbnailSettings.interval = readValue(
+        thumbnailGroup,
+        "Interval",
+        thumbnailSettings.interval
+    );
+    initializeThumbnails(std::move(thumbnailSettings));
+
+    const Group& captureGroup = ini["Capture"];
+    auto captureEnabled = captureGroup.find("Enabled");
+    isCapturing =
+        captureEnabled != captureGroup.end() && captureEnabled->second == "true";
+    if (captureGroup.find("Folder") != captureGroup.end()) {
+        captureSettings.folder = captureGroup.at("Folder");
+    }
+    auto captureFormat = captureGroup.find("Format");
+    if (captureFormat != captureGroup.end() && captureFormat->second == "Raw") {
+        captureSettings.format = FrameCapture::Format::Raw;
+    }
+    captureSettings.nBuffers = readValue(
+        captureGroup,
+        "Buffers",
+        captureSettings.nBuffers
+    );
+    captureSettings.maxBytesInFlight = uint64_t(1024 * 1024) * readValue(
+        captureGroup,
+        "MaxMegabytesInFlight",
+        captureSettings.maxBytesInFlight / (1024 * 1024)
+    );
+
+    const Group& metricsGroup = ini["Metrics"];
+    auto metricsEnabled = metricsGroup.find("Enabled");
+    const bool serveMetrics =
+        metricsEnabled != metricsGroup.end() && metricsEnabled->second == "true";
+    const uint16_t metricsPort = readValue<uint16_t>(metricsGroup, "Port", 27600);
+    auto metricsLocalOnly = metricsGroup.find("LocalOnly");
+    const bool isMetricsLocalOnly =
+        metricsLocalOnly == metricsGroup.end() || metricsLocalOnly->second != "false";
+
+    const Group& distributionGroup = ini["Distribution"];
+    auto distributionEnabled = distributionGroup.find("Enabled");
+    distributeAssets = distributionEnabled != distributionGroup.end() &&
+        distributionEnabled->second == "true";
+    assetServerSettings.port = readValue(
+        distributionGroup,
+        "Port",
+        assetServerSettings.port
+    );
+    assetServerSettings.chunkSize = 1024 * readValue(
+        distributionGroup,
+        "ChunkKilobytes",
+        assetServerSettings.chunkSize / 1024
+    );
+    assetServerSettings.maxCachedBytes = uint64_t(1024 * 1024) * readValue(
+        distributionGroup,
+        "MaxCachedMegabytes",
+        assetServerSettings.maxCachedBytes / (1024 * 1024)
+    );
+    assetClientSettings.port = assetServerSettings.port;
+    if (distributionGroup.find("CacheFolder") != distributionGroup.end()) {
+        assetClientSettings.cacheFolder = distributionGroup.at("CacheFolder");
+    }
+    assetClientSettings.maxCacheBytes = uint64_t(1024 * 1024) * readValue(
+        distributionGroup,
+        "MaxCacheMegabytes",
+        assetClientSettings.maxCacheBytes / (1024 * 1024)
+    );
+
+    const Group& traceGroup = ini["Trace"];
+    auto traceEnabled = traceGroup.find("Enabled");
+    isTracing = traceEnabled != traceGroup.end() && traceEnabled->second == "true";
+    if (traceGroup.find("Folder") != traceGroup.end()) {
+        traceFolder = traceGroup.at("Folder");
+    }
+
     std::map<std::string, std::string> imagePaths = ini["Image"];
     std::map<std::string, std::string> spoutNames = ini["Spout"];
 
@@ -502,6 +1877,8 @@ int main(int argc, char** argv) {
                 std::move(imagePath)
             );
             obj.type = Object::Type::Model;
+            obj.transform = readTransform(ini, p.first);
+            obj.playback = readPlayback(ini, p.first);
             objects.push_back(std::move(obj));
         }
     }
@@ -515,14 +1892,96 @@ int main(int argc, char** argv) {
 
         Object obj("Cylinder", "", std::move(spoutName), std::move(imagePath));
         obj.type = Object::Type::Cylinder;
+        obj.transform = readTransform(ini, "Cylinder");
+        obj.playback = readPlayback(ini, "Cylinder");
         objects.push_back(std::move(obj));
     }
 
 
 
     std::vector<std::string> arg(argv + 1, argv + argc);
+    Trace::instance().setThreadName("Render");
+    auto compareArg = std::find(arg.begin(), arg.end(), "--compare");
+    if (compareArg != arg.end()) {
+        // Compares the benchmark reports of two runs instead of rendering anything
+        if (arg.end() - compareArg < 3) {
+            Log::Error("Usage: --compare <baseline report> <candidate report>");
+            return EXIT_FAILURE;
+        }
+        const double threshold = readValue(ini["Benchmark"], "Threshold", 0.05);
+        try {
+            const std::vector<std::string> regressions = compareReports(
+                loadReport(*(compareArg + 1)),
+                loadReport(*(compareArg + 2)),
+                threshold
+            );
+            if (!regressions.empty()) {
+                Log::Warning("%zu values regressed", regressions.size());
+                return EXIT_FAILURE;
+            }
+            return EXIT_SUCCESS;
+        }
+        catch (const std::runtime_error& e) {
+            Log::Error("%s", e.what());
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto convertArg = std::find(arg.begin(), arg.end(), "--convert-tiled");
+    if (convertArg != arg.end()) {
+        // Converts a folder of images instead of rendering anything
+        if (arg.end() - convertArg < 3) {
+            Log::Error("Usage: --convert-tiled <image folder> <output folder>");
+            return EXIT_FAILURE;
+        }
+        return convertToTiled(*(convertArg + 1), *(convertArg + 2));
+    }
+
+    const Group& benchmarkGroup = ini["Benchmark"];
+    if (benchmarkGroup.find("Output") != benchmarkGroup.end()) {
+        benchmarkOutput = benchmarkGroup.at("Output");
+    }
+    nBenchmarkFrames = readValue(benchmarkGroup, "Frames", nBenchmarkFrames);
+    const uint32_t nWarmupFrames = readValue(benchmarkGroup, "WarmupFrames", 30u);
+    const std::optional<std::string> recordPath = takeArgument(arg, "--record");
+    const std::optional<std::string> replayPath = takeArgument(arg, "--replay");
+
+    auto traceArg = std::find(arg.begin(), arg.end(), "--trace");
+    if (traceArg != arg.end()) {
+        // Traces the whole run and saves it when the application exits
+        isTracing = true;
+        saveTraceOnExit = true;
+        arg.erase(traceArg);
+    }
+    Trace::instance().setEnabled(isTracing);
+
+    auto headlessArg = std::find(arg.begin(), arg.end(), "--headless");
+    if (headlessArg != arg.end()) {
+        const Group& headlessGroup = ini["Headless"];
+        HeadlessSettings settings;
+        settings.size.x = readValue(headlessGroup, "Width", settings.size.x);
+        settings.size.y = readValue(headlessGroup, "Height", settings.size.y);
+        settings.fieldOfView = readValue(
+            headlessGroup,
+            "FieldOfView",
+            settings.fieldOfView
+        );
+        if (headlessGroup.find("Output") != headlessGroup.end()) {
+            settings.outputFolder = headlessGroup.at("Output");
+        }
+        settings.firstImage = readValue(headlessGroup, "FirstImage", settings.firstImage);
+        settings.nImages = readValue(headlessGroup, "Count", settings.nImages);
+        auto renderer = headlessGroup.find("Renderer");
+        settings.useSoftwareRenderer =
+            renderer != headlessGroup.end() && renderer->second == "Software";
+        lookAtPhi = glm::radians(readValue(headlessGroup, "LookAtPhi", 0.0));
+        lookAtTheta = glm::radians(readValue(headlessGroup, "LookAtTheta", 0.0));
+        return renderHeadless(settings);
+    }
+
     Configuration config = parseArguments(arg);
     config::Cluster cluster = loadCluster(config.configFilename);
+    assetClientSettings.masterAddress = cluster.masterAddress;
 
     Engine::Callbacks callbacks;
     callbacks.initOpenGL = initGL;
@@ -532,6 +1991,7 @@ int main(int argc, char** argv) {
     callbacks.postSyncPreDraw = postSyncPreDraw;
     callbacks.draw = draw;
     callbacks.draw2D = draw2D;
+    callbacks.postDraw = postDraw;
     callbacks.cleanup = cleanup;
     callbacks.keyboard = keyboard;
     callbacks.mousePos = mousePos;
@@ -546,6 +2006,60 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
+    // The client nodes tell the master which images they have ready so that the master
+    // only advances to images that can be shown everywhere without stalling
+    const int nNodes = ClusterManager::instance().numberOfNodes();
+    if (nNodes > 1) {
+        try {
+            if (Engine::instance().isMaster()) {
+                readinessCollector = std::make_unique<ReadinessCollector>(
+                    readinessPort,
+                    nNodes - 1
+                );
+            }
+            else {
+                readinessReporter = std::make_unique<ReadinessReporter>(
+                    cluster.masterAddress,
+                    readinessPort,
+                    ClusterManager::instance().thisNodeId()
+                );
+            }
+        }
+        catch (const std::runtime_error& e) {
+            Log::Error("Readiness reporting disabled: %s", e.what());
+        }
+    }
+
+    if (Engine::instance().isMaster()) {
+        try {
+            if (recordPath.has_value()) {
+                stateRecorder = std::make_unique<StateRecorder>(*recordPath);
+            }
+            if (replayPath.has_value()) {
+                stateReplay = std::make_unique<StateReplay>(*replayPath);
+                benchmarkStats = std::make_unique<BenchmarkStats>(nWarmupFrames);
+            }
+        }
+        catch (const std::runtime_error& e) {
+            Log::Error("%s", e.what());
+            Engine::destroy();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (serveMetrics) {
+        // Every node gets its own port so that multiple nodes can run on one machine
+        const int nodeId = ClusterManager::instance().thisNodeId();
+        const uint16_t port = static_cast<uint16_t>(metricsPort + nodeId);
+        try {
+            metricsServer = std::make_unique<MetricsServer>(port, isMetricsLocalOnly);
+            Log::Info("Serving metrics on port %u", port);
+        }
+        catch (const std::runtime_error& e) {
+            Log::Error("Metrics disabled: %s", e.what());
+        }
+    }
+
     Engine::instance().render();
     Engine::destroy();
     exit(EXIT_SUCCESS);
@@ -0,0 +1,428 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "mesh.h"
+
+#include "assetcache.h"
+#include "objloader.h"
+#include "workerpool.h"
+#include <sgct/log.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <map>
+#include <optional>
+
+namespace {
+    // The meshes of all obj files that are in use, indexed by their absolute path
+    std::map<std::string, std::weak_ptr<Mesh>> objMeshes;
+
+    Mesh::Geometry loadObj(const std::string& filename, bool printCornerVertices) {
+        // On the nodes, the master parses the obj file so that it is only read once
+        std::optional<Mesh::Geometry> fetched = AssetClient::fetchGeometry(filename);
+        Mesh::Geometry res = fetched.has_value() ?
+            std::move(*fetched) :
+            Mesh::geometryFromModel(obj::loadObjFile(filename));
+        if (printCornerVertices) {
+            const CornerVertices c = findCornerVertices(res.vertices);
+            if (c.isComplete) {
+                sgct::Log::Info("Vertex locations for %s", filename.c_str());
+                sgct::Log::Info(
+                    "LL (u=%f, v=%f): %f %f %f", c.ll.u, c.ll.v, c.ll.x, c.ll.y, c.ll.z
+                );
+                sgct::Log::Info(
+                    "UL (u=%f, v=%f): %f %f %f", c.ul.u, c.ul.v, c.ul.x, c.ul.y, c.ul.z
+                );
+                sgct::Log::Info(
+                    "LR (u=%f, v=%f): %f %f %f", c.lr.u, c.lr.v, c.lr.x, c.lr.y, c.lr.z
+                );
+                sgct::Log::Info(
+                    "UR (u=%f, v=%f): %f %f %f", c.ur.u, c.ur.v, c.ur.x, c.ur.y, c.ur.z
+                );
+            }
+            else {
+                sgct::Log::Error("Error finding corner vertices of %s", filename.c_str());
+            }
+        }
+        return res;
+    }
+
+    Mesh::Geometry cylinder(float r, float h) {
+        constexpr const int Sections = 128;
+
+        float sectorStep = glm::two_pi<float>() / (Sections - 1);
+
+        std::vector<Vertex> vertices;
+        for (int i = 0; i < Sections - 1; ++i) {
+            float angle0 = i * sectorStep;
+            float angle1 = (i + 1) * sectorStep;
+
+            const float x0 = cos(angle0) * r;
+            const float y0 = 0.f;
+            const float z0 = sin(angle0) * r;
+
+            const float x1 = cos(angle1) * r;
+            const float y1 = h;
+            const float z1 = sin(angle1) * r;
+
+
+            // Lower left
+            Vertex ll;
+            ll.x = x0;
+            ll.y = y0;
+            ll.z = z0;
+            ll.nx = -x0;
+            ll.ny = -y0;
+            ll.nz = -z0;
+            ll.u = static_cast<float>(i) / static_cast<float>(Sections - 1);
+            ll.v = 0.f;
+
+            // Upper right
+            Vertex ur;
+            ur.x = x1;
+            ur.y = y1;
+            ur.z = z1;
+            ur.nx = -x1;
+            ur.ny = -y1;
+            ur.nz = -z1;
+            ur.u = static_cast<float>(i + 1) / static_cast<float>(Sections - 1);
+            ur.v = 1.f;
+
+            // Upper left
+            Vertex ul;
+            ul.x = x0;
+            ul.y = y1;
+            ul.z = z0;
+            ul.nx = -x0;
+            ul.ny = -y1;
+            ul.nz = -z0;
+            ul.u = static_cast<float>(i) / static_cast<float>(Sections - 1);
+            ul.v = 1.f;
+
+            // Lower right
+            Vertex lr;
+            lr.x = x1;
+            lr.y = y0;
+            lr.z = z1;
+            lr.nx = -x1;
+            lr.ny = -y0;
+            lr.nz = -z1;
+            lr.u = static_cast<float>(i + 1) / static_cast<float>(Sections - 1);
+            lr.v = 0.f;
+
+            vertices.push_back(ll);
+            vertices.push_back(ur);
+            vertices.push_back(ul);
+
+            vertices.push_back(ll);
+            vertices.push_back(lr);
+            vertices.push_back(ur);
+        }
+
+        Mesh::Geometry res;
+        res.parts.resize(1);
+        res.parts[0].nVertices = static_cast<uint32_t>(vertices.size());
+        res.vertices = std::move(vertices);
+        return res;
+    }
+} // namespace
+
+CornerVertices findCornerVertices(const std::vector<Vertex>& vertices) {
+    CornerVertices res;
+    res.ll.u = std::numeric_limits<float>::max();
+    res.ll.v = std::numeric_limits<float>::max();
+    res.ul.u = std::numeric_limits<float>::max();
+    res.ul.v = -std::numeric_limits<float>::max();
+    res.lr.u = -std::numeric_limits<float>::max();
+    res.lr.v = std::numeric_limits<float>::max();
+    res.ur.u = -std::numeric_limits<float>::max();
+    res.ur.v = -std::numeric_limits<float>::max();
+
+    bool foundLL = false;
+    bool foundUL = false;
+    bool foundLR = false;
+    bool foundUR = false;
+    for (const Vertex& vertex : vertices) {
+        if (vertex.u < res.ll.u && vertex.v < res.ll.v) {
+            res.ll = vertex;
+            foundLL = true;
+        }
+        if (vertex.u < res.ul.u && vertex.v > res.ul.v) {
+            res.ul = vertex;
+            foundUL = true;
+        }
+        if (vertex.u > res.lr.u && vertex.v < res.lr.v) {
+            res.lr = vertex;
+            foundLR = true;
+        }
+        if (vertex.u > res.ur.u && vertex.v > res.ur.v) {
+            res.ur = vertex;
+            foundUR = true;
+        }
+    }
+    res.isComplete = foundLL && foundUL && foundLR && foundUR;
+    return res;
+}
+
+Bounds computeBounds(const std::vector<Vertex>& vertices) {
+    Bounds res;
+    for (const Vertex& v : vertices) {
+        res.min = glm::min(res.min, glm::vec3(v.x, v.y, v.z));
+        res.max = glm::max(res.max, glm::vec3(v.x, v.y, v.z));
+    }
+    return res;
+}
+
+void setVertexAttributes() {
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(
+        0,
+        3,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(Vertex),
+        nullptr
+    );
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(
+        1,
+        3,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(Vertex),
+        reinterpret_cast<void*>(3 * sizeof(float))
+    );
+
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(
+        2,
+        2,
+        GL_FLOAT,
+        GL_FALSE,
+        sizeof(Vertex),
+        reinterpret_cast<void*>(6 * sizeof(float))
+    );
+}
+
+std::shared_ptr<Mesh> Mesh::fromObjFile(const std::string& objFile,
+                                        bool printCornerVertices)
+{
+    const std::string key =
+        std::filesystem::absolute(objFile).lexically_normal().string();
+    auto it = objMeshes.find(key);
+    if (it != objMeshes.end()) {
+        if (std::shared_ptr<Mesh> mesh = it->second.lock(); mesh) {
+            sgct::Log::Info("Reusing obj file %s", objFile.c_str());
+            return mesh;
+        }
+    }
+
+    sgct::Log::Info("Loading obj file %s", objFile.c_str());
+    std::shared_ptr<Mesh> mesh = std::shared_ptr<Mesh>(
+        new Mesh(objFile, loadObj(objFile, printCornerVertices))
+    );
+    objMeshes[key] = mesh;
+    return mesh;
+}
+
+std::shared_ptr<Mesh> Mesh::fromCylinder(float radius, float height) {
+    sgct::Log::Info("Loading cylinder");
+    return std::shared_ptr<Mesh>(new Mesh("", cylinder(radius, height)));
+}
+
+Mesh::Geometry Mesh::geometryFromModel(const obj::Model& model) {
+    // Grouping the faces by material gives every material a single contiguous range
+    // of vertices, so that each material only needs a single draw call
+    std::vector<const obj::Face*> faces;
+    faces.reserve(model.faces.size());
+    for (const obj::Face& face : model.faces) {
+        faces.push_back(&face);
+    }
+    std::stable_sort(
+        faces.begin(),
+        faces.end(),
+        [](const obj::Face* lhs, const obj::Face* rhs) {
+            return lhs->material < rhs->material;
+        }
+    );
+
+    std::vector<Vertex> vertices;
+    std::vector<Part> parts;
+
+    uint32_t currentMaterial = std::numeric_limits<uint32_t>::max();
+    for (const obj::Face* f : faces) {
+        const obj::Face& face = *f;
+        if (face.material != currentMaterial) {
+            currentMaterial = face.material;
+            const obj::Material& material = model.materials[face.material];
+            Part part;
+            part.material = material.name;
+            part.texture = material.diffuseMap;
+            part.first = static_cast<uint32_t>(vertices.size());
+            parts.push_back(std::move(part));
+        }
+
+        auto makeVertex = [&model](obj::Face::Indices indices) -> Vertex {
+            Vertex res;
+
+            res.x = model.positions[indices.vertex].x;
+            res.y = model.positions[indices.vertex].y;
+            res.z = model.positions[indices.vertex].z;
+
+            if (indices.normal.has_value()) {
+                res.nx = model.normals[*indices.normal].nx;
+                res.ny = model.normals[*indices.normal].ny;
+                res.nz = model.normals[*indices.normal].nz;
+            }
+
+            if (indices.uv.has_value()) {
+                res.u = model.uvs[*indices.uv].u;
+                res.v = model.uvs[*indices.uv].v;
+            }
+
+            return res;
+        };
+
+
+        vertices.push_back(makeVertex(face.i0));
+        vertices.push_back(makeVertex(face.i1));
+        vertices.push_back(makeVertex(face.i2));
+
+        if (face.i3.has_value()) {
+            vertices.push_back(makeVertex(face.i0));
+            vertices.push_back(makeVertex(face.i2));
+            vertices.push_back(makeVertex(*face.i3));
+        }
+        parts.back().nVertices =
+            static_cast<uint32_t>(vertices.size()) - parts.back().first;
+    }
+
+    Geometry res;
+    res.vertices = std::move(vertices);
+    res.parts = std::move(parts);
+    return res;
+}
+
+Mesh::Geometry Mesh::loadObjGeometry(const std::string& objFile) {
+    return loadObj(objFile, false);
+}
+
+Mesh::Geometry Mesh::cylinderGeometry(float radius, float height) {
+    return cylinder(radius, height);
+}
+
+Mesh::Mesh(std::string objFile_, Geometry geometry)
+    : objFile(std::move(objFile_))
+    , nVertices(static_cast<uint32_t>(geometry.vertices.size()))
+    , bounds(computeBounds(geometry.vertices))
+    , parts(std::move(geometry.parts))
+    , vertices(std::move(geometry.vertices))
+{
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        sizeof(Vertex) * vertices.size(),
+        vertices.data(),
+        GL_STATIC_DRAW
+    );
+    setVertexAttributes();
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+Mesh::~Mesh() {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vbo);
+}
+
+void Mesh::reload() {
+    if (objFile.empty() || _reload.valid()) {
+        return;
+    }
+
+    sgct::Log::Info("Reloading obj file %s", objFile.c_str());
+    _reloadStartTime = std::chrono::steady_clock::now();
+    AssetClient::invalidate(objFile);
+
+    auto job = std::make_shared<std::packaged_task<Geometry()>>(
+        [file = objFile]() { return loadObj(file, false); }
+    );
+    _reload = job->get_future();
+    backgroundWorkers().enqueue([job]() { (*job)(); });
+}
+
+bool Mesh::hasPendingReload() const {
+    return _reload.valid() &&
+        _reload.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+bool Mesh::hasPreparedReload() const {
+    return _reload.valid() &&
+        _reload.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void Mesh::applyReload() {
+    if (!hasPreparedReload()) {
+        return;
+    }
+
+    try {
+        Geometry geometry = _reload.get();
+        vertices = std::move(geometry.vertices);
+
+        // The vertex array keeps pointing at the same buffer, so only the contents of the
+        // buffer have to be replaced
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(
+            GL_ARRAY_BUFFER,
+            sizeof(Vertex) * vertices.size(),
+            vertices.data(),
+            GL_STATIC_DRAW
+        );
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        nVertices = static_cast<uint32_t>(vertices.size());
+        bounds = computeBounds(vertices);
+        parts = std::move(geometry.parts);
+
+        using namespace std::chrono;
+        const duration<double, std::milli> dt = steady_clock::now() - _reloadStartTime;
+        sgct::Log::Info("Reloaded obj file %s in %.1f ms", objFile.c_str(), dt.count());
+    }
+    catch (const std::runtime_error& e) {
+        sgct::Log::Error("Error reloading obj file %s: %s", objFile.c_str(), e.what());
+    }
+}
@@ -0,0 +1,147 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __MESH_H__
+#define __MESH_H__
+
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace obj { struct Model; }
+
+struct Vertex {
+    float x = 0.f;
+    float y = 0.f;
+    float z = 0.f;
+
+    float nx = 0.f;
+    float ny = 0.f;
+    float nz = 1.f;
+
+    float u = 0.f;
+    float v = 0.f;
+};
+
+// The vertices with the smallest and largest texture coordinates, which are the corners
+// of the image on the surface and are printed to help with aligning the projectors
+struct CornerVertices {
+    Vertex ll;
+    Vertex ul;
+    Vertex lr;
+    Vertex ur;
+    // False if the texture coordinates do not span a rectangle with four distinct corners
+    bool isComplete = false;
+};
+
+CornerVertices findCornerVertices(const std::vector<Vertex>& vertices);
+
+// The axis-aligned box around the positions of a mesh, which is empty if min > max
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+};
+
+Bounds computeBounds(const std::vector<Vertex>& vertices);
+
+// Describes the layout of Vertex in the buffer bound to GL_ARRAY_BUFFER to the currently
+// bound vertex array object, using the attribute locations 0 to 2
+void setVertexAttributes();
+
+// The geometry of an obj file or of the cylinder on the GPU. The meshes of obj files are
+// shared between all objects that use the same file, so every file is only parsed and
+// uploaded once regardless of how often it is placed in the scene
+class Mesh {
+public:
+    // Returns the mesh of the obj file, which is only loaded if no other object is using
+    // it already. Has to be called from the rendering thread
+    static std::shared_ptr<Mesh> fromObjFile(const std::string& objFile,
+        bool printCornerVertices);
+    static std::shared_ptr<Mesh> fromCylinder(float radius, float height);
+
+    // A range of vertices that share the same material
+    struct Part {
+        std::string material;
+        // The diffuse texture of the material. If it is empty, the part shows the images
+        // of the object instead
+        std::string texture;
+        uint32_t first = 0;
+        uint32_t nVertices = 0;
+    };
+
+    struct Geometry {
+        std::vector<Vertex> vertices;
+        std::vector<Part> parts;
+    };
+
+    // Load the geometry on the calling thread without creating any OpenGL objects, for
+    // rendering without a GPU
+    static Geometry loadObjGeometry(const std::string& objFile);
+    // Turns the indexed faces of the model into a vertex list that is sorted by material
+    static Geometry geometryFromModel(const obj::Model& model);
+    static Geometry cylinderGeometry(float radius, float height);
+
+    ~Mesh();
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Parses the obj file again in the background after it has been changed on disk.
+    // The new geometry is only used once applyReload is called
+    void reload();
+    bool hasPendingReload() const;
+    bool hasPreparedReload() const;
+    void applyReload();
+
+    // Is empty for the cylinder
+    const std::string objFile;
+
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    uint32_t nVertices = 0;
+    Bounds bounds;
+    // The vertices are sorted by material, so there is exactly one part per material
+    std::vector<Part> parts;
+    // A copy of the vertex buffer, which is used to find the part of the images that is
+    // visible
+    std::vector<Vertex> vertices;
+
+private:
+    Mesh(std::string objFile, Geometry geometry);
+
+    std::future<Geometry> _reload;
+    std::chrono::steady_clock::time_point _reloadStartTime;
+};
+
+#endif // __MESH_H__
@@ -0,0 +1,301 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+    // Clients that take longer to send their request or to receive the response are
+    // disconnected, so that they can't pile up
+    constexpr const std::chrono::seconds ClientTimeout = std::chrono::seconds(5);
+
+    // Requests are only read up to the end of the header, which is all that we need
+    constexpr const size_t MaxRequestSize = 8 * 1024;
+
+    constexpr const char* MetricPrefix = "objrenderer_";
+
+    std::string withLabels(const std::string& labels, const std::string& extra = "") {
+        if (labels.empty() && extra.empty()) {
+            return "";
+        }
+        const char* sep = !labels.empty() && !extra.empty() ? "," : "";
+        return "{" + labels + sep + extra + "}";
+    }
+
+    std::string formatNumber(double value) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.9g", value);
+        return buf;
+    }
+} // namespace
+
+void Counter::add(uint64_t n) {
+    _value.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const {
+    return _value.load(std::memory_order_relaxed);
+}
+
+void Gauge::set(int64_t value) {
+    _value.store(value, std::memory_order_relaxed);
+}
+
+void Gauge::add(int64_t n) {
+    _value.fetch_add(n, std::memory_order_relaxed);
+}
+
+int64_t Gauge::value() const {
+    return _value.load(std::memory_order_relaxed);
+}
+
+Histogram::Histogram(std::vector<double> bounds)
+    : _bounds(std::move(bounds))
+    , _counts(std::make_unique<std::atomic<uint64_t>[]>(_bounds.size() + 1))
+{
+    for (size_t i = 0; i <= _bounds.size(); ++i) {
+        _counts[i] = 0;
+    }
+}
+
+void Histogram::observe(double value) {
+    const size_t bucket =
+        std::lower_bound(_bounds.begin(), _bounds.end(), value) - _bounds.begin();
+    _counts[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    double sum = _sum.load(std::memory_order_relaxed);
+    while (!_sum.compare_exchange_weak(sum, sum + value, std::memory_order_relaxed)) {}
+}
+
+const std::vector<double>& Histogram::bounds() const {
+    return _bounds;
+}
+
+uint64_t Histogram::count() const {
+    uint64_t res = 0;
+    for (size_t i = 0; i <= _bounds.size(); ++i) {
+        res += _counts[i].load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+std::vector<uint64_t> Histogram::bucketCounts() const {
+    std::vector<uint64_t> res(_bounds.size() + 1);
+    for (size_t i = 0; i < res.size(); ++i) {
+        res[i] = _counts[i].load(std::memory_order_relaxed);
+    }
+    return res;
+}
+
+double Histogram::sum() const {
+    return _sum.load(std::memory_order_relaxed);
+}
+
+std::string metricLabel(const std::string& name, const std::string& value) {
+    std::string res = name + "=\"";
+    for (char c : value) {
+        switch (c) {
+            case '\\':
+                res += "\\\\";
+                break;
+            case '"':
+                res += "\\\"";
+                break;
+            case '\n':
+                res += "\\n";
+                break;
+            default:
+                res += c;
+        }
+    }
+    return res + "\"";
+}
+
+Metrics& Metrics::instance() {
+    static Metrics Instance;
+    return Instance;
+}
+
+Counter& Metrics::counter(const std::string& name, const std::string& help,
+                          const std::string& labels)
+{
+    std::lock_guard lock(_mutex);
+    std::unique_ptr<Counter>& c = family(name, help, "counter").counters[labels];
+    if (!c) {
+        c = std::make_unique<Counter>();
+    }
+    return *c;
+}
+
+Gauge& Metrics::gauge(const std::string& name, const std::string& help,
+                      const std::string& labels)
+{
+    std::lock_guard lock(_mutex);
+    std::unique_ptr<Gauge>& g = family(name, help, "gauge").gauges[labels];
+    if (!g) {
+        g = std::make_unique<Gauge>();
+    }
+    return *g;
+}
+
+Histogram& Metrics::histogram(const std::string& name, const std::string& help,
+                              std::vector<double> bounds, const std::string& labels)
+{
+    std::lock_guard lock(_mutex);
+    std::unique_ptr<Histogram>& h = family(name, help, "histogram").histograms[labels];
+    if (!h) {
+        h = std::make_unique<Histogram>(std::move(bounds));
+    }
+    return *h;
+}
+
+const Counter* Metrics::findCounter(const std::string& name,
+                                    const std::string& labels) const
+{
+    std::lock_guard lock(_mutex);
+    auto f = _families.find(name);
+    if (f == _families.end()) {
+        return nullptr;
+    }
+    auto it = f->second.counters.find(labels);
+    return it != f->second.counters.end() ? it->second.get() : nullptr;
+}
+
+const Histogram* Metrics::findHistogram(const std::string& name,
+                                        const std::string& labels) const
+{
+    std::lock_guard lock(_mutex);
+    auto f = _families.find(name);
+    if (f == _families.end()) {
+        return nullptr;
+    }
+    auto it = f->second.histograms.find(labels);
+    return it != f->second.histograms.end() ? it->second.get() : nullptr;
+}
+
+std::string Metrics::format() const {
+    std::lock_guard lock(_mutex);
+    std::string res;
+    for (const std::pair<const std::string, Family>& p : _families) {
+        const std::string name = MetricPrefix + p.first;
+        const Family& f = p.second;
+        res += "# HELP " + name + " " + f.help + "\n";
+        res += "# TYPE " + name + " " + f.type + "\n";
+
+        for (const auto& [labels, c] : f.counters) {
+            res += name + withLabels(labels) + " " + std::to_string(c->value()) + "\n";
+        }
+        for (const auto& [labels, g] : f.gauges) {
+            res += name + withLabels(labels) + " " + std::to_string(g->value()) + "\n";
+        }
+        for (const auto& [labels, h] : f.histograms) {
+            // The buckets of the exposition format are cumulative
+            const std::vector<uint64_t> counts = h->bucketCounts();
+            uint64_t count = 0;
+            for (size_t i = 0; i < counts.size(); ++i) {
+                count += counts[i];
+                const std::string le = i < h->bounds().size() ?
+                    formatNumber(h->bounds()[i]) :
+                    "+Inf";
+                res += name + "_bucket" + withLabels(labels, "le=\"" + le + "\"") + " " +
+                    std::to_string(count) + "\n";
+            }
+            res += name + "_sum" + withLabels(labels) + " " + formatNumber(h->sum()) +
+                "\n";
+            res += name + "_count" + withLabels(labels) + " " + std::to_string(count) +
+                "\n";
+        }
+    }
+    return res;
+}
+
+Metrics::Family& Metrics::family(const std::string& name, const std::string& help,
+                                 const char* type)
+{
+    Family& f = _families[name];
+    if (f.type.empty()) {
+        f.help = help;
+        f.type = type;
+    }
+    return f;
+}
+
+MetricsServer::MetricsServer(uint16_t port, bool localOnly)
+    : _listener(port, localOnly)
+{}
+
+void MetricsServer::update() {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    while (std::optional<TcpConnection> c = _listener.accept()) {
+        _clients.push_back({ std::move(*c), "", "", 0, now });
+    }
+
+    for (Client& client : _clients) {
+        if (client.response.empty()) {
+            char buffer[1024];
+            while (size_t n = client.connection.receive(buffer, sizeof(buffer))) {
+                client.request.append(buffer, n);
+            }
+            const bool isComplete = client.request.find("\r\n\r\n") != std::string::npos;
+            if (!isComplete && client.request.size() < MaxRequestSize) {
+                continue;
+            }
+
+            // Every request is answered with the metrics, regardless of its path
+            const std::string body = Metrics::instance().format();
+            client.response =
+                "HTTP/1.0 200 OK\r\n"
+                "Content-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                "Connection: close\r\n\r\n" + body;
+        }
+
+        client.nSentBytes += client.connection.send(
+            client.response.data() + client.nSentBytes,
+            client.response.size() - client.nSentBytes
+        );
+    }
+
+    _clients.erase(
+        std::remove_if(
+            _clients.begin(),
+            _clients.end(),
+            [now](const Client& client) {
+                const bool isDone = !client.response.empty() &&
+                    client.nSentBytes == client.response.size();
+                return isDone || !client.connection.isOpen() ||
+                    now - client.connectTime > ClientTimeout;
+            }
+        ),
+        _clients.end()
+    );
+}
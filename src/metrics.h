@@ -0,0 +1,151 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include "socket.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// A value that only ever increases, such as the number of decoded images
+class Counter {
+public:
+    void add(uint64_t n = 1);
+    uint64_t value() const;
+
+private:
+    std::atomic<uint64_t> _value = 0;
+};
+
+// A value that can go up and down, such as the number of bytes in textures
+class Gauge {
+public:
+    void set(int64_t value);
+    void add(int64_t n);
+    int64_t value() const;
+
+private:
+    std::atomic<int64_t> _value = 0;
+};
+
+// Counts the observed values in buckets with fixed upper bounds
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    void observe(double value);
+
+    const std::vector<double>& bounds() const;
+    uint64_t count() const;
+    // The number of values that fell into each bucket, the last one has no upper bound
+    std::vector<uint64_t> bucketCounts() const;
+    double sum() const;
+
+private:
+    const std::vector<double> _bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> _counts;
+    std::atomic<double> _sum = 0.0;
+};
+
+// Returns the label in the exposition format, e.g. object="Cylinder". Backslashes,
+// quotes, and line breaks in the value are escaped, so any value can be used
+std::string metricLabel(const std::string& name, const std::string& value);
+
+// Holds all metrics of the application. Metrics are created on their first lookup and
+// are never removed, so the returned references stay valid and the call sites look them
+// up only once. Updating a metric is a single atomic operation without any lock, which
+// keeps the collection overhead negligible compared to the frame time
+class Metrics {
+public:
+    static Metrics& instance();
+
+    // The labels are written in the exposition format, as returned by metricLabel
+    Counter& counter(const std::string& name, const std::string& help,
+        const std::string& labels = "");
+    Gauge& gauge(const std::string& name, const std::string& help,
+        const std::string& labels = "");
+    Histogram& histogram(const std::string& name, const std::string& help,
+        std::vector<double> bounds, const std::string& labels = "");
+
+    // Returns the metric if it has been created, without creating it
+    const Counter* findCounter(const std::string& name,
+        const std::string& labels = "") const;
+    const Histogram* findHistogram(const std::string& name,
+        const std::string& labels = "") const;
+
+    // Returns all metrics in the Prometheus text exposition format
+    std::string format() const;
+
+private:
+    struct Family {
+        std::string help;
+        std::string type;
+        std::map<std::string, std::unique_ptr<Counter>> counters;
+        std::map<std::string, std::unique_ptr<Gauge>> gauges;
+        std::map<std::string, std::unique_ptr<Histogram>> histograms;
+    };
+
+    Family& family(const std::string& name, const std::string& help, const char* type);
+
+    mutable std::mutex _mutex;
+    std::map<std::string, Family> _families;
+};
+
+// Serves the metrics over HTTP so that they can be scraped by Prometheus. The server is
+// polled from the render loop instead of running on its own thread
+class MetricsServer {
+public:
+    // Only clients on the same machine can connect if localOnly is true
+    MetricsServer(uint16_t port, bool localOnly);
+
+    // Accepts new connections and answers the requests that have arrived completely
+    void update();
+
+private:
+    struct Client {
+        TcpConnection connection;
+        std::string request;
+        std::string response;
+        size_t nSentBytes = 0;
+        std::chrono::steady_clock::time_point connectTime;
+    };
+
+    TcpListener _listener;
+    std::vector<Client> _clients;
+};
+
+#endif // __METRICS_H__
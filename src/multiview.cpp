@@ -0,0 +1,255 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "multiview.h"
+
+#include "renderlist.h"
+#include <sgct/sgct.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    bool hasExtension(const char* name) {
+        GLint nExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &nExtensions);
+        for (GLint i = 0; i < nExtensions; ++i) {
+            const GLubyte* ext = glGetStringi(GL_EXTENSIONS, i);
+            if (ext && std::strcmp(reinterpret_cast<const char*>(ext), name) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int numberOfEyes(const sgct::Window& window) {
+        return window.isStereo() ? 2 : 1;
+    }
+} // namespace
+
+bool MultiViewTarget::isSupported() {
+    // Viewport arrays are part of OpenGL 4.1
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    const bool hasViewportArrays = major > 4 || (major == 4 && minor >= 1);
+    return hasViewportArrays && hasExtension("GL_ARB_shader_viewport_layer_array");
+}
+
+bool MultiViewTarget::canDraw(const sgct::RenderData& data) const {
+    const std::vector<std::unique_ptr<sgct::Viewport>>& vps = data.window.viewports();
+    for (const std::unique_ptr<sgct::Viewport>& vp : vps) {
+        if (vp->hasSubViewports()) {
+            // Non-linear projections render cube maps with their own sub-viewports
+            return false;
+        }
+    }
+    if (static_cast<int>(vps.size()) * numberOfEyes(data.window) > RenderList::MaxViews) {
+        return false;
+    }
+
+    // Blitting into a multisampled framebuffer is not allowed
+    GLint nSamples = 0;
+    glGetIntegerv(GL_SAMPLES, &nSamples);
+    return nSamples == 0 && viewIndex(data) >= 0;
+}
+
+void MultiViewTarget::draw(const sgct::RenderData& data, const glm::mat4& camera,
+                           RenderList& list)
+{
+    const unsigned int frameNumber = sgct::Engine::instance().currentFrameNumber();
+    if (!_hasRendered || frameNumber != _frameNumber || data.window.id() != _windowId) {
+        renderViews(data, camera, list);
+        _hasRendered = true;
+        _frameNumber = frameNumber;
+        _windowId = data.window.id();
+    }
+
+    const int view = viewIndex(data);
+    const int nViewports = static_cast<int>(data.window.viewports().size());
+    const glm::ivec2 size = viewSize(data, view % nViewports);
+
+    // SGCT has already set the viewport for this view in its framebuffer
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint readFramebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFramebuffer);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, _readFramebuffer);
+    glFramebufferTextureLayer(
+        GL_READ_FRAMEBUFFER,
+        GL_COLOR_ATTACHMENT0,
+        _colorTexture,
+        0,
+        view
+    );
+    glBlitFramebuffer(
+        0,
+        0,
+        size.x,
+        size.y,
+        viewport[0],
+        viewport[1],
+        viewport[0] + viewport[2],
+        viewport[1] + viewport[3],
+        GL_COLOR_BUFFER_BIT,
+        GL_LINEAR
+    );
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+}
+
+void MultiViewTarget::deinitialize() {
+    glDeleteFramebuffers(1, &_framebuffer);
+    glDeleteFramebuffers(1, &_readFramebuffer);
+    glDeleteTextures(1, &_colorTexture);
+    glDeleteTextures(1, &_depthTexture);
+    _framebuffer = 0;
+    _readFramebuffer = 0;
+    _colorTexture = 0;
+    _depthTexture = 0;
+    _size = glm::ivec2(0);
+    _nLayers = 0;
+    _hasRendered = false;
+}
+
+void MultiViewTarget::renderViews(const sgct::RenderData& data, const glm::mat4& camera,
+                                  RenderList& list)
+{
+    const std::vector<std::unique_ptr<sgct::Viewport>>& vps = data.window.viewports();
+    const int nViewports = static_cast<int>(vps.size());
+    const int nEyes = numberOfEyes(data.window);
+    const int nLayers = nViewports * nEyes;
+
+    glm::ivec2 size = glm::ivec2(1);
+    for (int i = 0; i < nViewports; ++i) {
+        size = glm::max(size, viewSize(data, i));
+    }
+
+    if (size != _size || nLayers != _nLayers) {
+        deinitialize();
+        _size = size;
+        _nLayers = nLayers;
+
+        glGenTextures(1, &_colorTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _colorTexture);
+        glTexImage3D(
+            GL_TEXTURE_2D_ARRAY,
+            0,
+            GL_RGBA8,
+            _size.x,
+            _size.y,
+            _nLayers,
+            0,
+            GL_RGBA,
+            GL_UNSIGNED_BYTE,
+            nullptr
+        );
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        glGenTextures(1, &_depthTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _depthTexture);
+        glTexImage3D(
+            GL_TEXTURE_2D_ARRAY,
+            0,
+            GL_DEPTH_COMPONENT24,
+            _size.x,
+            _size.y,
+            _nLayers,
+            0,
+            GL_DEPTH_COMPONENT,
+            GL_FLOAT,
+            nullptr
+        );
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        GLint drawFramebuffer = 0;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+        glGenFramebuffers(1, &_framebuffer);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebuffer);
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _colorTexture, 0);
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, _depthTexture, 0);
+        const GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE) {
+            sgct::Log::Error("Incomplete single-pass framebuffer (0x%x)", status);
+        }
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+
+        glGenFramebuffers(1, &_readFramebuffer);
+    }
+
+    // The views are ordered by eye first so that the index matches viewIndex
+    _mvps.clear();
+    for (int eye = 0; eye < nEyes; ++eye) {
+        using Mode = sgct::Frustum::Mode;
+        const Mode mode = nEyes == 1 ?
+            Mode::MonoEye :
+            (eye == 0 ? Mode::StereoLeftEye : Mode::StereoRightEye);
+        for (const std::unique_ptr<sgct::Viewport>& vp : vps) {
+            const glm::mat4& viewProj = vp->projection(mode).viewProjectionMatrix();
+            _mvps.push_back(viewProj * data.modelMatrix * camera);
+        }
+    }
+
+    GLint drawFramebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _framebuffer);
+    for (int i = 0; i < nLayers; ++i) {
+        const glm::ivec2 s = viewSize(data, i % nViewports);
+        glViewportIndexedf(i, 0.f, 0.f, static_cast<float>(s.x), static_cast<float>(s.y));
+    }
+    // Clearing a layered framebuffer clears all of its layers
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    list.drawViews(_mvps);
+
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, drawFramebuffer);
+    // Setting the viewport resets all indexed viewports as well
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+int MultiViewTarget::viewIndex(const sgct::RenderData& data) const {
+    const std::vector<std::unique_ptr<sgct::Viewport>>& vps = data.window.viewports();
+    const int eye = data.frustumMode == sgct::Frustum::Mode::StereoRightEye ? 1 : 0;
+    for (size_t i = 0; i < vps.size(); ++i) {
+        if (vps[i].get() == &data.viewport) {
+            return eye * static_cast<int>(vps.size()) + static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+glm::ivec2 MultiViewTarget::viewSize(const sgct::RenderData& data, int viewport) const {
+    const glm::vec2 res = glm::vec2(data.window.framebufferResolution());
+    const glm::vec2 size = res * data.window.viewports()[viewport]->size();
+    return glm::max(glm::ivec2(size), glm::ivec2(1));
+}
@@ -0,0 +1,85 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __MULTIVIEW_H__
+#define __MULTIVIEW_H__
+
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace sgct { struct RenderData; }
+class RenderList;
+
+// Renders all eyes and viewports of a window in a single pass. SGCT calls the draw
+// callback once per eye and viewport; on the first call of a window in a frame, all views
+// are rendered with instanced draws into the layers of an array texture, where the
+// vertex shader routes each instance to its layer and viewport. Every call then only
+// copies its layer into SGCT's framebuffer. This requires the
+// GL_ARB_shader_viewport_layer_array extension to set the layer from the vertex shader
+class MultiViewTarget {
+public:
+    static bool isSupported();
+
+    // Returns whether the view of the render data can be rendered through this target.
+    // Windows with non-linear projections, too many views, or multisampled framebuffers
+    // have to be rendered the regular way
+    bool canDraw(const sgct::RenderData& data) const;
+
+    // Renders all views of the window if this has not happened yet in this frame and then
+    // copies the view of the render data into the currently bound framebuffer. The camera
+    // matrix is applied after SGCT's model matrix
+    void draw(const sgct::RenderData& data, const glm::mat4& camera, RenderList& list);
+
+    void deinitialize();
+
+private:
+    void renderViews(const sgct::RenderData& data, const glm::mat4& camera,
+        RenderList& list);
+
+    // Returns the index of the view for the viewport and eye of the render data
+    int viewIndex(const sgct::RenderData& data) const;
+    glm::ivec2 viewSize(const sgct::RenderData& data, int viewport) const;
+
+    GLuint _framebuffer = 0;
+    GLuint _readFramebuffer = 0;
+    GLuint _colorTexture = 0;
+    GLuint _depthTexture = 0;
+    glm::ivec2 _size = glm::ivec2(0);
+    int _nLayers = 0;
+
+    // Identifies the window and frame for which the views have been rendered
+    int _windowId = -1;
+    unsigned int _frameNumber = 0;
+    bool _hasRendered = false;
+    std::vector<glm::mat4> _mvps;
+};
+
+#endif // __MULTIVIEW_H__
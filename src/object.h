@@ -32,12 +32,20 @@
 #define __OBJECT_H__
 
 #include "imagecache.h"
+#include "mesh.h"
+#include "playback.h"
+#include "sequenceindex.h"
 #include <sgct/opengl.h>
+#include <glm/glm.hpp>
 #ifdef SGCT_HAS_SPOUT
 #include <SpoutLibrary.h>
 #endif // SGCT_HAS_SPOUT
+#include <chrono>
 #include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
+#include <vector>
 
 struct Object {
     enum class Type { Unspecified, Model, Cylinder };
@@ -51,17 +59,57 @@ struct Object {
     void bindTexture(bool useSpout);
     void unbindTexture(bool useSpout);
 
+    // Picks up images that were added to, changed in, or removed from the image folder
+    void updateImages();
+
+    // Loads the diffuse textures of the materials of the mesh, also after the mesh has
+    // been reloaded. Has to be called from the rendering thread every frame
+    void updateMaterialImages();
+
+    // Frees the textures and decoded images of the sequence and of the materials. They
+    // are loaded again by setting the current image and updating the material images
+    void releaseImages();
+
+    // The images shown on a part of the mesh, which are the diffuse texture of its
+    // material or the image sequence of the object if the material has no texture
+    const ImageCache& images(size_t part) const;
+
+    // Parses the obj file again in the background after it has been changed on disk.
+    // The new geometry is only used once applyReloads is called. Objects that share the
+    // same obj file share the reload as well
+    void reloadModel();
+    bool hasPendingReload() const;
+    bool hasPreparedReload() const;
+    void applyReloads();
+
     Type type = Type::Unspecified;
-    GLuint vao = 0;
-    GLuint vbo = 0;
-    uint32_t nVertices = 0;
+    std::shared_ptr<Mesh> mesh;
+    // Places the mesh in the scene
+    glm::mat4 transform = glm::mat4(1.f);
+
+    // Whether the object can be seen in any viewport of this node, which is decided by
+    // every node on its own. Objects that are out of view don't load any images
+    bool isVisible = true;
+    std::chrono::steady_clock::time_point lastVisibleTime;
 
     const std::string name;
     const std::string objFile;
     const std::string spoutName;
-    const std::vector<std::filesystem::path> imagePaths;
+    SequenceIndex imageIndex;
 
     ImageCache imageCache;
+    // Decides which image of the sequence is shown
+    Playback playback;
+    // The images of the frames after the current one, whose readiness is reported to
+    // the master
+    std::vector<uint32_t> upcomingImages;
+    // The images of the frames that the master has scheduled, which are decoded in
+    // advance
+    std::vector<uint32_t> scheduledImages;
+
+    // One entry for every part of the mesh, which is empty if the part has no texture
+    std::vector<std::optional<ImageCache>> materialImages;
+    std::vector<std::string> materialTextures;
 
 #ifdef SGCT_HAS_SPOUT
     struct Spout {
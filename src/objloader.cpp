@@ -33,15 +33,15 @@
 #include <sgct/log.h>
 #include <glm/glm.hpp>
 #include <charconv>
+#include <filesystem>
 #include <fstream>
 #include <functional>
 #include <sstream>
 
 namespace {
     constexpr const char* IgnoredTokens[] = {
-        "mtllib",
         "o",
-        "usemtl",
+        "g",
         "s"
     };
 
@@ -50,6 +50,8 @@ namespace {
         Normal,
         UV,
         Face,
+        MaterialLibrary,
+        UseMaterial,
         
         Ignored,
         Unknown
@@ -68,6 +70,12 @@ namespace {
         else if (token == "f") {
             return Token::Face;
         }
+        else if (token == "mtllib") {
+            return Token::MaterialLibrary;
+        }
+        else if (token == "usemtl") {
+            return Token::UseMaterial;
+        }
         auto it = std::find(std::cbegin(IgnoredTokens), std::cend(IgnoredTokens), token);
         if (it != std::cend(IgnoredTokens)) {
             return Token::Ignored;
@@ -253,6 +261,58 @@ namespace {
         return face;
     }
 
+    // Adds all materials of the mtl file to the model. Only the name and the diffuse
+    // texture of the materials are used; the lighting parameters are ignored as the
+    // images are shown unlit
+    void loadMtlFile(const std::filesystem::path& file, obj::Model& model) {
+        std::ifstream f(file);
+        if (!f.good()) {
+            sgct::Log::Error("Could not find material file %s", file.string().c_str());
+            return;
+        }
+
+        obj::Material* material = nullptr;
+        for (std::string line; std::getline(f, line);) {
+            // Material files are commonly indented and might have Windows line endings
+            const size_t begin = line.find_first_not_of(" \t\r");
+            if (begin == std::string::npos || line[begin] == '#') {
+                continue;
+            }
+            const size_t end = line.find_last_not_of(" \t\r");
+            line = line.substr(begin, end - begin + 1);
+
+            // Keywords without a value, such as in a file that is still being saved, are
+            // skipped
+            const size_t sep = line.find_first_of(" \t");
+            if (sep == std::string::npos) {
+                continue;
+            }
+            const std::string token = line.substr(0, sep);
+            const std::string value = line.substr(line.find_first_not_of(" \t", sep));
+
+            if (token == "newmtl") {
+                obj::Material m;
+                m.name = value;
+                model.materials.push_back(std::move(m));
+                material = &model.materials.back();
+            }
+            else if (token == "map_Kd" && material) {
+                // Options such as -blendu precede the file name, which comes last
+                const std::string name = value.substr(value.find_last_of(" \t") + 1);
+                material->diffuseMap = (file.parent_path() / name).string();
+            }
+        }
+    }
+
+    uint32_t materialIndex(const obj::Model& model, const std::string& name) {
+        for (size_t i = 0; i < model.materials.size(); ++i) {
+            if (model.materials[i].name == name) {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        return 0;
+    }
+
 } // namespace
 
 namespace obj {
@@ -264,8 +324,13 @@ Model loadObjFile(const std::string& file) {
     }
 
     Model model;
+    uint32_t currentMaterial = 0;
 
     for (std::string line; std::getline(f, line);) {
+        // Files with Windows line endings would otherwise end every name with the '\r'
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
         if (line.empty()) {
             continue;
         }
@@ -298,6 +363,17 @@ Model loadObjFile(const std::string& file) {
                 break;
             case Token::Face:
                 model.faces.push_back(readFace(remainder));
+                model.faces.back().material = currentMaterial;
+                break;
+            case Token::MaterialLibrary:
+                // The material files are relative to the obj file
+                loadMtlFile(std::filesystem::path(file).parent_path() / remainder, model);
+                break;
+            case Token::UseMaterial:
+                currentMaterial = materialIndex(model, remainder);
+                if (currentMaterial == 0) {
+                    sgct::Log::Warning("Unknown material: %s", remainder.c_str());
+                }
                 break;
             case Token::Ignored:
             case Token::Unknown:
@@ -55,6 +55,13 @@ struct UV {
     float v = 0.f;
 };
 
+struct Material {
+    std::string name;
+    // The path of the diffuse texture (map_Kd) relative to the working directory. Is
+    // empty if the material has no texture
+    std::string diffuseMap;
+};
+
 struct Face {
     struct Indices {
         uint32_t vertex = 0;
@@ -65,6 +72,8 @@ struct Face {
     Indices i1;
     Indices i2;
     std::optional<Indices> i3;
+    // The index into Model::materials that was selected by the last usemtl statement
+    uint32_t material = 0;
 };
 
 struct Model {
@@ -73,8 +82,11 @@ struct Model {
     std::vector<UV> uvs;
 
     std::vector<Face> faces;
+    // The first material is used for all faces before the first usemtl statement
+    std::vector<Material> materials = { Material() };
 };
 
+// Loads the obj file and the materials of all mtl files that are referenced by it
 Model loadObjFile(const std::string& file);
 
 
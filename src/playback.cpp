@@ -0,0 +1,124 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "playback.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Limits the planning if the renderer is much faster than the playback. The rest of
+    // the schedule is filled with the frames that follow
+    constexpr const uint32_t MaxPlannedSteps = 256;
+} // namespace
+
+void Playback::advance(double dt, uint64_t readyMask) {
+    time += dt;
+    // The epsilon protects against rounding errors right after a seek
+    targetFrame = static_cast<uint32_t>(std::floor(time * fps + 1e-6));
+
+    if (targetFrame <= currentFrame) {
+        return;
+    }
+
+    // Search for the newest frame that is not newer than the target frame. Every frame
+    // between the current and the selected one will never be shown
+    const uint32_t nCandidates = std::min(targetFrame - currentFrame, 64u);
+    for (uint32_t i = nCandidates; i > 0; --i) {
+        if (readyMask & (uint64_t(1) << (i - 1))) {
+            nDroppedImages += i - 1;
+            currentFrame += i;
+            break;
+        }
+    }
+
+    if (currentFrame < targetFrame && targetFrame != _lastLateFrame) {
+        // The target frame has missed its deadline on at least one node
+        nLateImages += 1;
+        _lastLateFrame = targetFrame;
+    }
+}
+
+void Playback::seek(uint32_t image) {
+    currentFrame = image;
+    targetFrame = image;
+    time = static_cast<double>(image) / fps;
+}
+
+void Playback::seekTime(double seconds) {
+    time = seconds;
+    currentFrame = static_cast<uint32_t>(std::floor(time * fps + 1e-6));
+    targetFrame = currentFrame;
+}
+
+uint32_t Playback::image(uint32_t frame) const {
+    if (loopEnd > loopFirst && frame >= loopEnd) {
+        return loopFirst + (frame - loopFirst) % (loopEnd - loopFirst);
+    }
+    return frame;
+}
+
+uint32_t Playback::currentImage() const {
+    return image(currentFrame);
+}
+
+void Playback::upcomingImages(uint32_t count, std::vector<uint32_t>& images) const {
+    images.clear();
+    for (uint32_t i = 1; i <= count; ++i) {
+        images.push_back(image(currentFrame + i));
+    }
+}
+
+void Playback::plan(double frameInterval) {
+    uint32_t last = currentFrame;
+    size_t n = 0;
+    if (frameInterval > 0.0) {
+        for (uint32_t i = 1; i <= MaxPlannedSteps && n < schedule.size(); ++i) {
+            const double t = time + i * frameInterval;
+            const uint32_t frame = static_cast<uint32_t>(std::floor(t * fps + 1e-6));
+            if (frame > last) {
+                schedule[n] = frame - currentFrame;
+                last = frame;
+                n++;
+            }
+        }
+    }
+    for (; n < schedule.size(); ++n) {
+        last++;
+        schedule[n] = last - currentFrame;
+    }
+}
+
+void Playback::scheduledImages(std::vector<uint32_t>& images) const {
+    images.clear();
+    for (uint32_t offset : schedule) {
+        images.push_back(image(currentFrame + offset));
+    }
+}
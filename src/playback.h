@@ -0,0 +1,94 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __PLAYBACK_H__
+#define __PLAYBACK_H__
+
+#include <cstdint>
+#include <vector>
+
+// The playback clock of the image sequence of an object. The clocks are owned by the
+// master node, which advances them in real time and decides which images the cluster
+// shows; the result is distributed to all nodes through the synchronization step.
+// Frames are counted from the start of the sequence and never wrap around, and with a
+// loop the frames past the end of the loop show the images of the loop again
+struct Playback {
+    // Advances the clock by dt seconds and selects the newest frame that is due and
+    // ready on every node. Bit i of readyMask corresponds to frame currentFrame + 1 + i
+    void advance(double dt, uint64_t readyMask);
+
+    // Jumps to the frame that shows the provided image and restarts the clock from there
+    void seek(uint32_t image);
+
+    // Sets the clock to the provided time and shows the frame that is due at that time
+    void seekTime(double seconds);
+
+    // Returns the image that is shown in the provided frame
+    uint32_t image(uint32_t frame) const;
+    uint32_t currentImage() const;
+
+    // Replaces the contents of images with the images of the next count frames
+    void upcomingImages(uint32_t count, std::vector<uint32_t>& images) const;
+
+    // Fills the schedule with the frames that will be shown next if the renderer keeps
+    // drawing a frame every frameInterval seconds. Frames of sequences that play faster
+    // than the renderer are skipped. If frameInterval is 0, the playback is paused and
+    // the schedule contains the frames that follow the current one
+    void plan(double frameInterval);
+
+    // Replaces the contents of images with the images of the scheduled frames
+    void scheduledImages(std::vector<uint32_t>& images) const;
+
+    double fps = 30.0;
+    // The images [loopFirst, loopEnd) are repeated once the playback has reached
+    // loopEnd. There is no loop if loopEnd is not larger than loopFirst
+    uint32_t loopFirst = 0;
+    uint32_t loopEnd = 0;
+
+    // Only needed on the master, which is the only node that advances the clock
+    double time = 0.0;
+
+    // Synchronized values
+    uint32_t currentFrame = 0;
+    uint32_t targetFrame = 0;
+    uint32_t nDroppedImages = 0;
+    uint32_t nLateImages = 0;
+    // The frames that the master expects to show next as offsets from the current frame,
+    // which stay the same from frame to frame while playing steadily. The master plans
+    // the schedule and all nodes decode the scheduled images in advance. The size has to
+    // be the same on all nodes
+    std::vector<uint32_t> schedule;
+
+private:
+    // The last target frame that we have already counted as being late
+    uint32_t _lastLateFrame = 0;
+};
+
+#endif // __PLAYBACK_H__
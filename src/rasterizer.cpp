@@ -0,0 +1,444 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "rasterizer.h"
+
+#include "workerpool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif // __SSE2__ || _M_X64
+
+namespace {
+    // The number of triangles that are set up by a single job
+    constexpr const uint32_t SetupBatchSize = 3 * 1024;
+
+    struct ClipVertex {
+        glm::vec4 position;
+        float u = 0.f;
+        float v = 0.f;
+    };
+
+    ClipVertex lerp(const ClipVertex& p, const ClipVertex& q, float t) {
+        ClipVertex res;
+        res.position = p.position + (q.position - p.position) * t;
+        res.u = p.u + (q.u - p.u) * t;
+        res.v = p.v + (q.v - p.v) * t;
+        return res;
+    }
+
+    // Clips the triangle against the near plane z = -w, which results in up to four
+    // vertices. The other planes are handled by the bounding box of the triangle
+    int clipNear(const ClipVertex (&in)[3], ClipVertex (&out)[4]) {
+        int n = 0;
+        for (int i = 0; i < 3; ++i) {
+            const ClipVertex& p = in[i];
+            const ClipVertex& q = in[(i + 1) % 3];
+            const float dp = p.position.z + p.position.w;
+            const float dq = q.position.z + q.position.w;
+            if (dp >= 0.f) {
+                out[n++] = p;
+            }
+            if ((dp >= 0.f) != (dq >= 0.f)) {
+                out[n++] = lerp(p, q, dp / (dp - dq));
+            }
+        }
+        return n;
+    }
+
+    // Returns the texel as values in [0, 255], filling missing channels the same way
+    // OpenGL does
+    void texel(const DecodedImage& image, int x, int y, float (&res)[4]) {
+        res[0] = 0.f;
+        res[1] = 0.f;
+        res[2] = 0.f;
+        res[3] = 255.f;
+        const size_t offset =
+            (static_cast<size_t>(y) * image.size.x + x) * image.channels;
+        for (int c = 0; c < std::min(image.channels, 4); ++c) {
+            if (image.bytesPerChannel == 2) {
+                uint16_t value;
+                std::memcpy(&value, &image.data[(offset + c) * 2], sizeof(value));
+                res[c] = value / 257.f;
+            }
+            else {
+                res[c] = image.data[offset + c];
+            }
+        }
+    }
+
+    // Samples the image bilinearly with clamp-to-edge wrapping. The first row of the
+    // image data is at v = 0, just like in the textures
+    void sample(const DecodedImage& image, float u, float v, float (&res)[4]) {
+        const float fx = u * image.size.x - 0.5f;
+        const float fy = v * image.size.y - 0.5f;
+        const float x0f = std::floor(fx);
+        const float y0f = std::floor(fy);
+        const float tx = fx - x0f;
+        const float ty = fy - y0f;
+
+        const int x0 = std::clamp(static_cast<int>(x0f), 0, image.size.x - 1);
+        const int x1 = std::clamp(static_cast<int>(x0f) + 1, 0, image.size.x - 1);
+        const int y0 = std::clamp(static_cast<int>(y0f), 0, image.size.y - 1);
+        const int y1 = std::clamp(static_cast<int>(y0f) + 1, 0, image.size.y - 1);
+
+        float t00[4];
+        float t10[4];
+        float t01[4];
+        float t11[4];
+        texel(image, x0, y0, t00);
+        texel(image, x1, y0, t10);
+        texel(image, x0, y1, t01);
+        texel(image, x1, y1, t11);
+        for (int c = 0; c < 4; ++c) {
+            const float bottom = t00[c] + (t10[c] - t00[c]) * tx;
+            const float top = t01[c] + (t11[c] - t01[c]) * tx;
+            res[c] = bottom + (top - bottom) * ty;
+        }
+    }
+
+    // Evaluates the edge functions of the triangle for the four pixels starting at x in
+    // the row whose constant terms are rowC. Returns a mask with bit i set if pixel
+    // x + i is inside the triangle
+    int coverage(const float (&a)[3], const float (&rowC)[3], int x, float (&e0)[4],
+                 float (&e1)[4], float (&e2)[4])
+    {
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128 px = _mm_add_ps(
+            _mm_set1_ps(static_cast<float>(x)),
+            _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f)
+        );
+        __m128 e[3];
+        for (int i = 0; i < 3; ++i) {
+            e[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i]), px), _mm_set1_ps(rowC[i]));
+        }
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 inside = _mm_and_ps(
+            _mm_and_ps(_mm_cmpge_ps(e[0], zero), _mm_cmpge_ps(e[1], zero)),
+            _mm_cmpge_ps(e[2], zero)
+        );
+        const int mask = _mm_movemask_ps(inside);
+        if (mask != 0) {
+            _mm_storeu_ps(e0, e[0]);
+            _mm_storeu_ps(e1, e[1]);
+            _mm_storeu_ps(e2, e[2]);
+        }
+        return mask;
+#else // __SSE2__ || _M_X64
+        int mask = 0;
+        for (int i = 0; i < 4; ++i) {
+            const float px = static_cast<float>(x + i) + 0.5f;
+            e0[i] = a[0] * px + rowC[0];
+            e1[i] = a[1] * px + rowC[1];
+            e2[i] = a[2] * px + rowC[2];
+            if (e0[i] >= 0.f && e1[i] >= 0.f && e2[i] >= 0.f) {
+                mask |= 1 << i;
+            }
+        }
+        return mask;
+#endif // __SSE2__ || _M_X64
+    }
+} // namespace
+
+Rasterizer::Rasterizer(glm::ivec2 size, unsigned int nThreads)
+    : _size(size)
+    , _nTiles((size.x + TileSize - 1) / TileSize, (size.y + TileSize - 1) / TileSize)
+    , _workers(std::make_unique<WorkerPool>(nThreads))
+    , _color(static_cast<size_t>(size.x) * size.y * 4)
+    , _depth(static_cast<size_t>(size.x) * size.y)
+    , _bins(static_cast<size_t>(_nTiles.x) * _nTiles.y)
+{}
+
+Rasterizer::~Rasterizer() = default;
+
+void Rasterizer::render(const std::vector<Surface>& surfaces,
+                        const glm::mat4& viewProjection)
+{
+    // Every job sets up its triangles independently and the results are concatenated in
+    // the order of the jobs, so the triangles keep the order in which they were submitted
+    _setupJobs.clear();
+    for (size_t i = 0; i < surfaces.size(); ++i) {
+        for (uint32_t v = 0; v + 2 < surfaces[i].nVertices; v += SetupBatchSize) {
+            SetupJob job;
+            job.surface = i;
+            job.firstVertex = v;
+            job.nVertices = std::min(SetupBatchSize, surfaces[i].nVertices - v);
+            _setupJobs.push_back(job);
+        }
+    }
+    if (_setupResults.size() < _setupJobs.size()) {
+        _setupResults.resize(_setupJobs.size());
+    }
+    parallelFor(_setupJobs.size(), [&](size_t i) {
+        const Surface& surface = surfaces[_setupJobs[i].surface];
+        _setupResults[i].clear();
+        setup(
+            surface,
+            viewProjection * surface.transform,
+            _setupJobs[i],
+            _setupResults[i]
+        );
+    });
+
+    _triangles.clear();
+    for (std::vector<uint32_t>& bin : _bins) {
+        bin.clear();
+    }
+    for (size_t i = 0; i < _setupJobs.size(); ++i) {
+        for (const Triangle& tri : _setupResults[i]) {
+            const uint32_t index = static_cast<uint32_t>(_triangles.size());
+            _triangles.push_back(tri);
+            for (int ty = tri.min.y / TileSize; ty <= tri.max.y / TileSize; ++ty) {
+                for (int tx = tri.min.x / TileSize; tx <= tri.max.x / TileSize; ++tx) {
+                    _bins[static_cast<size_t>(ty) * _nTiles.x + tx].push_back(index);
+                }
+            }
+        }
+    }
+
+    // The tiles don't overlap, so they can be cleared and rasterized independently
+    parallelFor(_bins.size(), [this](size_t i) { rasterizeTile(static_cast<int>(i)); });
+}
+
+const std::vector<unsigned char>& Rasterizer::pixels() const {
+    return _color;
+}
+
+glm::ivec2 Rasterizer::size() const {
+    return _size;
+}
+
+void Rasterizer::setup(const Surface& surface, const glm::mat4& mvp,
+                       const SetupJob& job, std::vector<Triangle>& result) const
+{
+    const float w = static_cast<float>(_size.x);
+    const float h = static_cast<float>(_size.y);
+
+    for (uint32_t v = job.firstVertex; v + 2 < job.firstVertex + job.nVertices; v += 3) {
+        ClipVertex in[3];
+        for (int i = 0; i < 3; ++i) {
+            const Vertex& vertex = surface.vertices[v + i];
+            in[i].position = mvp * glm::vec4(vertex.x, vertex.y, vertex.z, 1.f);
+            in[i].u = vertex.u;
+            in[i].v = vertex.v;
+        }
+
+        // Triangles that are completely outside of one of the side planes are skipped
+        // before they are clipped
+        bool isOutside = false;
+        for (int axis = 0; axis < 2 && !isOutside; ++axis) {
+            isOutside =
+                (in[0].position[axis] > in[0].position.w &&
+                 in[1].position[axis] > in[1].position.w &&
+                 in[2].position[axis] > in[2].position.w) ||
+                (in[0].position[axis] < -in[0].position.w &&
+                 in[1].position[axis] < -in[1].position.w &&
+                 in[2].position[axis] < -in[2].position.w);
+        }
+        if (isOutside) {
+            continue;
+        }
+
+        ClipVertex clipped[4];
+        const int nClipped = clipNear(in, clipped);
+
+        // The clipped polygon is convex, so it is split into a fan of triangles
+        for (int k = 1; k + 1 < nClipped; ++k) {
+            const ClipVertex* p[3] = { &clipped[0], &clipped[k], &clipped[k + 1] };
+
+            Triangle tri;
+            glm::vec2 window[3];
+            for (int i = 0; i < 3; ++i) {
+                const glm::vec4& pos = p[i]->position;
+                const float invW = 1.f / pos.w;
+                window[i].x = (pos.x * invW * 0.5f + 0.5f) * w;
+                window[i].y = (pos.y * invW * 0.5f + 0.5f) * h;
+                tri.z[i] = pos.z * invW * 0.5f + 0.5f;
+                tri.invW[i] = invW;
+                tri.uOverW[i] = p[i]->u * invW;
+                tri.vOverW[i] = p[i]->v * invW;
+            }
+
+            // Edge i is opposite of vertex i
+            for (int i = 0; i < 3; ++i) {
+                const glm::vec2& s = window[(i + 1) % 3];
+                const glm::vec2& e = window[(i + 2) % 3];
+                tri.a[i] = -(e.y - s.y);
+                tri.b[i] = e.x - s.x;
+                tri.c[i] = (e.y - s.y) * s.x - (e.x - s.x) * s.y;
+            }
+
+            // The area is the value of the edge functions summed over the vertices.
+            // Clockwise triangles are back faces, just as with glCullFace(GL_BACK)
+            const float area = tri.a[0] * window[0].x + tri.b[0] * window[0].y + tri.c[0];
+            if (!(area > 0.f)) {
+                continue;
+            }
+            tri.invArea = 1.f / area;
+
+            const float minX = std::min({ window[0].x, window[1].x, window[2].x });
+            const float maxX = std::max({ window[0].x, window[1].x, window[2].x });
+            const float minY = std::min({ window[0].y, window[1].y, window[2].y });
+            const float maxY = std::max({ window[0].y, window[1].y, window[2].y });
+            if (maxX < 0.f || maxY < 0.f || minX > w || minY > h) {
+                continue;
+            }
+            tri.min.x = std::clamp(static_cast<int>(std::floor(minX)), 0, _size.x - 1);
+            tri.min.y = std::clamp(static_cast<int>(std::floor(minY)), 0, _size.y - 1);
+            tri.max.x = std::clamp(static_cast<int>(std::ceil(maxX)), 0, _size.x - 1);
+            tri.max.y = std::clamp(static_cast<int>(std::ceil(maxY)), 0, _size.y - 1);
+            tri.image = surface.image;
+            result.push_back(tri);
+        }
+    }
+}
+
+void Rasterizer::rasterizeTile(int tile) {
+    const glm::ivec2 tileMin(
+        (tile % _nTiles.x) * TileSize,
+        (tile / _nTiles.x) * TileSize
+    );
+    const glm::ivec2 tileMax(
+        std::min(tileMin.x + TileSize, _size.x) - 1,
+        std::min(tileMin.y + TileSize, _size.y) - 1
+    );
+
+    // Cleared to the same values as the OpenGL path uses
+    for (int y = tileMin.y; y <= tileMax.y; ++y) {
+        const size_t row = static_cast<size_t>(y) * _size.x;
+        std::fill(
+            _depth.begin() + row + tileMin.x,
+            _depth.begin() + row + tileMax.x + 1,
+            1.f
+        );
+        for (int x = tileMin.x; x <= tileMax.x; ++x) {
+            unsigned char* pixel = &_color[(row + x) * 4];
+            pixel[0] = 0;
+            pixel[1] = 0;
+            pixel[2] = 0;
+            pixel[3] = 255;
+        }
+    }
+
+    for (uint32_t index : _bins[tile]) {
+        const Triangle& tri = _triangles[index];
+        const int x0 = std::max(tri.min.x, tileMin.x);
+        const int x1 = std::min(tri.max.x, tileMax.x);
+        const int y0 = std::max(tri.min.y, tileMin.y);
+        const int y1 = std::min(tri.max.y, tileMax.y);
+
+        for (int y = y0; y <= y1; ++y) {
+            const float py = static_cast<float>(y) + 0.5f;
+            const float rowC[3] = {
+                tri.b[0] * py + tri.c[0],
+                tri.b[1] * py + tri.c[1],
+                tri.b[2] * py + tri.c[2]
+            };
+
+            for (int x = x0; x <= x1; x += 4) {
+                float e0[4];
+                float e1[4];
+                float e2[4];
+                int mask = coverage(tri.a, rowC, x, e0, e1, e2);
+                // The last group of the row might extend past the bounding box
+                mask &= (1 << std::min(4, x1 - x + 1)) - 1;
+                for (int i = 0; mask != 0; ++i, mask >>= 1) {
+                    if (mask & 1) {
+                        shade(tri, x + i, y, e0[i], e1[i], e2[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Rasterizer::shade(const Triangle& tri, int x, int y, float e0, float e1, float e2) {
+    const float l0 = e0 * tri.invArea;
+    const float l1 = e1 * tri.invArea;
+    const float l2 = e2 * tri.invArea;
+
+    const float z = l0 * tri.z[0] + l1 * tri.z[1] + l2 * tri.z[2];
+    const size_t index = static_cast<size_t>(y) * _size.x + x;
+    if (z > 1.f || z >= _depth[index]) {
+        return;
+    }
+    _depth[index] = z;
+
+    unsigned char* pixel = &_color[index * 4];
+    if (!tri.image) {
+        pixel[0] = 0;
+        pixel[1] = 0;
+        pixel[2] = 0;
+        pixel[3] = 255;
+        return;
+    }
+
+    const float invW = l0 * tri.invW[0] + l1 * tri.invW[1] + l2 * tri.invW[2];
+    const float u = (l0 * tri.uOverW[0] + l1 * tri.uOverW[1] + l2 * tri.uOverW[2]) / invW;
+    const float v = (l0 * tri.vOverW[0] + l1 * tri.vOverW[1] + l2 * tri.vOverW[2]) / invW;
+
+    float color[4];
+    sample(*tri.image, u, v, color);
+    for (int c = 0; c < 4; ++c) {
+        pixel[c] = static_cast<unsigned char>(std::clamp(color[c] + 0.5f, 0.f, 255.f));
+    }
+}
+
+void Rasterizer::parallelFor(size_t n, const std::function<void(size_t)>& fn) {
+    if (n == 0) {
+        return;
+    }
+
+    std::atomic<size_t> next = 0;
+    std::mutex mutex;
+    std::condition_variable done;
+    const unsigned int nJobs = static_cast<unsigned int>(
+        std::min<size_t>(n, _workers->nThreads())
+    );
+    unsigned int nRunning = nJobs;
+    for (unsigned int i = 0; i < nJobs; ++i) {
+        _workers->enqueue([&]() {
+            for (size_t j = next++; j < n; j = next++) {
+                fn(j);
+            }
+            std::lock_guard lock(mutex);
+            nRunning--;
+            done.notify_all();
+        });
+    }
+
+    std::unique_lock lock(mutex);
+    done.wait(lock, [&]() { return nRunning == 0; });
+}
@@ -0,0 +1,132 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __RASTERIZER_H__
+#define __RASTERIZER_H__
+
+#include "mesh.h"
+#include "textureregistry.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class WorkerPool;
+
+// Renders textured triangles on the CPU with the same rules as the OpenGL path: back
+// faces are culled, the depth test keeps the closest fragment, and textures are sampled
+// bilinearly with perspective-correct texture coordinates. It needs neither a GPU nor an
+// OpenGL context, so it serves as a preview renderer for batch jobs and as a reference
+// image for regression tests. The screen is split into tiles; every triangle is binned
+// into the tiles it overlaps and the tiles are rasterized in parallel on all cores, with
+// the edge functions being evaluated for four pixels at once
+class Rasterizer {
+public:
+    // A range of triangles that are drawn with the same transform and image
+    struct Surface {
+        const Vertex* vertices = nullptr;
+        uint32_t nVertices = 0;
+        glm::mat4 transform = glm::mat4(1.f);
+        // Surfaces without an image are drawn black, just like an unbound texture
+        const DecodedImage* image = nullptr;
+    };
+
+    // 0 threads uses one thread per hardware core
+    explicit Rasterizer(glm::ivec2 size, unsigned int nThreads = 0);
+    ~Rasterizer();
+
+    Rasterizer(const Rasterizer&) = delete;
+    Rasterizer& operator=(const Rasterizer&) = delete;
+
+    // Clears the frame and renders all surfaces with the view-projection matrix
+    void render(const std::vector<Surface>& surfaces, const glm::mat4& viewProjection);
+
+    // RGBA with 8 bits per channel and the rows ordered from bottom to top, the same as
+    // glReadPixels would return for the OpenGL path
+    const std::vector<unsigned char>& pixels() const;
+    glm::ivec2 size() const;
+
+private:
+    static constexpr const int TileSize = 64;
+
+    // A triangle in window coordinates that is ready to be rasterized. The edge function
+    // i is a[i] * x + b[i] * y + c[i] and is positive inside the triangle on the side
+    // opposite of vertex i. The attributes are stored per vertex
+    struct Triangle {
+        float a[3];
+        float b[3];
+        float c[3];
+        float invArea;
+
+        float z[3];
+        // 1/w, u/w and v/w are linear in window coordinates
+        float invW[3];
+        float uOverW[3];
+        float vOverW[3];
+
+        // The inclusive bounding box in pixels
+        glm::ivec2 min;
+        glm::ivec2 max;
+        const DecodedImage* image;
+    };
+
+    // A range of triangles of a surface that is set up by a single thread
+    struct SetupJob {
+        size_t surface = 0;
+        uint32_t firstVertex = 0;
+        uint32_t nVertices = 0;
+    };
+
+    // Transforms, clips and culls the triangles of the job
+    void setup(const Surface& surface, const glm::mat4& mvp, const SetupJob& job,
+        std::vector<Triangle>& result) const;
+    void rasterizeTile(int tile);
+    void shade(const Triangle& tri, int x, int y, float e0, float e1, float e2);
+
+    // Calls fn(i) for every i in [0, n) on the worker threads and waits for all of them
+    void parallelFor(size_t n, const std::function<void(size_t)>& fn);
+
+    const glm::ivec2 _size;
+    const glm::ivec2 _nTiles;
+    std::unique_ptr<WorkerPool> _workers;
+
+    std::vector<unsigned char> _color;
+    std::vector<float> _depth;
+
+    // Kept between frames to avoid reallocating them
+    std::vector<SetupJob> _setupJobs;
+    std::vector<std::vector<Triangle>> _setupResults;
+    std::vector<Triangle> _triangles;
+    // The indices of the triangles overlapping each tile, in the order of submission
+    std::vector<std::vector<uint32_t>> _bins;
+};
+
+#endif // __RASTERIZER_H__
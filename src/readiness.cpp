@@ -0,0 +1,230 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "readiness.h"
+
+#include <sgct/log.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace {
+    constexpr const uint32_t Magic = 0x52445934; // "RDY4"
+
+    // The time after which a node that did not send a report is no longer waited for
+    constexpr const std::chrono::seconds ReportTimeout = std::chrono::seconds(2);
+
+    // The time the master waits for the first report of every client after startup
+    constexpr const std::chrono::seconds StartupTimeout = std::chrono::seconds(10);
+
+    // The header contains the magic, the node id, the number of pending and prepared
+    // reloads, the flags, and the number of sequences, which are followed by the
+    // sequences
+    constexpr const size_t HeaderSize = 6 * sizeof(uint32_t);
+    constexpr const size_t SequenceSize = sizeof(uint32_t) + sizeof(uint64_t);
+    constexpr const size_t MaxSequences = 1024;
+    constexpr const size_t MaxMessageSize = HeaderSize + MaxSequences * SequenceSize;
+
+    constexpr const uint32_t NeedsKeyframeFlag = 1;
+
+    template <typename T>
+    void write(std::byte*& p, const T& value) {
+        std::memcpy(p, &value, sizeof(T));
+        p += sizeof(T);
+    }
+
+    template <typename T>
+    void read(const std::byte*& p, T& value) {
+        std::memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+    }
+
+    void serialize(int nodeId, const NodeStatus& status, std::vector<std::byte>& data) {
+        const uint32_t n = static_cast<uint32_t>(
+            std::min(status.sequences.size(), MaxSequences)
+        );
+        data.resize(HeaderSize + n * SequenceSize);
+        std::byte* p = data.data();
+        write(p, Magic);
+        write(p, static_cast<int32_t>(nodeId));
+        write(p, status.nPendingReloads);
+        write(p, status.nPreparedReloads);
+        write(p, status.needsKeyframe ? NeedsKeyframeFlag : 0u);
+        write(p, n);
+        for (uint32_t i = 0; i < n; ++i) {
+            write(p, status.sequences[i].firstFrame);
+            write(p, status.sequences[i].readyMask);
+        }
+    }
+
+    // Returns false if the message is not a valid report
+    bool deserialize(const std::byte* data, size_t size, int32_t& nodeId,
+                     NodeStatus& status)
+    {
+        if (size < HeaderSize) {
+            return false;
+        }
+        const std::byte* p = data;
+        uint32_t magic = 0;
+        read(p, magic);
+        if (magic != Magic) {
+            return false;
+        }
+        read(p, nodeId);
+        read(p, status.nPendingReloads);
+        read(p, status.nPreparedReloads);
+        uint32_t flags = 0;
+        read(p, flags);
+        status.needsKeyframe = (flags & NeedsKeyframeFlag) != 0;
+        uint32_t n = 0;
+        read(p, n);
+        if (size != HeaderSize + n * SequenceSize) {
+            return false;
+        }
+        status.sequences.resize(n);
+        for (SequenceStatus& sequence : status.sequences) {
+            read(p, sequence.firstFrame);
+            read(p, sequence.readyMask);
+        }
+        return true;
+    }
+
+    // Moves the mask that starts at frame 'from' so that it starts at frame 'to'. Frames
+    // that were not covered by the original mask are reported as not ready
+    uint64_t alignMask(uint64_t mask, uint32_t from, uint32_t to) {
+        if (from <= to) {
+            const uint32_t shift = to - from;
+            return shift >= ReadinessWindow ? 0 : mask >> shift;
+        }
+        else {
+            const uint32_t shift = from - to;
+            return shift >= ReadinessWindow ? 0 : mask << shift;
+        }
+    }
+} // namespace
+
+ReadinessReporter::ReadinessReporter(const std::string& masterAddress, uint16_t port,
+                                     int nodeId)
+    : _nodeId(nodeId)
+{
+    _socket.connect(masterAddress, port);
+}
+
+void ReadinessReporter::report(const NodeStatus& status) {
+    serialize(_nodeId, status, _message);
+    _socket.send(_message.data(), _message.size());
+}
+
+ReadinessCollector::ReadinessCollector(uint16_t port, int nClients)
+    : _nClients(nClients)
+    , _startTime(std::chrono::steady_clock::now())
+{
+    _socket.bind(port);
+}
+
+void ReadinessCollector::receive() {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    std::array<std::byte, MaxMessageSize> data;
+    while (true) {
+        const size_t size = _socket.receive(data.data(), data.size());
+        if (size == 0) {
+            break;
+        }
+        int32_t nodeId = 0;
+        if (!deserialize(data.data(), size, nodeId, _message)) {
+            continue;
+        }
+
+        if (_reports.find(nodeId) == _reports.end()) {
+            sgct::Log::Info("Received first readiness report from node %i", nodeId);
+        }
+        Report& report = _reports[nodeId];
+        report.status = _message;
+        report.time = now;
+    }
+}
+
+uint64_t ReadinessCollector::clusterMask(size_t sequence, uint32_t firstFrame) const {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    if (static_cast<int>(_reports.size()) < _nClients &&
+        now - _startTime < StartupTimeout)
+    {
+        // Not every node has checked in yet, so we can't make any promises
+        return 0;
+    }
+
+    uint64_t mask = ~uint64_t(0);
+    for (const std::pair<const int, Report>& p : _reports) {
+        const std::vector<SequenceStatus>& sequences = p.second.status.sequences;
+        if (now - p.second.time > ReportTimeout || sequence >= sequences.size()) {
+            continue;
+        }
+        const SequenceStatus& status = sequences[sequence];
+        mask &= alignMask(status.readyMask, status.firstFrame, firstFrame);
+    }
+    return mask;
+}
+
+uint32_t ReadinessCollector::nPendingReloads() const {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    uint32_t res = 0;
+    for (const std::pair<const int, Report>& p : _reports) {
+        if (now - p.second.time <= ReportTimeout) {
+            res += p.second.status.nPendingReloads;
+        }
+    }
+    return res;
+}
+
+uint32_t ReadinessCollector::nPreparedReloads() const {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    uint32_t res = 0;
+    for (const std::pair<const int, Report>& p : _reports) {
+        if (now - p.second.time <= ReportTimeout) {
+            res += p.second.status.nPreparedReloads;
+        }
+    }
+    return res;
+}
+
+bool ReadinessCollector::needsKeyframe() const {
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    for (const std::pair<const int, Report>& p : _reports) {
+        if (now - p.second.time <= ReportTimeout && p.second.status.needsKeyframe) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,113 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __READINESS_H__
+#define __READINESS_H__
+
+#include "socket.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// The number of consecutive frames whose readiness is described by a single bitmask
+constexpr const uint32_t ReadinessWindow = 64;
+
+// The readiness of the image sequence of one object. Bit i of the mask is set if frame
+// firstFrame + i is decoded and can be shown without stalling the cluster
+struct SequenceStatus {
+    uint32_t firstFrame = 0;
+    uint64_t readyMask = 0;
+};
+
+// The state of a node that the master needs to make decisions for the whole cluster
+struct NodeStatus {
+    // One entry for every object, in the order of the objects. Only the first 1024
+    // objects are reported
+    std::vector<SequenceStatus> sequences;
+
+    // Changed files that are still being reloaded or that are ready to be swapped in
+    uint32_t nPendingReloads = 0;
+    uint32_t nPreparedReloads = 0;
+
+    // Set while the node ignores the synchronized state until the next keyframe, as it
+    // failed to decode a previous frame
+    bool needsKeyframe = false;
+};
+
+// Used by the client nodes to tell the master about their status
+class ReadinessReporter {
+public:
+    ReadinessReporter(const std::string& masterAddress, uint16_t port, int nodeId);
+
+    void report(const NodeStatus& status);
+
+private:
+    UdpSocket _socket;
+    const int _nodeId;
+    std::vector<std::byte> _message;
+};
+
+// Collects the reports of all client nodes on the master
+class ReadinessCollector {
+public:
+    ReadinessCollector(uint16_t port, int nClients);
+
+    // Processes all reports that have arrived since the last call
+    void receive();
+
+    // Returns the mask of the frames of the sequence starting at firstFrame that are
+    // ready on every client node. Nodes that have stopped reporting are no longer waited
+    // for
+    uint64_t clusterMask(size_t sequence, uint32_t firstFrame) const;
+
+    // The number of reloads that the client nodes are working on or have finished
+    uint32_t nPendingReloads() const;
+    uint32_t nPreparedReloads() const;
+
+    // Returns whether a client node is waiting for a keyframe of the synchronized state
+    bool needsKeyframe() const;
+
+private:
+    struct Report {
+        NodeStatus status;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    UdpSocket _socket;
+    const int _nClients;
+    const std::chrono::steady_clock::time_point _startTime;
+    std::map<int, Report> _reports;
+    // The most recently received report, which keeps its memory between the frames
+    NodeStatus _message;
+};
+
+#endif // __READINESS_H__
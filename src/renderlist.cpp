@@ -0,0 +1,249 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "renderlist.h"
+
+#include "metrics.h"
+#include "object.h"
+#include "scenebatch.h"
+#include <sgct/shadermanager.h>
+#include <sgct/shaderprogram.h>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+
+namespace {
+    constexpr const GLuint ViewportDataBinding = 0;
+
+    Counter& drawCount() {
+        static Counter& Draws = Metrics::instance().counter(
+            "draws_total",
+            "The number of draw calls"
+        );
+        return Draws;
+    }
+
+    Counter& culledDrawCount() {
+        static Counter& Culled = Metrics::instance().counter(
+            "culled_draws_total",
+            "The number of draws that were skipped as they would not produce anything"
+        );
+        return Culled;
+    }
+
+    GLuint resolveProgram(const char* name, GLint& modelLocation,
+                          GLint& uvRectLocation)
+    {
+        const GLuint program = sgct::ShaderManager::instance().shaderProgram(name).id();
+        modelLocation = glGetUniformLocation(program, "model");
+        uvRectLocation = glGetUniformLocation(program, "uvRect");
+
+        const GLuint block = glGetUniformBlockIndex(program, "ViewportData");
+        glUniformBlockBinding(program, block, ViewportDataBinding);
+
+        // All programs sample from the first texture unit
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "tex"), 0);
+        glUseProgram(0);
+        return program;
+    }
+} // namespace
+
+void RenderList::initialize(bool hasBatchedProgram, bool hasMultiViewPrograms) {
+    Program& p = _program;
+    p.singleView = resolveProgram("wall", p.singleViewModel, p.singleViewUvRect);
+    if (hasMultiViewPrograms) {
+        p.multiView = resolveProgram(
+            "wallMultiView",
+            p.multiViewModel,
+            p.multiViewUvRect
+        );
+    }
+    if (hasBatchedProgram) {
+        Program& b = _batchedProgram;
+        b.singleView = resolveProgram(
+            "wallBatched",
+            b.singleViewModel,
+            b.singleViewUvRect
+        );
+        if (hasMultiViewPrograms) {
+            b.multiView = resolveProgram(
+                "wallBatchedMultiView",
+                b.multiViewModel,
+                b.multiViewUvRect
+            );
+        }
+    }
+
+    glGenBuffers(1, &_uniformBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, _uniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewportData), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void RenderList::build(std::vector<Object>& objects, SceneBatch* batch, bool useSpout)
+{
+    _commands.clear();
+    _viewportData.flipTex = useSpout ? 1 : 0;
+
+    if (batch) {
+        Command cmd;
+        cmd.program = _batchedProgram;
+        cmd.vao = batch->vertexArray();
+        cmd.textureTarget = GL_TEXTURE_2D_ARRAY;
+        cmd.texture = batch->texture();
+        cmd.batch = batch;
+        _commands.push_back(cmd);
+        return;
+    }
+
+    for (Object& obj : objects) {
+        if (!obj.isVisible) {
+            culledDrawCount().add(useSpout ? 1 : obj.mesh->parts.size());
+            continue;
+        }
+
+        Command cmd;
+        cmd.program = _program;
+        cmd.vao = obj.mesh->vao;
+        cmd.model = obj.transform;
+        if (useSpout) {
+            // The Spout texture covers the whole object regardless of its materials
+            cmd.nVertices = static_cast<GLsizei>(obj.mesh->nVertices);
+            cmd.spoutObject = &obj;
+            _commands.push_back(cmd);
+            continue;
+        }
+
+        // The vertices are sorted by material, so every material is a single draw
+        for (size_t i = 0; i < obj.mesh->parts.size(); ++i) {
+            const Mesh::Part& part = obj.mesh->parts[i];
+            if (part.nVertices == 0) {
+                culledDrawCount().add();
+                continue;
+            }
+            cmd.texture = obj.images(i).texture();
+            cmd.uvRect = obj.images(i).uvRect();
+            cmd.first = static_cast<GLint>(part.first);
+            cmd.nVertices = static_cast<GLsizei>(part.nVertices);
+            _commands.push_back(cmd);
+        }
+    }
+}
+
+void RenderList::draw(const glm::mat4& mvp) {
+    _viewportData.mvp[0] = mvp;
+    replay(1);
+}
+
+void RenderList::drawViews(const std::vector<glm::mat4>& mvps) {
+    const size_t nViews = std::min<size_t>(mvps.size(), MaxViews);
+    std::copy(mvps.begin(), mvps.begin() + nViews, _viewportData.mvp);
+    replay(static_cast<GLuint>(nViews));
+}
+
+void RenderList::replay(GLuint nViews) {
+    _viewportData.nViews = static_cast<int32_t>(nViews);
+    glBindBuffer(GL_UNIFORM_BUFFER, _uniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ViewportData), &_viewportData);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, ViewportDataBinding, _uniformBuffer);
+
+    glActiveTexture(GL_TEXTURE0);
+
+    // The state that is currently bound. Anything that SGCT might have changed between
+    // viewports is bound again for the first command
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLenum textureTarget = 0;
+    GLuint texture = 0;
+    bool isFirst = true;
+    drawCount().add(_commands.size());
+    for (const Command& cmd : _commands) {
+        const bool isMultiView = nViews > 1;
+        const GLuint p = isMultiView ? cmd.program.multiView : cmd.program.singleView;
+        if (isFirst || p != program) {
+            glUseProgram(p);
+            program = p;
+        }
+        const GLint modelLocation =
+            isMultiView ? cmd.program.multiViewModel : cmd.program.singleViewModel;
+        if (modelLocation != -1) {
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(cmd.model));
+        }
+        const GLint uvRectLocation =
+            isMultiView ? cmd.program.multiViewUvRect : cmd.program.singleViewUvRect;
+        if (uvRectLocation != -1) {
+            glUniform4fv(uvRectLocation, 1, glm::value_ptr(cmd.uvRect));
+        }
+        if (isFirst || cmd.vao != vao) {
+            glBindVertexArray(cmd.vao);
+            vao = cmd.vao;
+        }
+        isFirst = false;
+
+        if (cmd.spoutObject) {
+            cmd.spoutObject->bindTexture(true);
+            glDrawArraysInstanced(GL_TRIANGLES, cmd.first, cmd.nVertices, nViews);
+            cmd.spoutObject->unbindTexture(true);
+            // We don't know what the receiver has bound
+            textureTarget = 0;
+            continue;
+        }
+
+        if (cmd.textureTarget != textureTarget || cmd.texture != texture) {
+            if (textureTarget != 0 && textureTarget != cmd.textureTarget) {
+                glBindTexture(textureTarget, 0);
+            }
+            glBindTexture(cmd.textureTarget, cmd.texture);
+            textureTarget = cmd.textureTarget;
+            texture = cmd.texture;
+        }
+
+        // The instance index selects the view in the multi-view shaders
+        if (cmd.batch) {
+            cmd.batch->draw(nViews);
+        }
+        else {
+            glDrawArraysInstanced(GL_TRIANGLES, cmd.first, cmd.nVertices, nViews);
+        }
+    }
+
+    if (textureTarget != 0) {
+        glBindTexture(textureTarget, 0);
+    }
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void RenderList::deinitialize() {
+    glDeleteBuffers(1, &_uniformBuffer);
+    _uniformBuffer = 0;
+    _commands.clear();
+}
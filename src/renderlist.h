@@ -0,0 +1,119 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __RENDERLIST_H__
+#define __RENDERLIST_H__
+
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Object;
+class SceneBatch;
+
+// The commands for drawing all objects. Programs and uniform locations are resolved once
+// when the list is initialized, the commands are built once per frame, and the list is
+// then replayed for every viewport. The per-viewport values are written to a uniform
+// buffer and the replay skips all state changes that would not change anything
+class RenderList {
+public:
+    // The number of views that can be rendered in a single pass. Has to match the size
+    // of the mvp array in the ViewportData block of the shaders
+    static constexpr const int MaxViews = 16;
+
+    // Has to be called after the "wall" shader program has been created. The
+    // "wallBatched" program is needed if hasBatchedProgram is true and the programs with
+    // the "MultiView" suffix are needed if hasMultiViewPrograms is true
+    void initialize(bool hasBatchedProgram, bool hasMultiViewPrograms);
+
+    // Records the commands for the next frame. If a batch is passed, it is used instead
+    // of drawing the objects individually; otherwise there is one command for every
+    // material of every object
+    void build(std::vector<Object>& objects, SceneBatch* batch, bool useSpout);
+
+    void draw(const glm::mat4& mvp);
+
+    // Draws all views in a single pass, where view i is rendered into layer i and
+    // viewport i of the bound framebuffer. Only available if the multi-view programs
+    // were initialized
+    void drawViews(const std::vector<glm::mat4>& mvps);
+
+    void deinitialize();
+
+private:
+    struct Program {
+        GLuint singleView = 0;
+        GLuint multiView = 0;
+        // The location of the model matrix uniform in the respective program; the
+        // batched programs take the model matrix as an instanced attribute instead
+        GLint singleViewModel = -1;
+        GLint multiViewModel = -1;
+        // The location of the uniform with the part of the texture coordinates that the
+        // texture covers, which only the programs for individual objects have
+        GLint singleViewUvRect = -1;
+        GLint multiViewUvRect = -1;
+    };
+
+    struct Command {
+        Program program;
+        GLuint vao = 0;
+        GLenum textureTarget = GL_TEXTURE_2D;
+        GLuint texture = 0;
+        GLint first = 0;
+        GLsizei nVertices = 0;
+        glm::mat4 model = glm::mat4(1.f);
+        glm::vec4 uvRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+
+        // Drawn with the batch's indirect draw call instead of nVertices
+        SceneBatch* batch = nullptr;
+        // Spout textures have to be bound through the Spout receiver of the object
+        Object* spoutObject = nullptr;
+    };
+
+    // Matches the std140 layout of the ViewportData block in the shaders
+    struct ViewportData {
+        glm::mat4 mvp[MaxViews];
+        int32_t flipTex = 0;
+        int32_t nViews = 1;
+        int32_t padding[2] = { 0, 0 };
+    };
+
+    void replay(GLuint nViews);
+
+    Program _program;
+    Program _batchedProgram;
+    GLuint _uniformBuffer = 0;
+
+    std::vector<Command> _commands;
+    ViewportData _viewportData;
+};
+
+#endif // __RENDERLIST_H__
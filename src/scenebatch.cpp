@@ -0,0 +1,378 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "scenebatch.h"
+
+#include "object.h"
+#include <sgct/log.h>
+#include <algorithm>
+#include <cstddef>
+
+bool SceneBatch::isSupported() {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    return major > 4 || (major == 4 && minor >= 3);
+}
+
+void SceneBatch::setGeometry(const std::vector<Object>& objects) {
+    if (_vao == 0) {
+        glGenVertexArrays(1, &_vao);
+        glGenBuffers(1, &_vbo);
+        glGenBuffers(1, &_instanceBuffer);
+        glGenBuffers(1, &_indirectBuffer);
+
+        glBindVertexArray(_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, _vbo);
+        setVertexAttributes();
+
+        // Every object is an instance of its mesh, with the transform and the layer of
+        // the object's image as per-instance attributes
+        glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+        glEnableVertexAttribArray(3);
+        glVertexAttribIPointer(
+            3,
+            1,
+            GL_UNSIGNED_INT,
+            sizeof(Instance),
+            reinterpret_cast<void*>(offsetof(Instance, layer))
+        );
+        for (GLuint column = 0; column < 4; ++column) {
+            glEnableVertexAttribArray(4 + column);
+            glVertexAttribPointer(
+                4 + column,
+                4,
+                GL_FLOAT,
+                GL_FALSE,
+                sizeof(Instance),
+                reinterpret_cast<void*>(column * sizeof(glm::vec4))
+            );
+        }
+        setDivisor(_nInstances);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Objects that share a mesh become instances of the same draw, so every mesh is only
+    // stored once. The instances are grouped by mesh in the order in which the meshes
+    // first appear
+    std::vector<const Mesh*> meshes;
+    for (const Object& obj : objects) {
+        if (std::find(meshes.begin(), meshes.end(), obj.mesh.get()) == meshes.end()) {
+            meshes.push_back(obj.mesh.get());
+        }
+    }
+
+    GLsizeiptr totalSize = 0;
+    for (const Mesh* mesh : meshes) {
+        totalSize += sizeof(Vertex) * mesh->nVertices;
+    }
+
+    // Every material of every object has its own layer in the array texture
+    std::vector<GLuint> firstLayer;
+    firstLayer.reserve(objects.size());
+    GLuint nLayers = 0;
+    for (const Object& obj : objects) {
+        firstLayer.push_back(nLayers);
+        nLayers += static_cast<GLuint>(obj.mesh->parts.size());
+    }
+
+    // The geometry is copied on the GPU, so the meshes don't have to keep their
+    // vertices around in main memory
+    _commands.clear();
+    _nObjects.clear();
+    std::vector<Instance> instances;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, _vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STATIC_DRAW);
+    GLuint first = 0;
+    for (const Mesh* mesh : meshes) {
+        glBindBuffer(GL_COPY_READ_BUFFER, mesh->vbo);
+        glCopyBufferSubData(
+            GL_COPY_READ_BUFFER,
+            GL_COPY_WRITE_BUFFER,
+            0,
+            sizeof(Vertex) * first,
+            sizeof(Vertex) * mesh->nVertices
+        );
+
+        // One command per material, as the objects need a different layer for each
+        for (size_t p = 0; p < mesh->parts.size(); ++p) {
+            DrawCommand cmd;
+            cmd.count = mesh->parts[p].nVertices;
+            cmd.first = first + mesh->parts[p].first;
+            cmd.baseInstance = static_cast<GLuint>(instances.size());
+            for (size_t i = 0; i < objects.size(); ++i) {
+                if (objects[i].mesh.get() == mesh) {
+                    Instance instance;
+                    instance.transform = objects[i].transform;
+                    instance.layer = firstLayer[i] + static_cast<GLuint>(p);
+                    instances.push_back(instance);
+                }
+            }
+            const GLuint nObjects =
+                static_cast<GLuint>(instances.size()) - cmd.baseInstance;
+            cmd.instanceCount = nObjects * _nInstances;
+            _commands.push_back(cmd);
+            _nObjects.push_back(nObjects);
+        }
+        first += mesh->nVertices;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        instances.size() * sizeof(Instance),
+        instances.data(),
+        GL_STATIC_DRAW
+    );
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+    glBufferData(
+        GL_DRAW_INDIRECT_BUFFER,
+        _commands.size() * sizeof(DrawCommand),
+        _commands.data(),
+        GL_STATIC_DRAW
+    );
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+bool SceneBatch::updateTextures(const std::vector<Object>& objects) {
+    // The layers are in the same order as in setGeometry
+    _images.clear();
+    _isVisible.clear();
+    for (const Object& obj : objects) {
+        for (size_t p = 0; p < obj.mesh->parts.size(); ++p) {
+            _images.push_back(&obj.images(p));
+            _isVisible.push_back(obj.isVisible);
+        }
+    }
+    if (_layers.size() != _images.size()) {
+        _layers.assign(_images.size(), Layer());
+    }
+
+    for (size_t i = 0; i < _images.size(); ++i) {
+        const ImageCache& cache = *_images[i];
+        Layer& layer = _layers[i];
+        if (!layer.isDirty && layer.texture == cache.texture() &&
+            layer.version == cache.textureVersion())
+        {
+            continue;
+        }
+
+        layer.texture = cache.texture();
+        layer.version = cache.textureVersion();
+        layer.isDirty = true;
+        if (layer.texture == 0) {
+            continue;
+        }
+
+        // Only queried when the texture changes as querying the state might stall
+        GLint maxLevel = 0;
+        glBindTexture(GL_TEXTURE_2D, layer.texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &layer.size.x);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &layer.size.y);
+        glGetTexLevelParameteriv(
+            GL_TEXTURE_2D,
+            0,
+            GL_TEXTURE_INTERNAL_FORMAT,
+            &layer.internalFormat
+        );
+        glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        int nLevels = 1;
+        while ((std::max(layer.size.x, layer.size.y) >> nLevels) > 0) {
+            nLevels++;
+        }
+        layer.nLevels = std::min(nLevels, maxLevel + 1);
+    }
+
+    // All layers of an array texture share the same size and format. A material without
+    // an image would show an uninitialized layer, so the objects are drawn on their own.
+    // Objects that are out of view release their images, so their layers are skipped and
+    // keep whatever they contained, as nothing of them ends up in the viewports.
+    // The batched shaders also can't show images that only cover a region of a tiled
+    // image
+    const Layer* reference = nullptr;
+    for (size_t i = 0; i < _layers.size(); ++i) {
+        const Layer& layer = _layers[i];
+        if (!_isVisible[i]) {
+            continue;
+        }
+        if (layer.texture == 0) {
+            return false;
+        }
+
+        const glm::vec4 uvRect = _images[i]->uvRect();
+        if (uvRect.x != 0.f || uvRect.y != 0.f || uvRect.z != 1.f || uvRect.w != 1.f) {
+            return false;
+        }
+        if (!reference) {
+            reference = &layer;
+        }
+        else if (layer.size != reference->size ||
+            layer.internalFormat != reference->internalFormat ||
+            layer.nLevels != reference->nLevels)
+        {
+            return false;
+        }
+    }
+    if (!reference) {
+        return false;
+    }
+
+    if (_textureArray == 0 || _size != reference->size ||
+        _internalFormat != reference->internalFormat || _nLevels != reference->nLevels)
+    {
+        glDeleteTextures(1, &_textureArray);
+        _size = reference->size;
+        _internalFormat = reference->internalFormat;
+        _nLevels = reference->nLevels;
+
+        glGenTextures(1, &_textureArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, _textureArray);
+        glTexStorage3D(
+            GL_TEXTURE_2D_ARRAY,
+            _nLevels,
+            _internalFormat,
+            _size.x,
+            _size.y,
+            static_cast<GLsizei>(_layers.size())
+        );
+        glTexParameteri(
+            GL_TEXTURE_2D_ARRAY,
+            GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR
+        );
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, _nLevels - 1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        for (Layer& layer : _layers) {
+            layer.isDirty = true;
+        }
+    }
+
+    // The mipmaps of the source textures have already been generated, so copying all
+    // levels is cheaper than generating the mipmaps of the array texture again
+    for (size_t i = 0; i < _layers.size(); ++i) {
+        Layer& layer = _layers[i];
+        if (!layer.isDirty || !_isVisible[i]) {
+            continue;
+        }
+
+        for (GLint level = 0; level < _nLevels; ++level) {
+            glCopyImageSubData(
+                layer.texture,
+                GL_TEXTURE_2D,
+                level,
+                0,
+                0,
+                0,
+                _textureArray,
+                GL_TEXTURE_2D_ARRAY,
+                level,
+                0,
+                0,
+                static_cast<GLint>(i),
+                std::max(_size.x >> level, 1),
+                std::max(_size.y >> level, 1),
+                1
+            );
+        }
+        layer.isDirty = false;
+    }
+    return true;
+}
+
+GLuint SceneBatch::vertexArray() const {
+    return _vao;
+}
+
+GLuint SceneBatch::texture() const {
+    return _textureArray;
+}
+
+void SceneBatch::draw(GLuint nInstances) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+    if (nInstances != _nInstances) {
+        // The divisor keeps consecutive instances of a draw on the same object, the
+        // instance index modulo nInstances is used to select the view
+        _nInstances = nInstances;
+        setDivisor(_nInstances);
+        for (size_t i = 0; i < _commands.size(); ++i) {
+            _commands[i].instanceCount = _nObjects[i] * _nInstances;
+        }
+        glBufferSubData(
+            GL_DRAW_INDIRECT_BUFFER,
+            0,
+            _commands.size() * sizeof(DrawCommand),
+            _commands.data()
+        );
+    }
+
+    glMultiDrawArraysIndirect(
+        GL_TRIANGLES,
+        nullptr,
+        static_cast<GLsizei>(_commands.size()),
+        0
+    );
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void SceneBatch::setDivisor(GLuint divisor) {
+    for (GLuint location = 3; location < 8; ++location) {
+        glVertexAttribDivisor(location, divisor);
+    }
+}
+
+void SceneBatch::deinitialize() {
+    glDeleteVertexArrays(1, &_vao);
+    glDeleteBuffers(1, &_vbo);
+    glDeleteBuffers(1, &_instanceBuffer);
+    glDeleteBuffers(1, &_indirectBuffer);
+    glDeleteTextures(1, &_textureArray);
+    _vao = 0;
+    _vbo = 0;
+    _instanceBuffer = 0;
+    _indirectBuffer = 0;
+    _textureArray = 0;
+    _layers.clear();
+    _images.clear();
+    _commands.clear();
+    _nObjects.clear();
+    _nInstances = 1;
+}
@@ -0,0 +1,117 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __SCENEBATCH_H__
+#define __SCENEBATCH_H__
+
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+class ImageCache;
+struct Object;
+
+// Draws all objects with a single draw call. The geometry of all meshes is copied into
+// one shared vertex buffer and the current image of each material of each object into
+// one layer of an array texture, so that a single glMultiDrawArraysIndirect can render
+// the whole scene. This keeps the cost of drawing a viewport independent of the number
+// of objects. Objects that share a mesh are instances of the same draws; the layer and
+// the transform are passed as instanced vertex attributes at the locations 3 and 4-7
+class SceneBatch {
+public:
+    // Returns whether the current OpenGL context supports indirect multi-draws and image
+    // copies, which are both part of OpenGL 4.3
+    static bool isSupported();
+
+    // Has to be called whenever the geometry of any object has changed
+    void setGeometry(const std::vector<Object>& objects);
+
+    // Copies the images that have changed since the last call into the array texture.
+    // Returns false if the objects can't be drawn together at the moment because their
+    // images differ in size or format or an object has no image
+    bool updateTextures(const std::vector<Object>& objects);
+
+    GLuint vertexArray() const;
+    GLuint texture() const;
+
+    // Issues the draw call with each object being drawn nInstances times in a row. The
+    // vertex array and texture have to be bound already
+    void draw(GLuint nInstances);
+    void deinitialize();
+
+private:
+    // Sets the divisor of all per-instance attributes of the bound vertex array
+    void setDivisor(GLuint divisor);
+
+    // The layout of the commands in the indirect buffer as defined by OpenGL
+    struct DrawCommand {
+        GLuint count = 0;
+        GLuint instanceCount = 0;
+        GLuint first = 0;
+        GLuint baseInstance = 0;
+    };
+
+    struct Instance {
+        glm::mat4 transform = glm::mat4(1.f);
+        GLuint layer = 0;
+    };
+
+    struct Layer {
+        GLuint texture = 0;
+        uint32_t version = 0;
+        bool isDirty = true;
+
+        glm::ivec2 size = glm::ivec2(0);
+        GLint internalFormat = 0;
+        GLint nLevels = 0;
+    };
+
+    GLuint _vao = 0;
+    GLuint _vbo = 0;
+    GLuint _instanceBuffer = 0;
+    GLuint _indirectBuffer = 0;
+    std::vector<DrawCommand> _commands;
+    // The number of objects that are drawn by each command
+    std::vector<GLuint> _nObjects;
+    GLuint _nInstances = 1;
+
+    GLuint _textureArray = 0;
+    glm::ivec2 _size = glm::ivec2(0);
+    GLint _internalFormat = 0;
+    GLint _nLevels = 0;
+    std::vector<Layer> _layers;
+    // The images of the layers, which is only kept to avoid reallocating it every frame
+    std::vector<const ImageCache*> _images;
+    // Whether the object of each layer is in view on this node
+    std::vector<bool> _isVisible;
+};
+
+#endif // __SCENEBATCH_H__
@@ -0,0 +1,580 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "sequenceindex.h"
+
+#include "tiledimage.h"
+#include "workerpool.h"
+#include <sgct/log.h>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+namespace {
+    constexpr const char* ManifestName = ".sequence-manifest";
+    constexpr const char* ManifestHeader = "SequenceManifest 1";
+    // The folder time is written with a fixed width so that it can be updated in place
+    constexpr const int FolderTimeWidth = 24;
+
+    // The interval in which the folder's modification time is checked in case the file
+    // system does not support change notifications, which is true for most network
+    // file systems
+    constexpr const std::chrono::seconds PollInterval = std::chrono::seconds(1);
+    // While images keep being added, the manifest is rewritten at most this often
+    constexpr const std::chrono::seconds ManifestInterval = std::chrono::seconds(10);
+
+    namespace fs = std::filesystem;
+
+    bool WritesManifest = true;
+
+    int64_t fileTime(const fs::path& path) {
+        std::error_code ec;
+        const fs::file_time_type t = fs::last_write_time(path, ec);
+        return ec ? 0 : static_cast<int64_t>(t.time_since_epoch().count());
+    }
+
+    // Hidden files, such as the manifest and its temporary copies, are not images
+    bool isSequenceFile(const fs::path& path) {
+        const std::string filename = path.filename().string();
+        return !filename.empty() && filename[0] != '.';
+    }
+
+    bool isSameEntry(const SequenceIndex::Entry& lhs, const SequenceIndex::Entry& rhs) {
+        return lhs.name == rhs.name && lhs.fileSize == rhs.fileSize &&
+            lhs.lastWriteTime == rhs.lastWriteTime && lhs.size == rhs.size;
+    }
+
+    uint32_t readBigEndian(const unsigned char* p, int nBytes) {
+        uint32_t res = 0;
+        for (int i = 0; i < nBytes; ++i) {
+            res = (res << 8) | p[i];
+        }
+        return res;
+    }
+
+    // Reads the dimensions of PNG and JPEG files from their headers without decoding them
+    glm::ivec2 readImageSize(const fs::path& path) {
+        std::ifstream f(path, std::ios::binary);
+        std::array<unsigned char, 24> header = {};
+        f.read(reinterpret_cast<char*>(header.data()), header.size());
+        if (!f.good()) {
+            return glm::ivec2(0);
+        }
+
+        constexpr const std::array<unsigned char, 8> PngSignature = {
+            0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'
+        };
+        if (std::equal(PngSignature.begin(), PngSignature.end(), header.begin())) {
+            // The IHDR chunk is always the first one
+            return glm::ivec2(
+                static_cast<int>(readBigEndian(&header[16], 4)),
+                static_cast<int>(readBigEndian(&header[20], 4))
+            );
+        }
+
+        if (header[0] == 0xFF && header[1] == 0xD8) {
+            // Walk the JPEG segments until we find a start-of-frame marker
+            f.seekg(2);
+            std::array<unsigned char, 9> segment;
+            while (f.read(reinterpret_cast<char*>(segment.data()), 4)) {
+                if (segment[0] != 0xFF) {
+                    break;
+                }
+                const unsigned char marker = segment[1];
+                const uint32_t length = readBigEndian(&segment[2], 2);
+                const bool isStartOfFrame = marker >= 0xC0 && marker <= 0xCF &&
+                    marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+                if (isStartOfFrame) {
+                    f.read(reinterpret_cast<char*>(&segment[4]), 5);
+                    if (!f.good()) {
+                        break;
+                    }
+                    return glm::ivec2(
+                        static_cast<int>(readBigEndian(&segment[7], 2)),
+                        static_cast<int>(readBigEndian(&segment[5], 2))
+                    );
+                }
+                f.seekg(length - 2, std::ios::cur);
+            }
+        }
+
+        return glm::ivec2(0);
+    }
+
+    SequenceIndex::Entry inspectFile(const fs::path& path) {
+        SequenceIndex::Entry e;
+        e.name = path.filename().string();
+        std::error_code ec;
+        e.fileSize = fs::file_size(path, ec);
+        e.lastWriteTime = fileTime(path);
+        e.size = TiledImage::isTiledImage(path) ?
+            readTiledImageSize(path) :
+            readImageSize(path);
+        return e;
+    }
+
+    bool isBefore(const SequenceIndex::Entry& entry, const std::string& name) {
+        return naturalLess(entry.name, name);
+    }
+
+    // Records that the images from the index on have moved
+    void markMoved(SequenceIndex::Changes& changes, uint32_t image) {
+        changes.firstMovedImage = changes.hasNewList ?
+            std::min(changes.firstMovedImage, image) :
+            image;
+        changes.hasNewList = true;
+    }
+
+    // Lists the folder and reuses the information of the files that are in the sorted
+    // list of previous entries
+    std::vector<SequenceIndex::Entry> listFolder(const fs::path& folder,
+                                     const std::vector<SequenceIndex::Entry>& previous)
+    {
+        std::vector<SequenceIndex::Entry> entries;
+        entries.reserve(previous.size());
+        std::error_code ec;
+        for (const fs::directory_entry& entry : fs::directory_iterator(folder, ec)) {
+            if (!entry.is_regular_file(ec) || !isSequenceFile(entry.path())) {
+                continue;
+            }
+
+            const std::string name = entry.path().filename().string();
+            auto it = std::lower_bound(previous.begin(), previous.end(), name, isBefore);
+            if (it != previous.end() && it->name == name) {
+                entries.push_back(*it);
+            }
+            else {
+                entries.push_back(inspectFile(entry.path()));
+            }
+        }
+        if (ec) {
+            sgct::Log::Error(
+                "Error listing image folder %s: %s",
+                folder.string().c_str(), ec.message().c_str()
+            );
+        }
+
+        std::sort(
+            entries.begin(),
+            entries.end(),
+            [](const SequenceIndex::Entry& lhs, const SequenceIndex::Entry& rhs) {
+                return naturalLess(lhs.name, rhs.name);
+            }
+        );
+        return entries;
+    }
+
+    // Writes the entries that were listed when the folder had the provided modification
+    // time and returns the time of the folder that the entries are up to date with
+    int64_t writeManifest(const fs::path& folder,
+                          const std::vector<SequenceIndex::Entry>& entries,
+                          int64_t folderTime)
+    {
+        // Write to a temporary file first so that other nodes never see a partial
+        // manifest. The name is unique to this process in case another one writes at
+        // the same time
+        static const std::string Suffix = ".tmp" + std::to_string(std::random_device()());
+        const fs::path manifest = folder / ManifestName;
+        fs::path tmp = manifest;
+        tmp += Suffix;
+        {
+            std::ofstream f(tmp);
+            if (!f.good()) {
+                sgct::Log::Warning(
+                    "Could not write manifest for image folder %s",
+                    folder.string().c_str()
+                );
+                return folderTime;
+            }
+
+            f << ManifestHeader << '\n' << std::setw(FolderTimeWidth) << 0 << '\n';
+            for (const SequenceIndex::Entry& e : entries) {
+                f << e.name << '\t' << e.fileSize << '\t' << e.lastWriteTime << '\t' <<
+                    e.size.x << '\t' << e.size.y << '\n';
+            }
+        }
+
+        std::error_code ec;
+        fs::rename(tmp, manifest, ec);
+        if (ec) {
+            fs::remove(tmp, ec);
+            return folderTime;
+        }
+
+        // Writing the manifest has changed the folder's modification time, so we record
+        // the new time. Overwriting the content of an existing file does not change the
+        // time again. Files that were added since we listed the folder are missed until
+        // the next change to the folder
+        const int64_t newFolderTime = fileTime(folder);
+        std::fstream f(manifest, std::ios::in | std::ios::out);
+        f.seekp(std::char_traits<char>::length(ManifestHeader) + 1);
+        f << std::setw(FolderTimeWidth) << newFolderTime;
+        return newFolderTime;
+    }
+} // namespace
+
+bool naturalLess(const std::string& lhs, const std::string& rhs) {
+    auto isDigit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)); };
+
+    size_t i = 0;
+    size_t j = 0;
+    while (i < lhs.size() && j < rhs.size()) {
+        if (isDigit(lhs[i]) && isDigit(rhs[j])) {
+            // Compare the numbers by value by ignoring leading zeros and then comparing
+            // first the number of digits and then the digits themselves
+            while (i < lhs.size() && lhs[i] == '0') {
+                ++i;
+            }
+            while (j < rhs.size() && rhs[j] == '0') {
+                ++j;
+            }
+            size_t iEnd = i;
+            while (iEnd < lhs.size() && isDigit(lhs[iEnd])) {
+                ++iEnd;
+            }
+            size_t jEnd = j;
+            while (jEnd < rhs.size() && isDigit(rhs[jEnd])) {
+                ++jEnd;
+            }
+
+            if (iEnd - i != jEnd - j) {
+                return iEnd - i < jEnd - j;
+            }
+            const int cmp = lhs.compare(i, iEnd - i, rhs, j, jEnd - j);
+            if (cmp != 0) {
+                return cmp < 0;
+            }
+            i = iEnd;
+            j = jEnd;
+        }
+        else {
+            if (lhs[i] != rhs[j]) {
+                return lhs[i] < rhs[j];
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    if (i == lhs.size() && j == rhs.size()) {
+        // Equal apart from leading zeros, so fall back to a plain comparison to have a
+        // strict ordering
+        return lhs < rhs;
+    }
+    return i == lhs.size();
+}
+
+void SequenceIndex::setWritesManifest(bool writesManifest) {
+    WritesManifest = writesManifest;
+}
+
+SequenceIndex::SequenceIndex(fs::path folder)
+    : _folder(std::move(folder))
+    , _entries(std::make_shared<std::vector<Entry>>())
+{
+    if (_folder.empty()) {
+        return;
+    }
+
+    if (!readManifest()) {
+        sgct::Log::Info("Indexing image folder %s", _folder.string().c_str());
+        _folderTime = fileTime(_folder);
+        *_entries = listFolder(_folder, {});
+        _isManifestOutdated = true;
+    }
+}
+
+SequenceIndex::Changes SequenceIndex::update() {
+    Changes res;
+    if (_folder.empty()) {
+        return res;
+    }
+
+    if (!_watcher) {
+        // The watcher is created lazily so that the index can be moved around freely
+        // until it is used
+        _watcher = std::make_unique<FileWatcher>();
+        _watcher->watchDirectory(_folder);
+        _lastCheck = std::chrono::steady_clock::now();
+    }
+
+    // The modified files are collected by name as the indices can still shift
+    std::vector<std::string> modifiedFiles;
+    if (_job) {
+        std::unique_lock lock(_job->mutex);
+        if (_job->isDone) {
+            if (!_job->isListing) {
+                _folderTime = _job->folderTime;
+                _isManifestOutdated |= _job->isManifestSkipped;
+            }
+            else if (_job->version == _version) {
+                // A listing that started from entries that have changed since is
+                // discarded, and the folder is listed again if it is still out of date
+                _folderTime = _job->folderTime;
+                if (_job->hasChanged) {
+                    _entries = std::make_shared<std::vector<Entry>>(
+                        std::move(_job->entries)
+                    );
+                    _version++;
+                    // Rewriting an unchanged manifest would change the folder again
+                    _isManifestOutdated = true;
+                }
+                res.hasNewList = _job->hasNewList;
+                res.firstMovedImage = _job->firstMovedImage;
+                modifiedFiles = std::move(_job->modifiedFiles);
+            }
+            lock.unlock();
+            _job = nullptr;
+        }
+    }
+
+    std::vector<std::string> changed;
+    for (const fs::path& p : _watcher->changedFiles()) {
+        if (isSequenceFile(p)) {
+            changed.push_back(p.filename().string());
+        }
+    }
+    if (!changed.empty()) {
+        applyChanges(changed, res, modifiedFiles);
+        // The changes are known already, so the folder does not have to be listed
+        _folderTime = fileTime(_folder);
+    }
+
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!_job && now - _lastCheck > PollInterval) {
+        _lastCheck = now;
+        if (fileTime(_folder) != _folderTime) {
+            startListing();
+        }
+    }
+    if (!_job && _isManifestOutdated && WritesManifest &&
+        now - _lastManifestWrite > ManifestInterval)
+    {
+        _lastManifestWrite = now;
+        startManifestWrite();
+    }
+
+    if (res.hasNewList) {
+        sgct::Log::Info(
+            "Image folder %s changed, now %i images",
+            _folder.string().c_str(), static_cast<int>(_entries->size())
+        );
+    }
+    for (const std::string& name : modifiedFiles) {
+        auto it = std::lower_bound(_entries->begin(), _entries->end(), name, isBefore);
+        if (it != _entries->end() && it->name == name) {
+            res.modifiedImages.push_back(static_cast<uint32_t>(it - _entries->begin()));
+        }
+    }
+    return res;
+}
+
+const fs::path& SequenceIndex::folder() const {
+    return _folder;
+}
+
+const std::vector<SequenceIndex::Entry>& SequenceIndex::entries() const {
+    return *_entries;
+}
+
+std::vector<fs::path> SequenceIndex::paths() const {
+    std::vector<fs::path> res;
+    res.reserve(_entries->size());
+    for (const Entry& e : *_entries) {
+        res.push_back(_folder / e.name);
+    }
+    return res;
+}
+
+void SequenceIndex::applyChanges(const std::vector<std::string>& changedFiles,
+                                 Changes& changes,
+                                 std::vector<std::string>& modifiedFiles)
+{
+    for (const std::string& name : changedFiles) {
+        // The entries are only looked up here, as modifying them might copy them
+        const std::vector<Entry>& entries = *_entries;
+        auto it = std::lower_bound(entries.begin(), entries.end(), name, isBefore);
+        const size_t i = it - entries.begin();
+        const bool isKnown = it != entries.end() && it->name == name;
+
+        const fs::path path = _folder / name;
+        std::error_code ec;
+        if (fs::is_regular_file(path, ec)) {
+            Entry entry = inspectFile(path);
+            if (!isKnown) {
+                std::vector<Entry>& e = modifiableEntries();
+                e.insert(e.begin() + i, std::move(entry));
+                markMoved(changes, static_cast<uint32_t>(i));
+            }
+            else if (!isSameEntry(*it, entry)) {
+                modifiableEntries()[i] = std::move(entry);
+                modifiedFiles.push_back(name);
+            }
+            else {
+                continue;
+            }
+        }
+        else if (isKnown) {
+            std::vector<Entry>& e = modifiableEntries();
+            e.erase(e.begin() + i);
+            markMoved(changes, static_cast<uint32_t>(i));
+        }
+        else {
+            continue;
+        }
+        _isManifestOutdated = true;
+    }
+}
+
+std::vector<SequenceIndex::Entry>& SequenceIndex::modifiableEntries() {
+    if (_entries.use_count() > 1) {
+        _entries = std::make_shared<std::vector<Entry>>(*_entries);
+    }
+    _version++;
+    return *_entries;
+}
+
+void SequenceIndex::startListing() {
+    _job = std::make_shared<Job>();
+    _job->isListing = true;
+    _job->version = _version;
+    std::shared_ptr<const std::vector<Entry>> previous = _entries;
+    backgroundWorkers().enqueue([job = _job, folder = _folder, previous]() {
+        // Read the time before listing so that files that are added while we are
+        // listing cause another listing later
+        const int64_t folderTime = fileTime(folder);
+        std::vector<Entry> entries = listFolder(folder, *previous);
+
+        auto isSameName = [](const Entry& lhs, const Entry& rhs) {
+            return lhs.name == rhs.name;
+        };
+        const size_t firstMoved = std::mismatch(
+            previous->begin(), previous->end(),
+            entries.begin(), entries.end(),
+            isSameName
+        ).first - previous->begin();
+        const bool hasNewList = previous->size() != entries.size() ||
+            firstMoved != previous->size();
+        std::vector<std::string> modifiedFiles;
+        if (!hasNewList) {
+            for (size_t i = 0; i < entries.size(); ++i) {
+                if (entries[i].fileSize != (*previous)[i].fileSize ||
+                    entries[i].lastWriteTime != (*previous)[i].lastWriteTime)
+                {
+                    modifiedFiles.push_back(entries[i].name);
+                }
+            }
+        }
+        const bool hasChanged = !std::equal(
+            previous->begin(), previous->end(),
+            entries.begin(), entries.end(),
+            isSameEntry
+        );
+
+        std::lock_guard lock(job->mutex);
+        job->folderTime = folderTime;
+        job->entries = std::move(entries);
+        job->hasChanged = hasChanged;
+        job->hasNewList = hasNewList;
+        job->firstMovedImage = static_cast<uint32_t>(firstMoved);
+        job->modifiedFiles = std::move(modifiedFiles);
+        job->isDone = true;
+    });
+}
+
+void SequenceIndex::startManifestWrite() {
+    // A manifest that can't be written is only tried again once the folder changes
+    _isManifestOutdated = false;
+    _job = std::make_shared<Job>();
+    _job->version = _version;
+    std::shared_ptr<const std::vector<Entry>> entries = _entries;
+    backgroundWorkers().enqueue([job = _job, folder = _folder, entries,
+                                 listedTime = _folderTime]()
+    {
+        // Files that were added since the folder was listed have to be listed first
+        const bool isListed = fileTime(folder) == listedTime;
+        const int64_t folderTime =
+            isListed ? writeManifest(folder, *entries, listedTime) : listedTime;
+
+        std::lock_guard lock(job->mutex);
+        job->folderTime = folderTime;
+        job->isManifestSkipped = !isListed;
+        job->isDone = true;
+    });
+}
+
+bool SequenceIndex::readManifest() {
+    std::ifstream f(_folder / ManifestName);
+    if (!f.good()) {
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(f, line) || line != ManifestHeader) {
+        return false;
+    }
+
+    int64_t folderTime = 0;
+    if (!std::getline(f, line)) {
+        return false;
+    }
+    std::istringstream(line) >> folderTime;
+
+    std::vector<Entry> entries;
+    while (std::getline(f, line)) {
+        const size_t tab = line.find('\t');
+        if (tab == std::string::npos) {
+            return false;
+        }
+        Entry e;
+        e.name = line.substr(0, tab);
+        std::istringstream(line.substr(tab + 1)) >>
+            e.fileSize >> e.lastWriteTime >> e.size.x >> e.size.y;
+        entries.push_back(std::move(e));
+    }
+
+    if (folderTime != fileTime(_folder)) {
+        // Files were added or removed since the manifest was written, so we use it as a
+        // starting point and only inspect the new files
+        sgct::Log::Info("Updating image folder index %s", _folder.string().c_str());
+        _folderTime = fileTime(_folder);
+        *_entries = listFolder(_folder, entries);
+        _isManifestOutdated = true;
+    }
+    else {
+        _folderTime = folderTime;
+        *_entries = std::move(entries);
+    }
+    return true;
+}
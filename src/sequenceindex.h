@@ -0,0 +1,131 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __SEQUENCEINDEX_H__
+#define __SEQUENCEINDEX_H__
+
+#include "filewatcher.h"
+#include <glm/glm.hpp>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The sorted list of images in an image sequence folder. Listing a folder with hundreds
+// of thousands of files is slow on network storage, so the index is stored in a
+// manifest file inside the folder. As long as the folder's modification time has not
+// changed, the manifest is used as-is; otherwise only the files that are new are
+// inspected and the manifest is rewritten in the background
+class SequenceIndex {
+public:
+    // Only one node of the cluster should write the manifests, as the nodes would
+    // otherwise keep picking up each other's changes to the folder. The other nodes only
+    // read them
+    static void setWritesManifest(bool writesManifest);
+
+    struct Entry {
+        std::string name;
+        uint64_t fileSize = 0;
+        int64_t lastWriteTime = 0;
+        // Is 0 if the dimensions could not be determined from the file header
+        glm::ivec2 size = glm::ivec2(0);
+    };
+
+    struct Changes {
+        // Files were added or removed, so the indices of the images from firstMovedImage
+        // on might have shifted. The images before it have kept their index and file
+        bool hasNewList = false;
+        uint32_t firstMovedImage = 0;
+        // The indices of images whose files have been modified in place
+        std::vector<uint32_t> modifiedImages;
+    };
+
+    explicit SequenceIndex(std::filesystem::path folder);
+
+    // Picks up files that were added, changed, or removed while running. The files that
+    // the file watcher reports are applied right away. Listing the folder, for file
+    // systems without change notifications, and writing the manifest happen in the
+    // background, and the listing is picked up by a later update
+    Changes update();
+
+    const std::filesystem::path& folder() const;
+    const std::vector<Entry>& entries() const;
+    std::vector<std::filesystem::path> paths() const;
+
+private:
+    // The state that is shared with the job that lists the folder or writes the manifest
+    // in the background. Only one job runs at a time
+    struct Job {
+        std::mutex mutex;
+        bool isDone = false;
+        bool isListing = false;
+        bool isManifestSkipped = false;
+        // The version of the entries that the job started from
+        uint32_t version = 0;
+        int64_t folderTime = 0;
+
+        // The result of a listing and how it differs from the entries it started from
+        std::vector<Entry> entries;
+        bool hasChanged = false;
+        bool hasNewList = false;
+        uint32_t firstMovedImage = 0;
+        std::vector<std::string> modifiedFiles;
+    };
+
+    // Inserts, replaces, or removes the entries of the changed files in place
+    void applyChanges(const std::vector<std::string>& changedFiles,
+        Changes& changes, std::vector<std::string>& modifiedFiles);
+    void startListing();
+    void startManifestWrite();
+    bool readManifest();
+
+    // The entries are copied before they are modified if a job still reads them
+    std::vector<Entry>& modifiableEntries();
+
+    std::filesystem::path _folder;
+    int64_t _folderTime = 0;
+    std::shared_ptr<std::vector<Entry>> _entries;
+    // Is increased whenever the entries change, so that outdated listings are discarded
+    uint32_t _version = 0;
+    bool _isManifestOutdated = false;
+    std::chrono::steady_clock::time_point _lastManifestWrite;
+
+    std::shared_ptr<Job> _job;
+    std::unique_ptr<FileWatcher> _watcher;
+    std::chrono::steady_clock::time_point _lastCheck;
+};
+
+// Compares two file names such that embedded numbers are ordered by their value, so
+// that 'frame2.png' is sorted before 'frame10.png'
+bool naturalLess(const std::string& lhs, const std::string& rhs);
+
+#endif // __SEQUENCEINDEX_H__
@@ -0,0 +1,324 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "socket.h"
+
+#include <stdexcept>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else // WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif // WIN32
+
+namespace {
+#ifdef __linux__
+    // Writing to a connection that was closed by the other side must not raise SIGPIPE
+    constexpr const int SendFlags = MSG_NOSIGNAL;
+#else // __linux__
+    constexpr const int SendFlags = 0;
+#endif // __linux__
+
+#ifdef WIN32
+    constexpr const uintptr_t InvalidSocket = static_cast<uintptr_t>(INVALID_SOCKET);
+
+    struct WinsockInitializer {
+        WinsockInitializer() {
+            WSADATA data;
+            WSAStartup(MAKEWORD(2, 2), &data);
+        }
+        ~WinsockInitializer() {
+            WSACleanup();
+        }
+    };
+
+    void closeSocket(uintptr_t s) {
+        closesocket(static_cast<SOCKET>(s));
+    }
+
+    bool isValid(uintptr_t s) {
+        return static_cast<SOCKET>(s) != INVALID_SOCKET;
+    }
+
+    void setNonBlocking(uintptr_t s) {
+        u_long mode = 1;
+        ioctlsocket(static_cast<SOCKET>(s), FIONBIO, &mode);
+    }
+
+    bool wouldBlock() {
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+    }
+#else // WIN32
+    constexpr const int InvalidSocket = -1;
+
+    void closeSocket(int s) {
+        close(s);
+    }
+
+    bool isValid(int s) {
+        return s >= 0;
+    }
+
+    void setNonBlocking(int s) {
+        fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    bool wouldBlock() {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+#endif // WIN32
+} // namespace
+
+UdpSocket::UdpSocket() {
+#ifdef WIN32
+    static WinsockInitializer Winsock;
+#endif // WIN32
+
+    _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (!isValid(_socket)) {
+        throw std::runtime_error("Could not create socket");
+    }
+    setNonBlocking(_socket);
+}
+
+UdpSocket::~UdpSocket() {
+    closeSocket(_socket);
+}
+
+void UdpSocket::bind(uint16_t port) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    const int res = ::bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    if (res != 0) {
+        throw std::runtime_error("Could not bind socket to port " + std::to_string(port));
+    }
+}
+
+void UdpSocket::connect(const std::string& address, uint16_t port) {
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* info = nullptr;
+    const std::string service = std::to_string(port);
+    if (getaddrinfo(address.c_str(), service.c_str(), &hints, &info) != 0) {
+        throw std::runtime_error("Could not resolve address " + address);
+    }
+
+    const int res = ::connect(
+        _socket,
+        info->ai_addr,
+        static_cast<int>(info->ai_addrlen)
+    );
+    freeaddrinfo(info);
+    if (res != 0) {
+        throw std::runtime_error("Could not connect socket to " + address);
+    }
+}
+
+void UdpSocket::send(const void* data, size_t size) {
+    // Datagrams are fire-and-forget, a lost package is superseded by the next one
+    ::send(_socket, reinterpret_cast<const char*>(data), static_cast<int>(size), 0);
+}
+
+size_t UdpSocket::receive(void* buffer, size_t size) {
+    const auto res = recv(
+        _socket,
+        reinterpret_cast<char*>(buffer),
+        static_cast<int>(size),
+        0
+    );
+    return res > 0 ? static_cast<size_t>(res) : 0;
+}
+
+TcpConnection TcpConnection::connect(const std::string& address, uint16_t port) {
+#ifdef WIN32
+    static WinsockInitializer Winsock;
+#endif // WIN32
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    addrinfo* info = nullptr;
+    const std::string service = std::to_string(port);
+    if (getaddrinfo(address.c_str(), service.c_str(), &hints, &info) != 0) {
+        throw std::runtime_error("Could not resolve address " + address);
+    }
+
+    const SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValid(s)) {
+        freeaddrinfo(info);
+        throw std::runtime_error("Could not create socket");
+    }
+    const int res = ::connect(s, info->ai_addr, static_cast<int>(info->ai_addrlen));
+    freeaddrinfo(info);
+    if (res != 0) {
+        closeSocket(s);
+        throw std::runtime_error("Could not connect to " + address);
+    }
+    return TcpConnection(s);
+}
+
+TcpConnection::TcpConnection(SocketHandle socket)
+    : _socket(socket)
+{
+    setNonBlocking(_socket);
+
+    // Small messages are sent in one piece, so delaying them to combine them with later
+    // ones only adds latency
+    const int noDelay = 1;
+    setsockopt(
+        _socket,
+        IPPROTO_TCP,
+        TCP_NODELAY,
+        reinterpret_cast<const char*>(&noDelay),
+        sizeof(noDelay)
+    );
+}
+
+TcpConnection::~TcpConnection() {
+    if (isValid(_socket)) {
+        closeSocket(_socket);
+    }
+}
+
+TcpConnection::TcpConnection(TcpConnection&& rhs)
+    : _socket(rhs._socket)
+    , _isOpen(rhs._isOpen)
+{
+    rhs._socket = InvalidSocket;
+    rhs._isOpen = false;
+}
+
+TcpConnection& TcpConnection::operator=(TcpConnection&& rhs) {
+    if (this != &rhs) {
+        if (isValid(_socket)) {
+            closeSocket(_socket);
+        }
+        _socket = rhs._socket;
+        _isOpen = rhs._isOpen;
+        rhs._socket = InvalidSocket;
+        rhs._isOpen = false;
+    }
+    return *this;
+}
+
+size_t TcpConnection::send(const void* data, size_t size) {
+    if (!_isOpen) {
+        return 0;
+    }
+    const auto res = ::send(
+        _socket,
+        reinterpret_cast<const char*>(data),
+        static_cast<int>(size),
+        SendFlags
+    );
+    if (res < 0) {
+        _isOpen = wouldBlock();
+        return 0;
+    }
+    return static_cast<size_t>(res);
+}
+
+size_t TcpConnection::receive(void* buffer, size_t size) {
+    if (!_isOpen) {
+        return 0;
+    }
+    const auto res = recv(
+        _socket,
+        reinterpret_cast<char*>(buffer),
+        static_cast<int>(size),
+        0
+    );
+    if (res == 0 || (res < 0 && !wouldBlock())) {
+        _isOpen = false;
+    }
+    return res > 0 ? static_cast<size_t>(res) : 0;
+}
+
+bool TcpConnection::isOpen() const {
+    return _isOpen;
+}
+
+TcpListener::TcpListener(uint16_t port, bool localOnly) {
+#ifdef WIN32
+    static WinsockInitializer Winsock;
+#endif // WIN32
+
+    _socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (!isValid(_socket)) {
+        throw std::runtime_error("Could not create socket");
+    }
+    setNonBlocking(_socket);
+
+    // Allows restarting the application while connections of the previous run linger
+    const int reuse = 1;
+    setsockopt(
+        _socket,
+        SOL_SOCKET,
+        SO_REUSEADDR,
+        reinterpret_cast<const char*>(&reuse),
+        sizeof(reuse)
+    );
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(localOnly ? INADDR_LOOPBACK : INADDR_ANY);
+    addr.sin_port = htons(port);
+
+    const int res = ::bind(_socket, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    if (res != 0 || ::listen(_socket, SOMAXCONN) != 0) {
+        closeSocket(_socket);
+        throw std::runtime_error("Could not listen on port " + std::to_string(port));
+    }
+}
+
+TcpListener::~TcpListener() {
+    closeSocket(_socket);
+}
+
+std::optional<TcpConnection> TcpListener::accept() {
+    const SocketHandle s = ::accept(_socket, nullptr, nullptr);
+    if (!isValid(s)) {
+        return std::nullopt;
+    }
+    return TcpConnection(s);
+}
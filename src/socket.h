@@ -0,0 +1,119 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __SOCKET_H__
+#define __SOCKET_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#ifdef WIN32
+using SocketHandle = uintptr_t;
+#else // WIN32
+using SocketHandle = int;
+#endif // WIN32
+
+// Thin non-blocking wrapper around a datagram socket. All errors during setup are
+// reported as exceptions, sending and receiving never block
+class UdpSocket {
+public:
+    UdpSocket();
+    ~UdpSocket();
+
+    UdpSocket(const UdpSocket&) = delete;
+    UdpSocket& operator=(const UdpSocket&) = delete;
+
+    // Receive datagrams that are sent to the provided port on any interface
+    void bind(uint16_t port);
+
+    // Sets the default destination that is used by the send function
+    void connect(const std::string& address, uint16_t port);
+
+    void send(const void* data, size_t size);
+
+    // Returns the size of the received datagram or 0 if no datagram is pending
+    size_t receive(void* buffer, size_t size);
+
+private:
+    SocketHandle _socket;
+};
+
+// A non-blocking stream connection that was accepted by a TcpListener or opened with
+// connect
+class TcpConnection {
+public:
+    // Connects to the address and blocks until the connection is established. Errors
+    // are reported as exceptions
+    static TcpConnection connect(const std::string& address, uint16_t port);
+
+    explicit TcpConnection(SocketHandle socket);
+    ~TcpConnection();
+
+    TcpConnection(TcpConnection&& rhs);
+    TcpConnection& operator=(TcpConnection&& rhs);
+    TcpConnection(const TcpConnection&) = delete;
+    TcpConnection& operator=(const TcpConnection&) = delete;
+
+    // Returns the number of bytes that were sent, which is less than the size if the
+    // send buffer of the socket is full
+    size_t send(const void* data, size_t size);
+
+    // Returns the number of received bytes or 0 if nothing is pending
+    size_t receive(void* buffer, size_t size);
+
+    // Is false once the other side has closed the connection or an error occurred
+    bool isOpen() const;
+
+private:
+    SocketHandle _socket;
+    bool _isOpen = true;
+};
+
+// Listens for stream connections without blocking. All errors during setup are reported
+// as exceptions
+class TcpListener {
+public:
+    // Only connections from the same machine are accepted if localOnly is true
+    TcpListener(uint16_t port, bool localOnly);
+    ~TcpListener();
+
+    TcpListener(const TcpListener&) = delete;
+    TcpListener& operator=(const TcpListener&) = delete;
+
+    // Returns a pending connection or nothing if there is none
+    std::optional<TcpConnection> accept();
+
+private:
+    SocketHandle _socket;
+};
+
+#endif // __SOCKET_H__
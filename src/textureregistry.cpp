@@ -0,0 +1,502 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "textureregistry.h"
+
+#include "metrics.h"
+#include "trace.h"
+#include <sgct/image.h>
+#include <sgct/log.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <tuple>
+
+namespace {
+    constexpr const int MipmapLevels = 8;
+
+    // The number of textures whose storage is kept around for reuse after they have
+    // been released
+    constexpr const size_t MaxUnusedTextures = 8;
+
+    GLenum formatForChannels(int channels) {
+        switch (channels) {
+            case 1:  return GL_RED;
+            case 2:  return GL_RG;
+            case 3:  return GL_RGB;
+            default: return GL_RGBA;
+        }
+    }
+
+    GLenum internalFormat(int channels, int bytesPerChannel) {
+        const bool is16 = bytesPerChannel == 2;
+        switch (channels) {
+            case 1:  return is16 ? GL_R16 : GL_R8;
+            case 2:  return is16 ? GL_RG16 : GL_RG8;
+            case 3:  return is16 ? GL_RGB16 : GL_RGB8;
+            default: return is16 ? GL_RGBA16 : GL_RGBA8;
+        }
+    }
+
+    Gauge& residentBytes() {
+        static Gauge& Bytes = Metrics::instance().gauge(
+            "texture_resident_bytes",
+            "The size of all textures including their mipmaps"
+        );
+        return Bytes;
+    }
+
+    Counter& uploadedBytes() {
+        static Counter& Bytes = Metrics::instance().counter(
+            "texture_upload_bytes_total",
+            "The number of bytes that were uploaded to textures"
+        );
+        return Bytes;
+    }
+
+    uint64_t rotateLeft(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    uint64_t finalMix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccd;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53;
+        value ^= value >> 33;
+        return value;
+    }
+
+    std::shared_ptr<const DecodedImage> decodeImage(const ImageKey& key,
+                                                    std::vector<unsigned char>& contents)
+    {
+        sgct::Image img;
+        img.load(contents.data(), static_cast<int>(contents.size()));
+
+        auto res = std::make_shared<DecodedImage>();
+        res->key = key;
+        res->size = img.size();
+        res->channels = img.channels();
+        res->bytesPerChannel = img.bytesPerChannel();
+        const size_t nBytes = static_cast<size_t>(res->size.x) * res->size.y *
+            res->channels * res->bytesPerChannel;
+        res->data.assign(img.data(), img.data() + nBytes);
+        return res;
+    }
+} // namespace
+
+bool ImageKey::operator==(const ImageKey& rhs) const {
+    return hash == rhs.hash && hashHigh == rhs.hashHigh && fileSize == rhs.fileSize;
+}
+
+bool ImageKey::operator!=(const ImageKey& rhs) const {
+    return !(*this == rhs);
+}
+
+bool ImageKey::operator<(const ImageKey& rhs) const {
+    return std::tie(hash, hashHigh, fileSize) <
+        std::tie(rhs.hash, rhs.hashHigh, rhs.fileSize);
+}
+
+ImageKey imageKey(const std::vector<unsigned char>& fileContents) {
+    // The 128-bit version of MurmurHash3 for 64-bit platforms. It consumes 16 bytes at
+    // a time, which keeps up with images that are hundreds of megabytes large, and every
+    // bit of the input affects every bit of the hash, so raw frames that differ in a few
+    // bits still get different keys
+    constexpr const uint64_t C1 = 0x87c37b91114253d5;
+    constexpr const uint64_t C2 = 0x4cf5ad432745937f;
+    const unsigned char* data = fileContents.data();
+    const size_t size = fileContents.size();
+    uint64_t h1 = 0;
+    uint64_t h2 = 0;
+
+    const size_t nBlocks = size / 16;
+    for (size_t i = 0; i < nBlocks; ++i) {
+        uint64_t k1;
+        uint64_t k2;
+        std::memcpy(&k1, data + i * 16, sizeof(uint64_t));
+        std::memcpy(&k2, data + i * 16 + 8, sizeof(uint64_t));
+
+        h1 ^= rotateLeft(k1 * C1, 31) * C2;
+        h1 = (rotateLeft(h1, 27) + h2) * 5 + 0x52dce729;
+        h2 ^= rotateLeft(k2 * C2, 33) * C1;
+        h2 = (rotateLeft(h2, 31) + h1) * 5 + 0x38495ab5;
+    }
+
+    const unsigned char* tail = data + nBlocks * 16;
+    const size_t nTail = size % 16;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    for (size_t i = 0; i < nTail; ++i) {
+        uint64_t& k = i < 8 ? k1 : k2;
+        k |= static_cast<uint64_t>(tail[i]) << ((i % 8) * 8);
+    }
+    if (nTail > 8) {
+        h2 ^= rotateLeft(k2 * C2, 33) * C1;
+    }
+    if (nTail > 0) {
+        h1 ^= rotateLeft(k1 * C1, 31) * C2;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+    h1 += h2;
+    h2 += h1;
+    h1 = finalMix(h1);
+    h2 = finalMix(h2);
+    h1 += h2;
+    h2 += h1;
+
+    ImageKey key;
+    key.hash = h1;
+    key.hashHigh = h2;
+    key.fileSize = size;
+    return key;
+}
+
+std::optional<TileDelta> tileDelta(const DecodedImage& from, const DecodedImage& to) {
+    if (from.size != to.size || from.channels != to.channels ||
+        from.bytesPerChannel != to.bytesPerChannel || from.data.empty() ||
+        to.data.empty())
+    {
+        return std::nullopt;
+    }
+
+    constexpr const int TileSize = TileDelta::TileSize;
+    const size_t pixelSize = static_cast<size_t>(to.channels) * to.bytesPerChannel;
+    const size_t stride = to.size.x * pixelSize;
+    const glm::ivec2 nTiles = (to.size + TileSize - 1) / TileSize;
+
+    TileDelta delta;
+    delta.from = from.key;
+    delta.to = to.key;
+    delta.nTiles = static_cast<uint32_t>(nTiles.x * nTiles.y);
+    for (int ty = 0; ty < nTiles.y; ++ty) {
+        const int y0 = ty * TileSize;
+        const int y1 = std::min(y0 + TileSize, to.size.y);
+        for (int tx = 0; tx < nTiles.x; ++tx) {
+            const int x0 = tx * TileSize;
+            const size_t width = std::min(TileSize, to.size.x - x0) * pixelSize;
+
+            // memcmp is vectorized by the standard library and stops at the first
+            // difference, so unchanged tiles are as cheap to compare as it gets
+            for (int y = y0; y < y1; ++y) {
+                const size_t offset = y * stride + x0 * pixelSize;
+                const unsigned char* a = from.data.data() + offset;
+                const unsigned char* b = to.data.data() + offset;
+                if (std::memcmp(a, b, width) != 0) {
+                    delta.dirtyTiles.emplace_back(tx, ty);
+                    break;
+                }
+            }
+        }
+    }
+    return delta;
+}
+
+TextureRegistry& TextureRegistry::instance() {
+    static TextureRegistry Instance;
+    return Instance;
+}
+
+std::shared_ptr<const DecodedImage> TextureRegistry::decode(const ImageKey& key,
+                                                std::vector<unsigned char> fileContents)
+{
+    std::promise<std::shared_ptr<const DecodedImage>> promise;
+    {
+        std::unique_lock lock(_mutex);
+        auto it = _decoded.find(key);
+        if (it != _decoded.end()) {
+            if (std::shared_ptr<const DecodedImage> image = it->second.lock(); image) {
+                _nShared++;
+                return image;
+            }
+            _decoded.erase(it);
+        }
+
+        auto inFlight = _inFlight.find(key);
+        if (inFlight != _inFlight.end()) {
+            // Someone else is already decoding this image, so we wait for them
+            std::shared_future<std::shared_ptr<const DecodedImage>> f = inFlight->second;
+            _nShared++;
+            lock.unlock();
+            return f.get();
+        }
+
+        _inFlight[key] = promise.get_future().share();
+    }
+
+    static Histogram& DecodeTime = Metrics::instance().histogram(
+        "decode_seconds",
+        "The time it takes to decode an image",
+        { 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5 }
+    );
+    std::shared_ptr<const DecodedImage> image;
+    try {
+        TraceScope scope("Decode image");
+        using namespace std::chrono;
+        const steady_clock::time_point start = steady_clock::now();
+        image = decodeImage(key, fileContents);
+        DecodeTime.observe(duration<double>(steady_clock::now() - start).count());
+        promise.set_value(image);
+    }
+    catch (...) {
+        promise.set_exception(std::current_exception());
+        std::lock_guard lock(_mutex);
+        _inFlight.erase(key);
+        throw;
+    }
+
+    std::lock_guard lock(_mutex);
+    _inFlight.erase(key);
+    _decoded[key] = image;
+    _nDecoded++;
+    return image;
+}
+
+std::optional<ImageKey> TextureRegistry::knownKey(const std::filesystem::path& path) {
+    namespace fs = std::filesystem;
+    std::error_code sizeError;
+    const uint64_t size = fs::file_size(path, sizeError);
+    std::error_code timeError;
+    const fs::file_time_type time = fs::last_write_time(path, timeError);
+    if (sizeError || timeError) {
+        return std::nullopt;
+    }
+
+    std::lock_guard lock(_mutex);
+    auto it = _knownKeys.find(path.string());
+    if (it == _knownKeys.end() || it->second.fileSize != size ||
+        it->second.lastWriteTime != time)
+    {
+        return std::nullopt;
+    }
+    return it->second.key;
+}
+
+void TextureRegistry::rememberKey(const std::filesystem::path& path,
+                                  const ImageKey& key)
+{
+    std::error_code ec;
+    const std::filesystem::file_time_type time =
+        std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return;
+    }
+
+    std::lock_guard lock(_mutex);
+    KnownKey& k = _knownKeys[path.string()];
+    k.key = key;
+    k.fileSize = key.fileSize;
+    k.lastWriteTime = time;
+}
+
+bool TextureRegistry::hasTexture(const ImageKey& key) const {
+    std::lock_guard lock(_mutex);
+    return _textures.find(key) != _textures.end();
+}
+
+GLuint TextureRegistry::acquire(const ImageKey& key) {
+    std::lock_guard lock(_mutex);
+    auto it = _textures.find(key);
+    if (it == _textures.end()) {
+        return 0;
+    }
+
+    it->second.refCount++;
+    _nShared++;
+    return it->second.id;
+}
+
+GLuint TextureRegistry::create(const DecodedImage& image) {
+    TraceScope scope("Upload texture");
+    const GLenum format = formatForChannels(image.channels);
+    const GLenum intFormat = internalFormat(image.channels, image.bytesPerChannel);
+    const GLenum type = image.bytesPerChannel == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+    std::lock_guard lock(_mutex);
+
+    if (auto existing = _textures.find(image.key); existing != _textures.end()) {
+        existing->second.refCount++;
+        return existing->second.id;
+    }
+
+    Texture tex;
+    auto it = std::find_if(
+        _unusedTextures.begin(),
+        _unusedTextures.end(),
+        [&](const Texture& t) {
+            return t.size == image.size && t.internalFormat == intFormat;
+        }
+    );
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const size_t pixelSize = static_cast<size_t>(image.channels) * image.bytesPerChannel;
+    uploadedBytes().add(static_cast<uint64_t>(image.size.x) * image.size.y * pixelSize);
+    if (it != _unusedTextures.end()) {
+        // Same layout as a previous image, so we can reuse the storage
+        tex = *it;
+        _unusedTextures.erase(it);
+
+        glBindTexture(GL_TEXTURE_2D, tex.id);
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            0,
+            0,
+            image.size.x,
+            image.size.y,
+            format,
+            type,
+            image.data.data()
+        );
+    }
+    else {
+        tex.size = image.size;
+        tex.internalFormat = intFormat;
+        // The mipmaps add a third to the size of the base level
+        tex.nBytes =
+            static_cast<uint64_t>(image.size.x) * image.size.y * pixelSize * 4 / 3;
+        residentBytes().add(static_cast<int64_t>(tex.nBytes));
+        glGenTextures(1, &tex.id);
+        glBindTexture(GL_TEXTURE_2D, tex.id);
+        glTexImage2D(
+            GL_TEXTURE_2D,
+            0,
+            intFormat,
+            image.size.x,
+            image.size.y,
+            0,
+            format,
+            type,
+            image.data.data()
+        );
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MipmapLevels - 1);
+    }
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    tex.refCount = 1;
+    _textures[image.key] = tex;
+    return tex.id;
+}
+
+GLuint TextureRegistry::update(const DecodedImage& image, const TileDelta& delta) {
+    TraceScope scope("Upload tiles");
+    const GLenum format = formatForChannels(image.channels);
+    const GLenum intFormat = internalFormat(image.channels, image.bytesPerChannel);
+    const GLenum type = image.bytesPerChannel == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+    std::lock_guard lock(_mutex);
+    auto it = _textures.find(delta.from);
+    if (it == _textures.end() || it->second.refCount != 1 ||
+        it->second.size != image.size || it->second.internalFormat != intFormat ||
+        _textures.find(image.key) != _textures.end())
+    {
+        return 0;
+    }
+
+    Texture tex = it->second;
+    _textures.erase(it);
+
+    constexpr const int TileSize = TileDelta::TileSize;
+    const size_t pixelSize = static_cast<size_t>(image.channels) * image.bytesPerChannel;
+    glBindTexture(GL_TEXTURE_2D, tex.id);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, image.size.x);
+    for (const glm::ivec2& tile : delta.dirtyTiles) {
+        const glm::ivec2 p = tile * TileSize;
+        const glm::ivec2 size = glm::min(glm::ivec2(TileSize), image.size - p);
+        const size_t offset = (static_cast<size_t>(p.y) * image.size.x + p.x) * pixelSize;
+        uploadedBytes().add(static_cast<uint64_t>(size.x) * size.y * pixelSize);
+        glTexSubImage2D(
+            GL_TEXTURE_2D,
+            0,
+            p.x,
+            p.y,
+            size.x,
+            size.y,
+            format,
+            type,
+            image.data.data() + offset
+        );
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    if (!delta.dirtyTiles.empty()) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    _textures[image.key] = tex;
+    return tex.id;
+}
+
+void TextureRegistry::release(const ImageKey& key) {
+    std::lock_guard lock(_mutex);
+    auto it = _textures.find(key);
+    if (it == _textures.end()) {
+        return;
+    }
+
+    it->second.refCount--;
+    if (it->second.refCount > 0) {
+        return;
+    }
+
+    _unusedTextures.push_back(it->second);
+    _textures.erase(it);
+    if (_unusedTextures.size() > MaxUnusedTextures) {
+        glDeleteTextures(1, &_unusedTextures.front().id);
+        residentBytes().add(-static_cast<int64_t>(_unusedTextures.front().nBytes));
+        _unusedTextures.erase(_unusedTextures.begin());
+    }
+}
+
+void TextureRegistry::deinitialize() {
+    std::lock_guard lock(_mutex);
+    for (const Texture& tex : _unusedTextures) {
+        glDeleteTextures(1, &tex.id);
+        residentBytes().add(-static_cast<int64_t>(tex.nBytes));
+    }
+    _unusedTextures.clear();
+}
+
+uint32_t TextureRegistry::nDecodedImages() const {
+    std::lock_guard lock(_mutex);
+    return _nDecoded;
+}
+
+uint32_t TextureRegistry::nSharedImages() const {
+    std::lock_guard lock(_mutex);
+    return _nShared;
+}
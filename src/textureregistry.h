@@ -0,0 +1,167 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __TEXTUREREGISTRY_H__
+#define __TEXTUREREGISTRY_H__
+
+#include <sgct/opengl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Identifies an image by the contents of its file, so that identical images that are
+// stored in different places are only decoded and uploaded once. The hash has 128 bits.
+// Keys that are derived from another key, such as those of the regions of tiled images
+// and of thumbnails, only use its first half
+struct ImageKey {
+    uint64_t hash = 0;
+    uint64_t hashHigh = 0;
+    uint64_t fileSize = 0;
+
+    bool operator==(const ImageKey& rhs) const;
+    bool operator!=(const ImageKey& rhs) const;
+    bool operator<(const ImageKey& rhs) const;
+};
+
+ImageKey imageKey(const std::vector<unsigned char>& fileContents);
+
+struct DecodedImage {
+    ImageKey key;
+    glm::ivec2 size = glm::ivec2(0);
+    int channels = 0;
+    int bytesPerChannel = 0;
+    std::vector<unsigned char> data;
+    // The part of the texture coordinates that the image covers as offset and size,
+    // which is less than everything if only a region of a tiled image was loaded
+    glm::vec4 uvRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+};
+
+// The tiles that differ between two images of the same layout. Consecutive images of a
+// sequence are often mostly identical, in which case only the changed tiles have to be
+// uploaded to update the texture of the previous image
+struct TileDelta {
+    static constexpr const int TileSize = 64;
+
+    ImageKey from;
+    ImageKey to;
+    uint32_t nTiles = 0;
+    // The tile coordinates (not pixels) of all tiles that have changed
+    std::vector<glm::ivec2> dirtyTiles;
+};
+
+// Returns the tiles that differ between the two images or std::nullopt if the images do
+// not have the same layout and can't be compared
+std::optional<TileDelta> tileDelta(const DecodedImage& from, const DecodedImage& to);
+
+// Keeps track of all decoded images and textures. Both are reference counted, so an
+// image is decoded once as long as someone is using it and the texture of an image is
+// shared between all objects that show the same image at the same time
+class TextureRegistry {
+public:
+    static TextureRegistry& instance();
+
+    // Returns the decoded version of the file contents. If the same file is already
+    // decoded or being decoded by a different thread, that result is reused instead.
+    // This function is safe to call from any thread
+    std::shared_ptr<const DecodedImage> decode(const ImageKey& key,
+        std::vector<unsigned char> fileContents);
+
+    // Returns the key of the file if it was seen before and has not changed since then.
+    // This function is safe to call from any thread
+    std::optional<ImageKey> knownKey(const std::filesystem::path& path);
+    void rememberKey(const std::filesystem::path& path, const ImageKey& key);
+
+    // Returns whether there currently is a texture for the image. A texture that exists
+    // now might be released by the time it is acquired, so this is only a hint. This
+    // function is safe to call from any thread
+    bool hasTexture(const ImageKey& key) const;
+
+    // Returns the texture for the image and increases its reference count. If there is
+    // no such texture, 0 is returned. Has to be called from the rendering thread
+    GLuint acquire(const ImageKey& key);
+
+    // Creates a new texture for the decoded image with a reference count of 1. Has to be
+    // called from the rendering thread
+    GLuint create(const DecodedImage& image);
+
+    // Turns the texture of delta.from into the texture of delta.to by only uploading the
+    // dirty tiles. This is only possible if nobody else is using the previous texture and
+    // there isn't a texture for the new image yet, otherwise 0 is returned and the
+    // previous texture is untouched. On success, the reference to the previous texture
+    // is transferred to the new one. Has to be called from the rendering thread
+    GLuint update(const DecodedImage& image, const TileDelta& delta);
+
+    // Decreases the reference count of the texture. Once nobody uses the texture anymore,
+    // its storage is kept around to be reused for an image of the same dimensions. Has
+    // to be called from the rendering thread
+    void release(const ImageKey& key);
+
+    // Destroys all textures that are no longer in use. Has to be called from the
+    // rendering thread
+    void deinitialize();
+
+    uint32_t nDecodedImages() const;
+    uint32_t nSharedImages() const;
+
+private:
+    struct Texture {
+        GLuint id = 0;
+        glm::ivec2 size = glm::ivec2(0);
+        GLenum internalFormat = 0;
+        // The size of the storage including all mipmap levels
+        uint64_t nBytes = 0;
+        int refCount = 0;
+    };
+
+    struct KnownKey {
+        ImageKey key;
+        uint64_t fileSize = 0;
+        std::filesystem::file_time_type lastWriteTime;
+    };
+
+    mutable std::mutex _mutex;
+    std::map<std::string, KnownKey> _knownKeys;
+    std::map<ImageKey, std::weak_ptr<const DecodedImage>> _decoded;
+    std::map<ImageKey, std::shared_future<std::shared_ptr<const DecodedImage>>> _inFlight;
+    std::map<ImageKey, Texture> _textures;
+    std::vector<Texture> _unusedTextures;
+
+    uint32_t _nDecoded = 0;
+    uint32_t _nShared = 0;
+};
+
+#endif // __TEXTUREREGISTRY_H__
@@ -0,0 +1,312 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "thumbnail.h"
+
+#include <sgct/log.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace {
+    namespace fs = std::filesystem;
+
+    constexpr const char Magic[4] = { 'T', 'H', 'M', '1' };
+
+    // The longer side of a thumbnail is at most this many pixels
+    constexpr const int MaxThumbnailSize = 256;
+
+    struct Header {
+        char magic[4];
+        int32_t width;
+        int32_t height;
+        int32_t channels;
+        uint64_t hash;
+        uint64_t fileSize;
+        int64_t lastWriteTime;
+    };
+
+    ThumbnailSettings Settings;
+
+    // The size and the time of the last use of the thumbnails in the folder. The folder
+    // is only listed once the first thumbnail is stored or used
+    struct CachedThumbnail {
+        uint64_t size = 0;
+        fs::file_time_type lastUse;
+    };
+    std::mutex CacheMutex;
+    bool IsFolderListed = false;
+    std::map<fs::path, CachedThumbnail> Thumbnails;
+    uint64_t NCachedBytes = 0;
+
+    fs::path thumbnailFolder() {
+        if (!Settings.folder.empty()) {
+            return Settings.folder;
+        }
+        std::error_code ec;
+        const fs::path tmp = fs::temp_directory_path(ec);
+        return ec ? fs::path() : tmp / "sgct-image-thumbnails";
+    }
+
+    // Records that the thumbnail was stored or shown and removes the least recently used
+    // thumbnails if the folder has become too large. This is also seen by other runs, as
+    // the modification time of the thumbnail is updated as well
+    void useThumbnail(const fs::path& path) {
+        std::error_code ec;
+        const fs::file_time_type now = fs::file_time_type::clock::now();
+        fs::last_write_time(path, now, ec);
+        const uint64_t size = fs::file_size(path, ec);
+        if (ec) {
+            return;
+        }
+
+        std::lock_guard lock(CacheMutex);
+        if (!IsFolderListed) {
+            IsFolderListed = true;
+            const fs::path folder = path.parent_path();
+            for (const fs::directory_entry& e : fs::directory_iterator(folder, ec)) {
+                if (e.path().extension() == ".thumb") {
+                    CachedThumbnail& t = Thumbnails[e.path()];
+                    t.size = e.file_size(ec);
+                    t.lastUse = e.last_write_time(ec);
+                    NCachedBytes += t.size;
+                }
+            }
+        }
+
+        CachedThumbnail& thumbnail = Thumbnails[path];
+        NCachedBytes -= thumbnail.size;
+        thumbnail.size = size;
+        thumbnail.lastUse = now;
+        NCachedBytes += size;
+
+        while (NCachedBytes > Settings.maxBytes && Thumbnails.size() > 1) {
+            auto oldest = std::min_element(
+                Thumbnails.begin(),
+                Thumbnails.end(),
+                [](const std::pair<const fs::path, CachedThumbnail>& lhs,
+                   const std::pair<const fs::path, CachedThumbnail>& rhs)
+                {
+                    return lhs.second.lastUse < rhs.second.lastUse;
+                }
+            );
+            fs::remove(oldest->first, ec);
+            NCachedBytes -= oldest->second.size;
+            Thumbnails.erase(oldest);
+        }
+    }
+
+    // The thumbnails are named after a hash of the absolute image path so that images
+    // with the same name in different folders don't overwrite each other
+    fs::path thumbnailPath(const fs::path& image) {
+        std::error_code ec;
+        const std::string p = fs::absolute(image, ec).string();
+        uint64_t hash = 0xcbf29ce484222325;
+        for (char c : p) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.thumb", (unsigned long long)hash);
+        return thumbnailFolder() / name;
+    }
+
+    bool fileInfo(const fs::path& path, uint64_t& fileSize, int64_t& lastWriteTime) {
+        std::error_code sizeError;
+        fileSize = fs::file_size(path, sizeError);
+        std::error_code timeError;
+        const fs::file_time_type t = fs::last_write_time(path, timeError);
+        lastWriteTime = static_cast<int64_t>(t.time_since_epoch().count());
+        return !sizeError && !timeError;
+    }
+
+    // Reads the header of the thumbnail and returns whether it belongs to the current
+    // version of the image
+    bool readHeader(std::ifstream& f, const fs::path& image, Header& header) {
+        f.read(reinterpret_cast<char*>(&header), sizeof(Header));
+        if (!f.good() || std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+            return false;
+        }
+
+        uint64_t fileSize = 0;
+        int64_t lastWriteTime = 0;
+        return fileInfo(image, fileSize, lastWriteTime) && header.fileSize == fileSize &&
+            header.lastWriteTime == lastWriteTime;
+    }
+
+    // Averages boxes of factor x factor pixels and converts the result to 8 bit
+    std::vector<unsigned char> downscale(const DecodedImage& image, int factor,
+                                         glm::ivec2 size)
+    {
+        const int c = image.channels;
+        const bool is16 = image.bytesPerChannel == 2;
+        std::vector<unsigned char> res(static_cast<size_t>(size.x) * size.y * c);
+        for (int y = 0; y < size.y; ++y) {
+            for (int x = 0; x < size.x; ++x) {
+                const int x1 = std::min((x + 1) * factor, image.size.x);
+                const int y1 = std::min((y + 1) * factor, image.size.y);
+                for (int ch = 0; ch < c; ++ch) {
+                    uint64_t sum = 0;
+                    int n = 0;
+                    for (int sy = y * factor; sy < y1; ++sy) {
+                        for (int sx = x * factor; sx < x1; ++sx) {
+                            const size_t i = (static_cast<size_t>(sy) * image.size.x +
+                                sx) * c + ch;
+                            if (is16) {
+                                uint16_t v;
+                                std::memcpy(&v, image.data.data() + i * 2, 2);
+                                sum += v >> 8;
+                            }
+                            else {
+                                sum += image.data[i];
+                            }
+                            n++;
+                        }
+                    }
+                    const size_t o = (static_cast<size_t>(y) * size.x + x) * c + ch;
+                    res[o] = static_cast<unsigned char>(sum / n);
+                }
+            }
+        }
+        return res;
+    }
+} // namespace
+
+void initializeThumbnails(ThumbnailSettings settings) {
+    Settings = std::move(settings);
+    Settings.interval = std::max<uint32_t>(Settings.interval, 1);
+}
+
+uint32_t thumbnailImage(uint32_t image) {
+    return image - image % Settings.interval;
+}
+
+std::shared_ptr<const DecodedImage> loadThumbnail(const fs::path& image) {
+    const fs::path path = thumbnailPath(image);
+    std::ifstream f(path, std::ios::binary);
+    if (!f.good()) {
+        return nullptr;
+    }
+
+    Header header;
+    if (!readHeader(f, image, header)) {
+        return nullptr;
+    }
+    if (header.width <= 0 || header.height <= 0 || header.width > MaxThumbnailSize ||
+        header.height > MaxThumbnailSize || header.channels < 1 || header.channels > 4)
+    {
+        return nullptr;
+    }
+
+    auto res = std::make_shared<DecodedImage>();
+    // Real images are never empty, so a file size of 0 keeps the key of the thumbnail
+    // distinct from the key of the full image
+    res->key.hash = header.hash;
+    res->key.fileSize = 0;
+    res->size = glm::ivec2(header.width, header.height);
+    res->channels = header.channels;
+    res->bytesPerChannel = 1;
+    res->data.resize(static_cast<size_t>(header.width) * header.height * header.channels);
+    f.read(reinterpret_cast<char*>(res->data.data()), res->data.size());
+    if (!f.good()) {
+        return nullptr;
+    }
+    f.close();
+    useThumbnail(path);
+    return res;
+}
+
+void storeThumbnail(const fs::path& image, const DecodedImage& decoded) {
+    if (decoded.data.empty() || decoded.size.x <= 0 || decoded.size.y <= 0) {
+        return;
+    }
+
+    const fs::path path = thumbnailPath(image);
+    {
+        std::ifstream f(path, std::ios::binary);
+        Header header;
+        if (f.good() && readHeader(f, image, header)) {
+            return;
+        }
+    }
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    if (!fileInfo(image, header.fileSize, header.lastWriteTime)) {
+        return;
+    }
+    const int longSide = std::max(decoded.size.x, decoded.size.y);
+    const int factor = (longSide + MaxThumbnailSize - 1) / MaxThumbnailSize;
+    const glm::ivec2 size = glm::ivec2(
+        std::max(decoded.size.x / factor, 1),
+        std::max(decoded.size.y / factor, 1)
+    );
+    header.width = size.x;
+    header.height = size.y;
+    header.channels = decoded.channels;
+    header.hash = decoded.key.hash;
+    std::vector<unsigned char> data = downscale(decoded, factor, size);
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    // Write to a temporary file first so that a concurrent reader never sees a partial
+    // thumbnail. The name is unique per thread as several workers might race here
+    fs::path tmp = path;
+    tmp += "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream f(tmp, std::ios::binary);
+        if (!f.good()) {
+            return;
+        }
+        f.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+        f.write(reinterpret_cast<const char*>(data.data()), data.size());
+        f.close();
+        if (!f.good()) {
+            // A partial file must not replace the thumbnail, as it would be read back
+            sgct::Log::Warning(
+                "Could not write thumbnail for %s",
+                image.string().c_str()
+            );
+            fs::remove(tmp, ec);
+            return;
+        }
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) {
+        fs::remove(tmp, ec);
+        return;
+    }
+    useThumbnail(path);
+}
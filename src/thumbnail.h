@@ -0,0 +1,70 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __THUMBNAIL_H__
+#define __THUMBNAIL_H__
+
+#include "textureregistry.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+// Small previews of images that are stored in a cache folder outside of the image
+// folders, so that something can be shown right away after starting up or seeking while
+// the full resolution image is still being decoded. A thumbnail is created the first
+// time the full image is decoded and is ignored once the image file has changed. Only
+// the images that are likely to be seeked to get a thumbnail, and the least recently
+// used thumbnails are removed once the folder grows too large
+
+struct ThumbnailSettings {
+    // The temporary folder of the system is used if this is empty
+    std::filesystem::path folder;
+    uint64_t maxBytes = 256 * 1024 * 1024;
+    // Every interval-th image of a sequence, starting with the first, gets a thumbnail
+    uint32_t interval = 30;
+};
+
+// Has to be called before the first thumbnail is loaded or stored for the settings to
+// take effect
+void initializeThumbnails(ThumbnailSettings settings);
+
+// Returns the image of the sequence whose thumbnail is shown while the image is decoded,
+// which is the closest image with a thumbnail that comes before it
+uint32_t thumbnailImage(uint32_t image);
+
+// Returns the thumbnail of the image or nullptr if there is none or it is out of date.
+// The key of the returned image is derived from the image's key but never equal to it
+std::shared_ptr<const DecodedImage> loadThumbnail(const std::filesystem::path& image);
+
+// Downscales the decoded image and stores it as the thumbnail for the image file unless
+// an up-to-date thumbnail exists already. This function is safe to call from any thread
+void storeThumbnail(const std::filesystem::path& image, const DecodedImage& decoded);
+
+#endif // __THUMBNAIL_H__
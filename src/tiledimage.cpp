@@ -0,0 +1,425 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "tiledimage.h"
+
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    namespace fs = std::filesystem;
+
+    constexpr const char Magic[4] = { 'T', 'I', 'L', '1' };
+
+    // Regions are never loaded at a size that can't be stored in a texture
+    constexpr const int MaxTextureSize = 16384;
+
+    struct Header {
+        char magic[4];
+        int32_t width;
+        int32_t height;
+        int32_t channels;
+        int32_t bytesPerChannel;
+        int32_t tileSize;
+        int32_t nLevels;
+        int32_t reserved;
+        // The hash of the contents of the image file that the tiles were created from
+        uint64_t hash;
+    };
+
+    bool readHeader(std::ifstream& f, Header& header) {
+        f.read(reinterpret_cast<char*>(&header), sizeof(Header));
+        return f.good() && std::memcmp(header.magic, Magic, sizeof(Magic)) == 0;
+    }
+
+    glm::ivec2 levelSize(glm::ivec2 size, int level) {
+        return glm::ivec2(std::max(size.x >> level, 1), std::max(size.y >> level, 1));
+    }
+
+    int countLevels(glm::ivec2 size, int tileSize) {
+        int n = 1;
+        while (std::max(levelSize(size, n - 1).x, levelSize(size, n - 1).y) > tileSize) {
+            n++;
+        }
+        return n;
+    }
+
+    glm::ivec2 countTiles(glm::ivec2 size, int tileSize) {
+        return glm::ivec2(
+            (size.x + tileSize - 1) / tileSize,
+            (size.y + tileSize - 1) / tileSize
+        );
+    }
+
+    // Averages blocks of 2x2 pixels, repeating the last row and column for odd sizes
+    std::vector<unsigned char> halve(const std::vector<unsigned char>& data,
+                                     glm::ivec2 size, glm::ivec2 half, int channels,
+                                     int bytesPerChannel)
+    {
+        const bool is16 = bytesPerChannel == 2;
+        auto component = [&](int x, int y, int c) -> uint32_t {
+            x = std::min(x, size.x - 1);
+            y = std::min(y, size.y - 1);
+            const size_t i = (static_cast<size_t>(y) * size.x + x) * channels + c;
+            if (is16) {
+                uint16_t v;
+                std::memcpy(&v, data.data() + i * 2, 2);
+                return v;
+            }
+            return data[i];
+        };
+
+        std::vector<unsigned char> res(
+            static_cast<size_t>(half.x) * half.y * channels * bytesPerChannel
+        );
+        for (int y = 0; y < half.y; ++y) {
+            for (int x = 0; x < half.x; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    const uint32_t sum =
+                        component(2 * x, 2 * y, c) + component(2 * x + 1, 2 * y, c) +
+                        component(2 * x, 2 * y + 1, c) +
+                        component(2 * x + 1, 2 * y + 1, c);
+                    const uint32_t v = (sum + 2) / 4;
+                    const size_t o = (static_cast<size_t>(y) * half.x + x) * channels + c;
+                    if (is16) {
+                        const uint16_t w = static_cast<uint16_t>(v);
+                        std::memcpy(res.data() + o * 2, &w, 2);
+                    }
+                    else {
+                        res[o] = static_cast<unsigned char>(v);
+                    }
+                }
+            }
+        }
+        return res;
+    }
+} // namespace
+
+bool ImageRegion::operator==(const ImageRegion& rhs) const {
+    return min.x == rhs.min.x && min.y == rhs.min.y && max.x == rhs.max.x &&
+        max.y == rhs.max.y && maxTexels == rhs.maxTexels;
+}
+
+bool ImageRegion::operator!=(const ImageRegion& rhs) const {
+    return !(*this == rhs);
+}
+
+bool TiledImage::isTiledImage(const fs::path& path) {
+    return path.extension() == ".tiles";
+}
+
+TiledImage::TiledImage(fs::path path)
+    : _path(std::move(path))
+{
+    std::ifstream f(_path, std::ios::binary);
+    Header header;
+    if (!f.good() || !readHeader(f, header)) {
+        throw std::runtime_error("Not a tiled image: " + _path.string());
+    }
+    _size = glm::ivec2(header.width, header.height);
+    _channels = header.channels;
+    _bytesPerChannel = header.bytesPerChannel;
+    _tileSize = header.tileSize;
+    _hash = header.hash;
+    const bool isValid = _size.x > 0 && _size.y > 0 && _channels >= 1 &&
+        _channels <= 4 && (_bytesPerChannel == 1 || _bytesPerChannel == 2) &&
+        _tileSize > 0 && _tileSize <= 4096 &&
+        header.nLevels == countLevels(_size, _tileSize);
+    if (!isValid) {
+        throw std::runtime_error("Invalid header in tiled image " + _path.string());
+    }
+
+    std::error_code ec;
+    _fileSize = fs::file_size(_path, ec);
+    size_t nTotal = 0;
+    for (int level = 0; level < header.nLevels; ++level) {
+        _levelStart.push_back(nTotal);
+        const glm::ivec2 n = countTiles(levelSize(_size, level), _tileSize);
+        nTotal += static_cast<size_t>(n.x) * n.y;
+    }
+    _index.resize(nTotal);
+    f.read(reinterpret_cast<char*>(_index.data()), nTotal * sizeof(TileEntry));
+    if (!f.good()) {
+        throw std::runtime_error("Could not read the index of " + _path.string());
+    }
+    for (const TileEntry& e : _index) {
+        if (e.offset + e.size > _fileSize) {
+            throw std::runtime_error("Invalid index in tiled image " + _path.string());
+        }
+    }
+}
+
+DecodedImage TiledImage::load(const ImageRegion& region) const {
+    TraceScope scope("Load tiled image");
+    glm::vec2 min = glm::vec2(
+        std::clamp(region.min.x, 0.f, 1.f),
+        std::clamp(region.min.y, 0.f, 1.f)
+    );
+    glm::vec2 max = glm::vec2(
+        std::clamp(region.max.x, 0.f, 1.f),
+        std::clamp(region.max.y, 0.f, 1.f)
+    );
+    if (!(min.x < max.x && min.y < max.y)) {
+        min = glm::vec2(0.f);
+        max = glm::vec2(1.f);
+    }
+
+    // Every level covers the region with whole tiles, so the coarser levels might cover
+    // a slightly larger part of the image
+    int level = 0;
+    glm::ivec2 first = glm::ivec2(0);
+    glm::ivec2 last = glm::ivec2(0);
+    glm::ivec2 p0 = glm::ivec2(0);
+    glm::ivec2 p1 = glm::ivec2(0);
+    for (; level < nLevels(); ++level) {
+        const glm::ivec2 s = size(level);
+        const glm::ivec2 n = nTiles(level);
+        first = glm::ivec2(
+            static_cast<int>(std::floor(min.x * s.x)) / _tileSize,
+            static_cast<int>(std::floor(min.y * s.y)) / _tileSize
+        );
+        const glm::ivec2 end = glm::ivec2(
+            static_cast<int>(std::ceil(max.x * s.x)),
+            static_cast<int>(std::ceil(max.y * s.y))
+        );
+        last = glm::ivec2(
+            std::min((end.x + _tileSize - 1) / _tileSize, n.x),
+            std::min((end.y + _tileSize - 1) / _tileSize, n.y)
+        );
+        first = glm::ivec2(std::min(first.x, last.x - 1), std::min(first.y, last.y - 1));
+        p0 = glm::ivec2(first.x * _tileSize, first.y * _tileSize);
+        p1 = glm::ivec2(
+            std::min(last.x * _tileSize, s.x),
+            std::min(last.y * _tileSize, s.y)
+        );
+
+        const uint64_t nTexels = static_cast<uint64_t>(p1.x - p0.x) * (p1.y - p0.y);
+        const bool fitsTexture = p1.x - p0.x <= MaxTextureSize &&
+            p1.y - p0.y <= MaxTextureSize;
+        const bool isEnough = region.maxTexels == 0 || nTexels <= region.maxTexels;
+        if ((fitsTexture && isEnough) || level == nLevels() - 1) {
+            break;
+        }
+    }
+
+    const glm::ivec2 s = size(level);
+    const size_t pixelSize = static_cast<size_t>(_channels) * _bytesPerChannel;
+    DecodedImage res;
+    res.size = p1 - p0;
+    res.channels = _channels;
+    res.bytesPerChannel = _bytesPerChannel;
+    res.data.resize(static_cast<size_t>(res.size.x) * res.size.y * pixelSize);
+    res.uvRect = glm::vec4(
+        static_cast<float>(p0.x) / s.x,
+        static_cast<float>(p0.y) / s.y,
+        static_cast<float>(res.size.x) / s.x,
+        static_cast<float>(res.size.y) / s.y
+    );
+    // The key has to differ between regions, while identical source images that were
+    // converted separately still share their textures
+    uint64_t hash = _hash;
+    for (int v : { level, first.x, first.y, last.x, last.y }) {
+        hash = (hash ^ static_cast<uint32_t>(v)) * 0x100000001b3;
+    }
+    res.key.hash = hash;
+    res.key.fileSize = _fileSize;
+
+    static Counter& ReadBytes = Metrics::instance().counter(
+        "tile_read_bytes_total",
+        "The number of bytes that were read from tiled images"
+    );
+
+    // The tiles of a row are stored next to each other, so every row is a single read
+    std::ifstream f(_path, std::ios::binary);
+    std::vector<unsigned char> row;
+    for (int ty = first.y; ty < last.y; ++ty) {
+        const TileEntry& begin = entry(level, glm::ivec2(first.x, ty));
+        const TileEntry& end = entry(level, glm::ivec2(last.x - 1, ty));
+        if (end.offset + end.size < begin.offset) {
+            throw std::runtime_error("Tiles out of order in " + _path.string());
+        }
+        row.resize(end.offset + end.size - begin.offset);
+        f.seekg(begin.offset);
+        f.read(reinterpret_cast<char*>(row.data()), row.size());
+        if (!f.good()) {
+            throw std::runtime_error("Could not read tiles of " + _path.string());
+        }
+        ReadBytes.add(row.size());
+
+        for (int tx = first.x; tx < last.x; ++tx) {
+            const TileEntry& e = entry(level, glm::ivec2(tx, ty));
+            if (e.offset < begin.offset || e.offset + e.size > end.offset + end.size) {
+                throw std::runtime_error("Tiles out of order in " + _path.string());
+            }
+            const unsigned char* src = row.data() + (e.offset - begin.offset);
+            const glm::ivec2 t0 = glm::ivec2(tx * _tileSize, ty * _tileSize);
+            const glm::ivec2 dim = glm::ivec2(
+                std::min(_tileSize, s.x - t0.x),
+                std::min(_tileSize, s.y - t0.y)
+            );
+            const size_t rowBytes = static_cast<size_t>(dim.x) * pixelSize;
+            const bool isUniform = e.size == pixelSize;
+            if (!isUniform && e.size != rowBytes * dim.y) {
+                throw std::runtime_error("Invalid tile in " + _path.string());
+            }
+
+            for (int y = 0; y < dim.y; ++y) {
+                unsigned char* dst = res.data.data() +
+                    ((static_cast<size_t>(t0.y - p0.y + y) * res.size.x) +
+                    (t0.x - p0.x)) * pixelSize;
+                if (isUniform) {
+                    for (int x = 0; x < dim.x; ++x) {
+                        std::memcpy(dst + x * pixelSize, src, pixelSize);
+                    }
+                }
+                else {
+                    std::memcpy(dst, src + y * rowBytes, rowBytes);
+                }
+            }
+        }
+    }
+    return res;
+}
+
+glm::ivec2 TiledImage::size(int level) const {
+    return levelSize(_size, level);
+}
+
+int TiledImage::nLevels() const {
+    return static_cast<int>(_levelStart.size());
+}
+
+glm::ivec2 TiledImage::nTiles(int level) const {
+    return countTiles(size(level), _tileSize);
+}
+
+const TiledImage::TileEntry& TiledImage::entry(int level, glm::ivec2 tile) const {
+    const size_t i = static_cast<size_t>(tile.y) * nTiles(level).x + tile.x;
+    return _index[_levelStart[level] + i];
+}
+
+void writeTiledImage(const fs::path& path, const DecodedImage& image, int tileSize) {
+    if (image.data.empty() || image.size.x <= 0 || image.size.y <= 0 || tileSize <= 0) {
+        throw std::runtime_error("No image to write to " + path.string());
+    }
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.width = image.size.x;
+    header.height = image.size.y;
+    header.channels = image.channels;
+    header.bytesPerChannel = image.bytesPerChannel;
+    header.tileSize = tileSize;
+    header.nLevels = countLevels(image.size, tileSize);
+    header.reserved = 0;
+    header.hash = image.key.hash;
+
+    size_t nTotal = 0;
+    for (int level = 0; level < header.nLevels; ++level) {
+        const glm::ivec2 n = countTiles(levelSize(image.size, level), tileSize);
+        nTotal += static_cast<size_t>(n.x) * n.y;
+    }
+    std::vector<TiledImage::TileEntry> index(nTotal);
+
+    std::ofstream f(path, std::ios::binary);
+    if (!f.good()) {
+        throw std::runtime_error("Could not open " + path.string());
+    }
+    // The index is written again once the offsets of the tiles are known
+    f.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+    f.write(
+        reinterpret_cast<const char*>(index.data()),
+        index.size() * sizeof(TiledImage::TileEntry)
+    );
+
+    const size_t pixelSize = static_cast<size_t>(image.channels) * image.bytesPerChannel;
+    uint64_t offset = sizeof(Header) + index.size() * sizeof(TiledImage::TileEntry);
+    size_t i = 0;
+    std::vector<unsigned char> data = image.data;
+    glm::ivec2 s = image.size;
+    std::vector<unsigned char> tile;
+    for (int level = 0; level < header.nLevels; ++level) {
+        if (level > 0) {
+            const glm::ivec2 half = levelSize(image.size, level);
+            data = halve(data, s, half, image.channels, image.bytesPerChannel);
+            s = half;
+        }
+
+        const glm::ivec2 n = countTiles(s, tileSize);
+        for (int ty = 0; ty < n.y; ++ty) {
+            for (int tx = 0; tx < n.x; ++tx) {
+                const glm::ivec2 t0 = glm::ivec2(tx * tileSize, ty * tileSize);
+                const glm::ivec2 dim = glm::ivec2(
+                    std::min(tileSize, s.x - t0.x),
+                    std::min(tileSize, s.y - t0.y)
+                );
+                const size_t rowBytes = static_cast<size_t>(dim.x) * pixelSize;
+                tile.resize(rowBytes * dim.y);
+                for (int y = 0; y < dim.y; ++y) {
+                    const size_t src = (static_cast<size_t>(t0.y + y) * s.x + t0.x) *
+                        pixelSize;
+                    std::memcpy(tile.data() + y * rowBytes, data.data() + src, rowBytes);
+                }
+
+                bool isUniform = true;
+                for (size_t p = pixelSize; isUniform && p < tile.size(); p += pixelSize) {
+                    isUniform = std::memcmp(tile.data(), tile.data() + p, pixelSize) == 0;
+                }
+                const size_t size = isUniform ? pixelSize : tile.size();
+                f.write(reinterpret_cast<const char*>(tile.data()), size);
+                index[i] = { offset, size };
+                offset += size;
+                i++;
+            }
+        }
+    }
+
+    f.seekp(sizeof(Header));
+    f.write(
+        reinterpret_cast<const char*>(index.data()),
+        index.size() * sizeof(TiledImage::TileEntry)
+    );
+    if (!f.good()) {
+        throw std::runtime_error("Could not write " + path.string());
+    }
+}
+
+glm::ivec2 readTiledImageSize(const fs::path& path) {
+    std::ifstream f(path, std::ios::binary);
+    Header header;
+    if (!f.good() || !readHeader(f, header)) {
+        return glm::ivec2(0);
+    }
+    return glm::ivec2(header.width, header.height);
+}
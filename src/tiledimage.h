@@ -0,0 +1,108 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __TILEDIMAGE_H__
+#define __TILEDIMAGE_H__
+
+#include "textureregistry.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// The part of an image that a node needs, in texture coordinates, and the number of
+// texels that are enough to show it on the node's screens
+struct ImageRegion {
+    glm::vec2 min = glm::vec2(0.f);
+    glm::vec2 max = glm::vec2(1.f);
+    // 0 requests the full resolution
+    uint64_t maxTexels = 0;
+
+    bool operator==(const ImageRegion& rhs) const;
+    bool operator!=(const ImageRegion& rhs) const;
+};
+
+// An image that is stored as a pyramid of mipmap levels, each of which is split into
+// square tiles. All tiles follow an index with their offsets, level by level and row by
+// row, so that any region of any level can be read without touching the rest of the
+// file. Tiles that only contain a single color, such as empty areas, are stored as a
+// single pixel. The files use the extension .tiles and are created with --convert-tiled
+class TiledImage {
+public:
+    static constexpr const int DefaultTileSize = 256;
+
+    static bool isTiledImage(const std::filesystem::path& path);
+
+    // Reads the header and the index of the file. Throws a std::runtime_error if the
+    // file can't be read or is not a tiled image
+    explicit TiledImage(std::filesystem::path path);
+
+    // Reads and decodes the tiles of the coarsest level whose part of the region has at
+    // most the requested number of texels, but never more than fits into a texture.
+    // The result covers whole tiles, which are described by its uvRect, and its key is
+    // unique for the file, level, and tiles. Throws a std::runtime_error on read errors
+    DecodedImage load(const ImageRegion& region) const;
+
+    glm::ivec2 size(int level) const;
+    int nLevels() const;
+
+    // The location of a tile in the file as it is stored in the index. A tile whose size
+    // is that of a single pixel has that color everywhere
+    struct TileEntry {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+private:
+    glm::ivec2 nTiles(int level) const;
+    const TileEntry& entry(int level, glm::ivec2 tile) const;
+
+    std::filesystem::path _path;
+    uint64_t _fileSize = 0;
+    uint64_t _hash = 0;
+    glm::ivec2 _size = glm::ivec2(0);
+    int _channels = 0;
+    int _bytesPerChannel = 0;
+    int _tileSize = 0;
+    // The index of the first tile of every level in _index
+    std::vector<size_t> _levelStart;
+    std::vector<TileEntry> _index;
+};
+
+// Writes the decoded image as a tiled image with all mipmap levels down to the first one
+// that fits into a single tile. Throws a std::runtime_error if the file can't be written
+void writeTiledImage(const std::filesystem::path& path, const DecodedImage& image,
+    int tileSize);
+
+// Returns the dimensions stored in the header of the tiled image, or 0 if the file is not
+// a tiled image
+glm::ivec2 readTiledImageSize(const std::filesystem::path& path);
+
+#endif // __TILEDIMAGE_H__
@@ -0,0 +1,262 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "trace.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    // The number of most recent events that are kept per thread
+    constexpr const size_t EventsPerThread = 1 << 16;
+
+    thread_local std::string threadName;
+} // namespace
+
+Trace& Trace::instance() {
+    static Trace Instance;
+    return Instance;
+}
+
+Trace::Trace()
+    : _start(Clock::now())
+    , _systemStart(std::chrono::system_clock::now())
+{}
+
+void Trace::setEnabled(bool enabled) {
+    _isEnabled = enabled;
+}
+
+bool Trace::isEnabled() const {
+    return _isEnabled;
+}
+
+void Trace::setThreadName(std::string name) {
+    threadName = std::move(name);
+    if (Buffer* buffer = currentThreadBuffer(); buffer) {
+        std::lock_guard lock(_mutex);
+        buffer->threadName = threadName;
+    }
+}
+
+void Trace::record(const char* name, Clock::time_point begin, Clock::time_point end) {
+    if (_isEnabled) {
+        push(threadBuffer(), name, begin, end);
+    }
+}
+
+void Trace::beginGpu(const char* name) {
+    if (!_isEnabled || _activeQuery.has_value()) {
+        return;
+    }
+
+    GpuQuery q;
+    if (_unusedQueries.empty()) {
+        glGenQueries(1, &q.query);
+    }
+    else {
+        q.query = _unusedQueries.back();
+        _unusedQueries.pop_back();
+    }
+    q.name = name;
+    q.begin = Clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, q.query);
+    _activeQuery = q;
+}
+
+void Trace::endGpu() {
+    if (!_activeQuery.has_value()) {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    _pendingQueries.push_back(*_activeQuery);
+    _activeQuery = std::nullopt;
+}
+
+void Trace::collectGpuTimes() {
+    while (!_pendingQueries.empty()) {
+        const GpuQuery& q = _pendingQueries.front();
+        GLint isAvailable = GL_FALSE;
+        glGetQueryObjectiv(q.query, GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+        if (!isAvailable) {
+            // The queries finish in the order in which they were issued
+            break;
+        }
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(q.query, GL_QUERY_RESULT, &elapsed);
+
+        // The GPU starts executing the commands at the earliest when they are submitted,
+        // so the range is placed at the submission time on a separate GPU track
+        if (!_gpuBuffer) {
+            _gpuBuffer = &createBuffer("GPU");
+        }
+        push(*_gpuBuffer, q.name, q.begin, q.begin + std::chrono::nanoseconds(elapsed));
+
+        _unusedQueries.push_back(q.query);
+        _pendingQueries.pop_front();
+    }
+}
+
+void Trace::save(const std::filesystem::path& path, int processId,
+                 const std::string& processName) const
+{
+    std::ofstream file(path);
+    if (!file.good()) {
+        throw std::runtime_error("Could not open trace file " + path.string());
+    }
+
+    // The ts and dur values of trace events are in microseconds
+    using namespace std::chrono;
+    const int64_t offset = duration_cast<nanoseconds>(
+        _systemStart.time_since_epoch()
+    ).count();
+    char line[256];
+
+    file << "{\"traceEvents\":[\n";
+    std::snprintf(
+        line,
+        sizeof(line),
+        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%i,\"args\":{\"name\":\"%s\"}}",
+        processId,
+        processName.c_str()
+    );
+    file << line;
+
+    std::lock_guard lock(_mutex);
+    for (const std::unique_ptr<Buffer>& buffer : _buffers) {
+        std::snprintf(
+            line,
+            sizeof(line),
+            ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%i,\"tid\":%i,"
+            "\"args\":{\"name\":\"%s\"}}",
+            processId,
+            buffer->threadId,
+            buffer->threadName.c_str()
+        );
+        file << line;
+
+        // Events that the thread overwrites while we are copying them are discarded,
+        // including the one that it might be writing right now
+        const uint64_t n = buffer->nEvents.load(std::memory_order_acquire);
+        const uint64_t first = n > EventsPerThread ? n - EventsPerThread : 0;
+        std::vector<Event> events;
+        events.reserve(n - first);
+        for (uint64_t i = first; i < n; ++i) {
+            events.push_back(buffer->events[i % EventsPerThread]);
+        }
+        const uint64_t nAfter = buffer->nEvents.load(std::memory_order_acquire);
+        const uint64_t nOverwritten = nAfter + 1 > EventsPerThread + first ?
+            nAfter + 1 - EventsPerThread - first :
+            0;
+
+        for (size_t i = nOverwritten; i < events.size(); ++i) {
+            const Event& e = events[i];
+            std::snprintf(
+                line,
+                sizeof(line),
+                ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%i,\"tid\":%i,"
+                "\"ts\":%.3f,\"dur\":%.3f}",
+                e.name,
+                processId,
+                buffer->threadId,
+                (offset + e.begin) / 1000.0,
+                e.duration / 1000.0
+            );
+            file << line;
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void Trace::deinitialize() {
+    if (_activeQuery.has_value()) {
+        glEndQuery(GL_TIME_ELAPSED);
+        _unusedQueries.push_back(_activeQuery->query);
+        _activeQuery = std::nullopt;
+    }
+    for (const GpuQuery& q : _pendingQueries) {
+        _unusedQueries.push_back(q.query);
+    }
+    _pendingQueries.clear();
+    glDeleteQueries(static_cast<GLsizei>(_unusedQueries.size()), _unusedQueries.data());
+    _unusedQueries.clear();
+}
+
+Trace::Buffer*& Trace::currentThreadBuffer() {
+    thread_local Buffer* buffer = nullptr;
+    return buffer;
+}
+
+Trace::Buffer& Trace::threadBuffer() {
+    Buffer*& buffer = currentThreadBuffer();
+    if (!buffer) {
+        buffer = &createBuffer(threadName);
+    }
+    return *buffer;
+}
+
+Trace::Buffer& Trace::createBuffer(std::string name) {
+    auto buffer = std::make_unique<Buffer>();
+    buffer->events.resize(EventsPerThread);
+
+    std::lock_guard lock(_mutex);
+    buffer->threadId = static_cast<int>(_buffers.size());
+    buffer->threadName =
+        name.empty() ? "Thread " + std::to_string(buffer->threadId) : std::move(name);
+    _buffers.push_back(std::move(buffer));
+    return *_buffers.back();
+}
+
+void Trace::push(Buffer& buffer, const char* name, Clock::time_point begin,
+                 Clock::time_point end)
+{
+    using namespace std::chrono;
+    const uint64_t i = buffer.nEvents.load(std::memory_order_relaxed);
+    Event& e = buffer.events[i % EventsPerThread];
+    e.name = name;
+    e.begin = duration_cast<nanoseconds>(begin - _start).count();
+    e.duration = duration_cast<nanoseconds>(end - begin).count();
+    buffer.nEvents.store(i + 1, std::memory_order_release);
+}
+
+TraceScope::TraceScope(const char* name)
+    : _name(name)
+{
+    if (Trace::instance().isEnabled()) {
+        _begin = Trace::Clock::now();
+    }
+}
+
+TraceScope::~TraceScope() {
+    if (_begin.has_value()) {
+        Trace::instance().record(_name, *_begin, Trace::Clock::now());
+    }
+}
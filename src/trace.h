@@ -0,0 +1,143 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <sgct/opengl.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Records where the time of each frame goes, for finding the cause of stutters. Every
+// thread writes its events into its own ring buffer without taking a lock, so only the
+// most recent events of each thread are kept. The GPU time of a range of commands is
+// measured with GL_TIME_ELAPSED queries. The events are saved in the Chrome trace event
+// format, which can be opened in chrome://tracing or Perfetto
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Trace& instance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    // Names the calling thread in the saved traces
+    void setThreadName(std::string name);
+
+    // Records an event on the calling thread. The name has to outlive the trace, which
+    // is the case for string literals
+    void record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+    // Measures the GPU time of the commands between the calls. Only one range can be
+    // measured at a time and both calls have to be made on the rendering thread
+    void beginGpu(const char* name);
+    void endGpu();
+
+    // Records the GPU ranges whose results are available. Has to be called regularly on
+    // the rendering thread
+    void collectGpuTimes();
+
+    // Writes the recorded events as a Chrome trace JSON file. The timestamps are based
+    // on the system clock and the process id identifies the node, so the traceEvents
+    // arrays of the files of multiple nodes can be concatenated into one cluster trace
+    void save(const std::filesystem::path& path, int processId,
+        const std::string& processName) const;
+
+    void deinitialize();
+
+private:
+    struct Event {
+        const char* name = nullptr;
+        // Nanoseconds since the trace was created
+        int64_t begin = 0;
+        int64_t duration = 0;
+    };
+
+    struct Buffer {
+        std::string threadName;
+        int threadId = 0;
+        std::vector<Event> events;
+        // Only written by the owning thread; events are published by incrementing it
+        std::atomic<uint64_t> nEvents = 0;
+    };
+
+    struct GpuQuery {
+        GLuint query = 0;
+        const char* name = nullptr;
+        Clock::time_point begin;
+    };
+
+    Trace();
+
+    // The buffer of the calling thread, which is null until it records its first event
+    static Buffer*& currentThreadBuffer();
+    Buffer& threadBuffer();
+    Buffer& createBuffer(std::string threadName);
+    void push(Buffer& buffer, const char* name, Clock::time_point begin,
+        Clock::time_point end);
+
+    std::atomic_bool _isEnabled = false;
+    const Clock::time_point _start;
+    const std::chrono::system_clock::time_point _systemStart;
+
+    mutable std::mutex _mutex;
+    std::vector<std::unique_ptr<Buffer>> _buffers;
+
+    // The GPU queries are only used by the rendering thread
+    Buffer* _gpuBuffer = nullptr;
+    std::vector<GLuint> _unusedQueries;
+    std::deque<GpuQuery> _pendingQueries;
+    std::optional<GpuQuery> _activeQuery;
+};
+
+// Records the lifetime of the scope as an event on the calling thread
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* _name;
+    std::optional<Trace::Clock::time_point> _begin;
+};
+
+#endif // __TRACE_H__
@@ -0,0 +1,142 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#include "visibility.h"
+
+#include <sgct/sgct.h>
+#include <algorithm>
+
+namespace {
+    // Returns whether the convex hull of the points, which are in clip space, can be
+    // inside the view volume. It can't if all points are outside of the same plane,
+    // which is tested in homogeneous coordinates so that it works for points behind
+    // the eye as well
+    bool isInViewVolume(const glm::vec4* points, int nPoints, float margin) {
+        int outside[6] = { 0, 0, 0, 0, 0, 0 };
+        for (int i = 0; i < nPoints; ++i) {
+            const glm::vec4& p = points[i];
+            const float w = p.w * (1.f + margin);
+            outside[0] += p.x < -w ? 1 : 0;
+            outside[1] += p.x > w ? 1 : 0;
+            outside[2] += p.y < -w ? 1 : 0;
+            outside[3] += p.y > w ? 1 : 0;
+            outside[4] += p.z < -p.w ? 1 : 0;
+            outside[5] += p.z > p.w ? 1 : 0;
+        }
+        return std::find(std::begin(outside), std::end(outside), nPoints) ==
+            std::end(outside);
+    }
+} // namespace
+
+bool isInFrustum(const glm::mat4& clip, const Bounds& bounds, float margin) {
+    if (bounds.min.x > bounds.max.x) {
+        return false;
+    }
+
+    glm::vec4 corners[8];
+    for (int i = 0; i < 8; ++i) {
+        const glm::vec4 corner = glm::vec4(
+            (i & 1) ? bounds.max.x : bounds.min.x,
+            (i & 2) ? bounds.max.y : bounds.min.y,
+            (i & 4) ? bounds.max.z : bounds.min.z,
+            1.f
+        );
+        corners[i] = clip * corner;
+    }
+    return isInViewVolume(corners, 8, margin);
+}
+
+void addVisibleTexCoords(const glm::mat4& clip, const std::vector<Vertex>& vertices,
+                         uint32_t first, uint32_t nVertices, float margin,
+                         TexCoordRange& range)
+{
+    const size_t end = std::min<size_t>(vertices.size(), size_t(first) + nVertices);
+    for (size_t i = first; i + 2 < end; i += 3) {
+        glm::vec4 triangle[3];
+        for (int j = 0; j < 3; ++j) {
+            const Vertex& v = vertices[i + j];
+            triangle[j] = clip * glm::vec4(v.x, v.y, v.z, 1.f);
+        }
+        if (!isInViewVolume(triangle, 3, margin)) {
+            continue;
+        }
+        for (int j = 0; j < 3; ++j) {
+            const Vertex& v = vertices[i + j];
+            range.min = glm::vec2(std::min(range.min.x, v.u), std::min(range.min.y, v.v));
+            range.max = glm::vec2(std::max(range.max.x, v.u), std::max(range.max.y, v.v));
+        }
+    }
+}
+
+bool nodeViewProjections(std::vector<glm::mat4>& matrices) {
+    using namespace sgct;
+
+    matrices.clear();
+    const glm::mat4& scene = ClusterManager::instance().sceneTransform();
+    for (const std::unique_ptr<Window>& window : Engine::instance().windows()) {
+        for (const std::unique_ptr<Viewport>& vp : window->viewports()) {
+            if (!vp->isEnabled()) {
+                continue;
+            }
+            if (vp->hasSubViewports()) {
+                return false;
+            }
+
+            if (window->isStereo()) {
+                const Frustum::Mode left = Frustum::Mode::StereoLeftEye;
+                const Frustum::Mode right = Frustum::Mode::StereoRightEye;
+                matrices.push_back(vp->projection(left).viewProjectionMatrix() * scene);
+                matrices.push_back(vp->projection(right).viewProjectionMatrix() * scene);
+            }
+            else {
+                const Frustum::Mode mono = Frustum::Mode::MonoEye;
+                matrices.push_back(vp->projection(mono).viewProjectionMatrix() * scene);
+            }
+        }
+    }
+    return true;
+}
+
+uint64_t nodePixels() {
+    using namespace sgct;
+
+    uint64_t res = 0;
+    for (const std::unique_ptr<Window>& window : Engine::instance().windows()) {
+        const glm::ivec2 resolution = window->framebufferResolution();
+        for (const std::unique_ptr<Viewport>& vp : window->viewports()) {
+            if (vp->isEnabled()) {
+                const glm::vec2 size = vp->size();
+                const float nPixels = resolution.x * size.x * resolution.y * size.y;
+                res += static_cast<uint64_t>(nPixels);
+            }
+        }
+    }
+    return res;
+}
@@ -0,0 +1,66 @@
+/*****************************************************************************************
+ *                                                                                       *
+ * Textured OBJ Renderer                                                                 *
+ *                                                                                       *
+ * Copyright (c) Alexander Bock, 2020                                                    *
+ *                                                                                       *
+ * All rights reserved.                                                                  *
+ *                                                                                       *
+ * Redistribution and use in source and binary forms, with or without modification, are  *
+ * permitted provided that the following conditions are met:                             *
+ *                                                                                       *
+ * 1. Redistributions of source code must retain the above copyright notice, this list   *
+ *    of conditions and the following disclaimer.                                        *
+ *                                                                                       *
+ * 2. Redistributions in binary form must reproduce the above copyright notice, this     *
+ *    list of conditions and the following disclaimer in the documentation and/or other  *
+ *    materials provided with the distribution.                                          *
+ *                                                                                       *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY   *
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES  *
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT   *
+ * SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,        *
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED  *
+ * TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR    *
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN      *
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN    *
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH   *
+ * DAMAGE.                                                                               *
+ ****************************************************************************************/
+
+#ifndef __VISIBILITY_H__
+#define __VISIBILITY_H__
+
+#include "mesh.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Returns whether any part of the box can be inside the view volume of the matrix, which
+// transforms the box into clip space. The sides of the view volume are widened by the
+// margin as a fraction of its size, so that objects are reported a bit before they come
+// into view. The test is conservative and might report boxes that are just outside
+bool isInFrustum(const glm::mat4& clip, const Bounds& bounds, float margin);
+
+// A range of texture coordinates, which is empty if min > max
+struct TexCoordRange {
+    glm::vec2 min = glm::vec2(std::numeric_limits<float>::max());
+    glm::vec2 max = glm::vec2(std::numeric_limits<float>::lowest());
+};
+
+// Extends the range by the texture coordinates of all triangles in the range of vertices
+// that can be seen through the matrix, which transforms the vertices into clip space.
+// Like isInFrustum, this is conservative and the margin widens the view volume
+void addVisibleTexCoords(const glm::mat4& clip, const std::vector<Vertex>& vertices,
+    uint32_t first, uint32_t nVertices, float margin, TexCoordRange& range);
+
+// Collects the view-projection matrices, including SGCT's scene transform, of all eyes of
+// the enabled viewports of this node's windows. Returns false if any viewport renders a
+// non-linear projection, for which the objects can't be tested against a single frustum
+bool nodeViewProjections(std::vector<glm::mat4>& matrices);
+
+// The number of pixels in all enabled viewports of this node's windows
+uint64_t nodePixels();
+
+#endif // __VISIBILITY_H__